@@ -1,6 +1,20 @@
-#include "spi.h"
+#include "SPI.h"
 #include "slcd.h"
 
+#if SPI1_DMA_MODE && defined(NRF24_SIM)
+	#error "the SPI1 model of nRF24sim.c has no DMA, build the host with SPI1_DMA_MODE 0"
+#endif
+
+#define SPI1_FIFO (SPI1_FIFO_MODE && !SPI1_DMA_MODE)										//the FIFO is not used with DMA transfers
+
+#if SPI1_FIFO
+	#define SPI1_RX_READY(status) (!((status) & SPI_S_RFIFOEF_MASK))					//at least one byte in the RX FIFO
+#else
+	#define SPI1_RX_READY(status) ((status) & SPI_S_SPRF_MASK)
+#endif
+
+#define SPI1_MODE_MASK ((1 << SPI_C1_CPOL_SHIFT) | (1 << SPI_C1_CPHA_SHIFT))				//CPOL and CPHA bits written by spi1_configure()
+
 uint8_t *spi1_data_s_pointer;
 int spi1_data_s_size;
 int count;
@@ -8,7 +22,15 @@ _Bool spi1_busy;
 uint8_t *spi1_receive_buffer;
 int spi1_receive_buffer_size;
 int spi1_receive_buffer_counter;
+spi1_callback spi1_done;
 int spi1_recive_mode;
+static uint32_t spi1_baud;																						//rate set by spi1_set_baud()
+static int spi1_chunk_size;																						//bytes of the chunk being clocked by the transfer engine
+static uint8_t spi1_chunk_flag;																				//watermark flag of that chunk (see spi1_chunk_mark())
+#if SPI1_DMA_MODE
+static uint8_t spi1_dma_dummy_tx = SPI1_DUMMY_BYTE;													//source of NOP bytes for RX only transfers
+static uint8_t spi1_dma_dummy_rx;																						//sink for TX only transfers
+#endif
 uint8_t data;
 
 
@@ -17,68 +39,358 @@ uint8_t data;
 
 void spi1init()
 {
-	int buffer= 0 ;
-	SIM -> SCGC4 |= SIM_SCGC4_SPI0_MASK;  														 //clock on in spi 
+#ifndef NRF24_SIM //the host build has no clock gates and pins, only the SPI1 registers
+	SIM -> SCGC4 |= SIM_SCGC4_SPI1_MASK;  														 //clock on in spi
 	SIM -> SCGC5 |= SIM_SCGC5_PORTE_MASK;
-	
-	SPI0 -> BR |= SPI_BR_SPPR(SPI0_SPPR);
-	SPI0 -> BR |= SPI_BR_SPR(SPI0_SPR);
-	PORT(SPI0_MISO_PORT) -> PCR[SPI0_MISO] |= PORT_PCR_MUX(SPI0_MISO_MUX);
-	PORT(SPI0_MOSI_PORT) -> PCR[SPI0_MOSI] |= PORT_PCR_MUX(SPI0_MOSI_MUX);
-  PORT(SPI0_PCS0_PORT) -> PCR[SPI0_PCS0] |= PORT_PCR_MUX(SPI0_PCS0_MUX);
-	PORT(SPI0_SCK_PORT)  ->  PCR[SPI0_SCK] |= PORT_PCR_MUX(SPI0_SCK_MUX);
-
-	SPI0 -> C1 |= (SPI0_MS_MODE << SPI_C1_MSTR_SHIFT);								  //Set mode master/slave
-	SPI0 -> C1 |= (SPI0_FIRST_BIT << SPI_C1_LSBFE_SHIFT);   					  //First bit LSB/MSB
-	SPI0 -> C1 &= ~(SPI0_CLOCK_PHASE << SPI_C1_CPHA_SHIFT);  					  //Clock phase 
-	SPI0 -> C1 |= (SPI0_CLOCK_POLARITY << SPI_C1_CPOL_SHIFT); 				  //Clock polarity
-	
-	SPI0 -> C2 |= (SPI0_DATA_LENGTH << SPI_C2_SPIMODE_SHIFT);						//seting mode 8/16 bit
-	SPI0 -> C2 |= (SPI0_DMA_MODE << SPI_C2_TXDMAE_SHIFT);								//DMA mode 
-	SPI0 -> C2 |= (SPI0_TRANSFER_MODE << SPI_C2_BIDIROE_SHIFT);					//one/two directional mode 
-	
-	//SPI0 -> C1 |= SPI_C1_SPIE_MASK;
-	//SPI0 -> C1 |= SPI_C1_SPTIE_MASK;
-	//NVIC_ClearPendingIRQ(SPI0_IRQn);																		// Clear NVIC any pending interrupts on SPI1 
-	//NVIC_EnableIRQ(SPI0_IRQn);
-	
-	
-	SPI0 -> C1 |= SPI_C1_SPE_MASK; 																			//On SPI;
-																		
+
+	PORT(SPI1_MISO_PORT) -> PCR[SPI1_MISO] |= PORT_PCR_MUX(SPI1_MISO_MUX);
+	PORT(SPI1_MOSI_PORT) -> PCR[SPI1_MOSI] |= PORT_PCR_MUX(SPI1_MOSI_MUX);
+	PORT(SPI1_SCK_PORT)  ->  PCR[SPI1_SCK] |= PORT_PCR_MUX(SPI1_SCK_MUX);
+#endif
+
+	SPI1 -> C1 = 0;																											//off while configured, CPHA reset value cleared
+	spi1_set_baud(SPI1_BAUD_HZ, SPI1_CLOCK_HZ);
+	SPI1 -> C1 |= (SPI1_MS_MODE << SPI_C1_MSTR_SHIFT);								  //Set mode master/slave
+	SPI1 -> C1 |= (SPI1_FIRST_BIT << SPI_C1_LSBFE_SHIFT);   					  //First bit LSB/MSB
+	SPI1 -> C1 |= (SPI1_CLOCK_PHASE << SPI_C1_CPHA_SHIFT);  					  //Clock phase (0 - nRF24 SPI mode 0)
+	SPI1 -> C1 |= (SPI1_CLOCK_POLARITY << SPI_C1_CPOL_SHIFT); 				  //Clock polarity
+
+	SPI1 -> C2 = 0;
+	SPI1 -> C2 |= (SPI1_DATA_LENGTH << SPI_C2_SPIMODE_SHIFT);						//seting mode 8/16 bit
+	//SPI1 -> C2 |= (SPI1_DMA_MODE << SPI_C2_TXDMAE_SHIFT);						//DMA requests are enabled per transfer
+	SPI1 -> C2 |= (SPI1_TRANSFER_MODE << SPI_C2_BIDIROE_SHIFT);					//one/two directional mode
+
+	SPI1 -> C3 = SPI1_FIFO ? SPI_C3_FIFOMODE_MASK : 0;									//FIFO on, flags cleared by hardware, interrupts enabled per chunk
+
+	//SPI1 -> C1 |= SPI_C1_SPIE_MASK;																	//receive interrupt is enabled per transfer
+	//SPI1 -> C1 |= SPI_C1_SPTIE_MASK;
+	spi1_busy = 0;
+#if SPI1_DMA_MODE
+	SIM -> SCGC6 |= SIM_SCGC6_DMAMUX_MASK;															//clock on in DMAMUX and DMA
+	SIM -> SCGC7 |= SIM_SCGC7_DMA_MASK;
+	DMAMUX0 -> CHCFG[SPI1_DMA_RX_CHANNEL] = 0;
+	DMAMUX0 -> CHCFG[SPI1_DMA_TX_CHANNEL] = 0;
+	DMAMUX0 -> CHCFG[SPI1_DMA_RX_CHANNEL] = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(SPI1_DMA_RX_SOURCE);
+	DMAMUX0 -> CHCFG[SPI1_DMA_TX_CHANNEL] = DMAMUX_CHCFG_ENBL_MASK | DMAMUX_CHCFG_SOURCE(SPI1_DMA_TX_SOURCE);
+	NVIC_SetPriority(DMA_IRQN(SPI1_DMA_RX_CHANNEL), SPI1_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(DMA_IRQN(SPI1_DMA_RX_CHANNEL));
+	NVIC_EnableIRQ(DMA_IRQN(SPI1_DMA_RX_CHANNEL));
+#else
+	NVIC_SetPriority(SPI1_IRQn, SPI1_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(SPI1_IRQn);																		// Clear NVIC any pending interrupts on SPI1
+	NVIC_EnableIRQ(SPI1_IRQn);
+#endif
+
+
+	SPI1 -> C1 |= SPI_C1_SPE_MASK; 																			//On SPI;
+
+}
+
+uint32_t spi_baud_compute(uint32_t target_hz, uint32_t clock_hz, uint8_t *br)
+{
+	uint32_t need, div, best_div = 0;
+	uint8_t sppr, spr, best_br = SPI_BR_SPPR(7) | SPI_BR_SPR(8);									//slowest rate, divisor 4096
+
+	need = target_hz ? (clock_hz + target_hz - 1) / target_hz : 0xFFFFFFFF;	//smallest divisor not exceeding the target
+	for(spr=0; spr<=8; spr++){
+		for(sppr=0; sppr<=7; sppr++){
+			div = (uint32_t)(sppr + 1) << (spr + 1);
+			if(div >= need && (!best_div || div < best_div)){
+				best_div = div;
+				best_br = SPI_BR_SPPR(sppr) | SPI_BR_SPR(spr);
+			}
+		}
+	}
+	if(!best_div)
+		best_div = 4096;
+	if(br)
+		*br = best_br;
+	return clock_hz / best_div;
+}
+
+uint32_t spi1_set_baud(uint32_t target_hz, uint32_t clock_hz)
+{
+	uint8_t br, c1;
+
+	spi1_transfer_wait();																								//do not change the rate under a transfer
+	spi1_baud = spi_baud_compute(target_hz, clock_hz, &br);
+	c1 = SPI1 -> C1;
+	SPI1 -> C1 = c1 & ~SPI_C1_SPE_MASK;
+	SPI1 -> BR = br;
+	SPI1 -> C1 = c1;
+	return spi1_baud;
+}
+
+uint32_t spi1_get_baud(void)
+{
+	return spi1_baud;
+}
+
+void spi1_configure(uint8_t br, uint8_t mode, uint32_t baud)
+{
+	uint8_t c1;
+
+	spi1_transfer_wait();																								//do not change the clock under a transfer
+	c1 = SPI1 -> C1;
+	SPI1 -> C1 = c1 & ~SPI_C1_SPE_MASK;
+	SPI1 -> BR = br;
+	SPI1 -> C1 = (c1 & ~SPI1_MODE_MASK) | (mode & SPI1_MODE_MASK);
+	spi1_baud = baud;
+}
+
+/*Size of the next chunk of a transfer with 'left' bytes to go.
+*Chunks are as long as the FIFO; a 5 byte rest is split 3+2, so no 1 byte chunk is left
+*(the RX watermark marks 2, 3 or 4 bytes). Without the FIFO every byte is a chunk.*/
+static int spi1_chunk(int left)
+{
+#if SPI1_FIFO
+	if(left >= SPI1_FIFO_DEPTH + 2 || left == SPI1_FIFO_DEPTH)
+		return SPI1_FIFO_DEPTH;
+	if(left == SPI1_FIFO_DEPTH + 1)
+		return SPI1_FIFO_DEPTH - 1;
+	return left;
+#else
+	return 1;
+#endif
+}
+
+/*Set the RX watermark of a chunk and return the status flag raised when the whole chunk is in
+*the RX FIFO: SPRF (FIFO full) for 4 bytes, RNFULLF (nearly full, 3 or 2 bytes by RNFULLF_MARK)
+*for 3 and 2 bytes, 0 for a single byte (RFIFOEF cleared).*/
+static uint8_t spi1_chunk_mark(int size)
+{
+#if SPI1_FIFO
+	if(size == SPI1_FIFO_DEPTH)
+		return SPI_S_SPRF_MASK;
+	if(size == 3){
+		SPI1 -> C3 &= ~SPI_C3_RNFULLF_MARK_MASK;													//48 bits - 3 words
+		return SPI_S_RNFULLF_MASK;
+	}
+	if(size == 2){
+		SPI1 -> C3 |= SPI_C3_RNFULLF_MARK_MASK;														//32 bits - 2 words
+		return SPI_S_RNFULLF_MASK;
+	}
+	return 0;
+#else
+	return SPI_S_SPRF_MASK;
+#endif
+}
+
+/*Enable the interrupt of the chunk watermark flag (0 - all off)*/
+static void spi1_chunk_irq(uint8_t flag)
+{
+	SPI1 -> C1 = (flag == SPI_S_SPRF_MASK) ? (SPI1 -> C1 | SPI_C1_SPIE_MASK) : (SPI1 -> C1 & ~SPI_C1_SPIE_MASK);
+#if SPI1_FIFO
+	SPI1 -> C3 = (flag == SPI_S_RNFULLF_MASK) ? (SPI1 -> C3 | SPI_C3_RNFULLIEN_MASK) : (SPI1 -> C3 & ~SPI_C3_RNFULLIEN_MASK);
+#endif
+}
+
+/*Check if the whole chunk being clocked by the transfer engine is in the RX FIFO*/
+static _Bool spi1_chunk_complete(uint8_t status)
+{
+	if(spi1_chunk_flag)
+		return (status & spi1_chunk_flag) != 0;
+	return SPI1_RX_READY(status) != 0;
+}
+
+/*Wait until the chunk watermark flag is raised*/
+static void spi1_chunk_wait(uint8_t flag)
+{
+	if(flag){
+		while(!(SPI1_STATUS() & flag));
+	}else{
+		while(!SPI1_RX_READY(SPI1_STATUS()));
+	}
 }
 
 int spi1_byte_send(uint8_t data, _Bool receive)        //zmienione
 {
-	uint8_t reg;
-	SPI0->C1 |= SPI_C1_SPIE_MASK;
-	while(!(SPI0->S &(1<<SPI_S_SPTEF_SHIFT)));
-	SPI0->DL = data;
-	//return 0;
-	
-	//SPI0 ->S &(1<<SPI_S_SPRF_SHIFT);
-	while( 0==(SPI0 ->S &(1<<SPI_S_SPRF_SHIFT)))
+	uint8_t in;
+	spi1_transfer_wait();																								//do not break a transfer in progress
+	SPI_TRACE_BYTES(&data, 1);
+	spi1_chunk_irq(0);																									//polled byte must not be taken by the transfer engine
+#if !SPI1_FIFO
+	while(!(SPI1_STATUS() & SPI_S_SPTEF_MASK));
+#endif
+	SPI1_WRITE(data);
+	while(!SPI1_RX_READY(SPI1_STATUS()))
 	{};
-	return SPI0->DL;
+	in = SPI1_READ();
+	(void)receive;																											//the byte clocked in is always returned
+	return in;
 }
 
 uint8_t spi1_read_byte(uint8_t data)
 {
-	uint8_t retu;
-	uint8_t reg;
-	
-	SPI0->C1 &= ~(1<<SPI_C1_SPIE_SHIFT);
-	while(!(SPI0->S &(1<<SPI_S_SPTEF_SHIFT)));
-	SPI0->DL = data;
-	//reg = SPI0 ->S &(1<<SPI_S_SPRF_SHIFT);
-	while( 0==(SPI0 ->S &(1<<SPI_S_SPRF_SHIFT)))
+	spi1_transfer_wait();																								//do not break a transfer in progress
+	SPI_TRACE_BYTES(&data, 1);
+	spi1_chunk_irq(0);
+#if !SPI1_FIFO
+	while(!(SPI1_STATUS() & SPI_S_SPTEF_MASK));
+#endif
+	SPI1_WRITE(data);
+	while(!SPI1_RX_READY(SPI1_STATUS()))
+	{};
+	return SPI1_READ();
+}
+
+void spi1_transfer(uint8_t *tx, uint8_t *rx, int size)
+{
+#if SPI1_DMA_MODE
+	spi1_transfer_wait();																								//do not break a transfer in progress
+	spi1_transfer_async(tx, rx, size, 0);
+	spi1_transfer_wait();
+#else
+	int i,j,n;
+	uint8_t in,flag;
+
+	spi1_transfer_wait();																								//do not break a transfer in progress
+	SPI_TRACE_BYTES(tx, size);
+	spi1_chunk_irq(0);
+	for(i=0; i<size; i+=n){
+		n = spi1_chunk(size - i);
+		flag = spi1_chunk_mark(n);
+#if !SPI1_FIFO
+		while(!(SPI1_STATUS() & SPI_S_SPTEF_MASK));
+#endif
+		for(j=0; j<n; j++)																								//the TX FIFO has room for the whole chunk, no polls
+			SPI1_WRITE(tx ? tx[i+j] : SPI1_DUMMY_BYTE);
+		spi1_chunk_wait(flag);																						//one status poll loop per chunk
+		for(j=0; j<n; j++){
+			in = SPI1_READ();
+			if(rx)
+				rx[i+j] = in;
+		}
+	}
+#endif
+}
+
+/*Clock out the next chunk of the transfer engine, its watermark interrupt enabled first*/
+static void spi1_chunk_start(void)
+{
+	int i,first,last;
+	uint8_t flag;
+
+	first = count;																											//the interrupt may come with the last byte and move count
+	spi1_chunk_size = spi1_chunk(spi1_data_s_size - first);
+	last = first + spi1_chunk_size;
+	flag = spi1_chunk_mark(spi1_chunk_size);
+	spi1_chunk_flag = flag;
+	spi1_chunk_irq(flag);
+	for(i=first; i<last; i++)
+		SPI1_WRITE(spi1_data_s_pointer ? spi1_data_s_pointer[i] : SPI1_DUMMY_BYTE);
+}
+
+int spi1_transfer_async(uint8_t *tx, uint8_t *rx, int size, spi1_callback done)
+{
+	if(spi1_busy)
+		return -1;
+	if(size <= 0){
+		if(done)
+			done();
+		return 0;
+	}
+	SPI_TRACE_BYTES(tx, size);
+
+	spi1_data_s_pointer = tx;
+	spi1_data_s_size = size;
+	spi1_receive_buffer = rx;
+	spi1_receive_buffer_size = size;
+	spi1_receive_buffer_counter = 0;
+	count = 0;
+	spi1_done = done;
+
+#if SPI1_DMA_MODE
+	spi1_busy = 1;
+	DMA0->DMA[SPI1_DMA_RX_CHANNEL].DSR_BCR = DMA_DSR_BCR_DONE_MASK;						//clear status of the previous frame
+	DMA0->DMA[SPI1_DMA_TX_CHANNEL].DSR_BCR = DMA_DSR_BCR_DONE_MASK;
+
+	DMA0->DMA[SPI1_DMA_RX_CHANNEL].SAR = (uint32_t)&SPI1->DL;
+	DMA0->DMA[SPI1_DMA_RX_CHANNEL].DAR = (uint32_t)(rx ? rx : &spi1_dma_dummy_rx);
+	DMA0->DMA[SPI1_DMA_RX_CHANNEL].DSR_BCR = DMA_DSR_BCR_BCR(size);
+	DMA0->DMA[SPI1_DMA_RX_CHANNEL].DCR = DMA_DCR_EINT_MASK | DMA_DCR_ERQ_MASK | DMA_DCR_CS_MASK | DMA_DCR_D_REQ_MASK |
+																			 DMA_DCR_SSIZE(1) | DMA_DCR_DSIZE(1) | (rx ? DMA_DCR_DINC_MASK : 0);
+
+	DMA0->DMA[SPI1_DMA_TX_CHANNEL].SAR = (uint32_t)(tx ? tx : &spi1_dma_dummy_tx);
+	DMA0->DMA[SPI1_DMA_TX_CHANNEL].DAR = (uint32_t)&SPI1->DL;
+	DMA0->DMA[SPI1_DMA_TX_CHANNEL].DSR_BCR = DMA_DSR_BCR_BCR(size);
+	DMA0->DMA[SPI1_DMA_TX_CHANNEL].DCR = DMA_DCR_ERQ_MASK | DMA_DCR_CS_MASK | DMA_DCR_D_REQ_MASK |
+																			 DMA_DCR_SSIZE(1) | DMA_DCR_DSIZE(1) | (tx ? DMA_DCR_SINC_MASK : 0);
+
+	SPI1->C2 |= SPI_C2_RXDMAE_MASK | SPI_C2_TXDMAE_MASK;													//TX request starts the frame
+#else
+	if(spi1_chunk(size) == 1 && SPI1_FIFO){																//a single byte has no watermark interrupt
+		spi1_transfer(tx, rx, size);
+		spi1_receive_buffer_counter = size;
+		count = size;
+		if(done)
+			done();
+		return 0;
+	}
+	spi1_busy = 1;
+#if !SPI1_FIFO
+	while(!(SPI1_STATUS() & SPI_S_SPTEF_MASK));
+#endif
+	spi1_chunk_start();																									//the rest is sent from SPI1_IRQHandler
+#endif
+	return 0;
+}
+
+_Bool spi1_transfer_busy(void)
+{
+	return spi1_busy;
+}
+
+void spi1_transfer_wait(void)
+{
+	while(spi1_busy)
 	{};
-	//{
-	//SPI0 ->S &(1<<SPI_S_SPRF_SHIFT);
-	//};
-			//retu = ;
-		return SPI0->DL;
 }
 
+void spi1_set_callback(spi1_callback done)
+{
+	spi1_done = done;
+}
+
+static void spi1_chunk_done(void);
+#if SPI1_DMA_MODE
+static void spi1_dma_done(void);
+#endif
+
+_Bool spi1_transfer_poll(void)																				//the waiting context drives the engine when the interrupt cannot be taken
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();																										//the interrupt must not serve the same chunk
+#if SPI1_DMA_MODE
+	if(spi1_busy && (DMA0->DMA[SPI1_DMA_RX_CHANNEL].DSR_BCR & DMA_DSR_BCR_DONE_MASK))
+		spi1_dma_done();
+#else
+	if(spi1_busy && spi1_chunk_complete(SPI1_STATUS()))
+		spi1_chunk_done();
+#endif
+	__set_PRIMASK(primask);
+	return spi1_busy;
+}
+
+void spi1_set_receive_buffer(uint8_t *receive_buffer, int receive_buffer_size)
+{
+	spi1_receive_buffer = receive_buffer;
+	spi1_receive_buffer_size = receive_buffer_size;
+	spi1_receive_buffer_counter = 0;
+}
+
+void spi1_data_send(uint8_t *data , int size, _Bool receive)					//receive buffer set by spi1_set_receive_buffer() is used for one transfer
+{
+	uint8_t *rx = receive ? spi1_receive_buffer : 0;
+	int rx_size = spi1_receive_buffer_size;
+
+	if(receive && rx_size < size)																				//never run past the receive buffer
+		size = rx_size;
+	spi1_transfer_async(data, rx, size, spi1_done);
+}
+
+#ifndef NRF24_SIM
 void spi0_set_match_value(uint8_t ML, uint8_t MH)
 {
 	SPI0 -> ML = ML;
@@ -89,21 +401,58 @@ void spi0_set_match_value_ML(uint8_t ML)
 {
 	SPI0 -> ML = ML;
 }
+#endif
+
+
 
 
-	
-	
-	/*void SPI0_IRQHandler(void)
-	{
-		if(SPI0-> S & (1<<SPI_S_SPTEF_SHIFT))
-			SPI0->DL = 0xAA;
-		
-		if(SPI0-> S & (1<<SPI_S_SPRF_SHIFT))
-		{
-		slcdClear();
-		slcdDisplay((uint16_t) SPI0 -> DL ,10);	
+/*The whole chunk is in the RX FIFO: store it and clock out the next one, or finish the transfer*/
+static void spi1_chunk_done(void)
+{
+	uint8_t in;
+	int i;
+
+	for(i=0; i<spi1_chunk_size; i++){
+		in = SPI1_READ();																									//the watermark flag is cleared by hardware as the FIFO empties
+		if(spi1_receive_buffer){
+			spi1_receive_buffer[count] = in;
+			spi1_receive_buffer_counter++;
 		}
-		
-	}*/
-	
+		count++;
+	}
+
+	if(count < spi1_data_s_size){
+		spi1_chunk_start();
+	}else{
+		spi1_chunk_irq(0);
+		spi1_busy = 0;
+		if(spi1_done)
+			spi1_done();
+	}
+}
+
+void SPI1_IRQHandler(void)																						//one interrupt per chunk: the whole chunk is in the RX FIFO
+{
+	if(!spi1_busy || !spi1_chunk_complete(SPI1_STATUS()))								//a chunk already served by spi1_transfer_poll() leaves the interrupt pending
+		return;
+	spi1_chunk_done();
+}
+
+#if SPI1_DMA_MODE
+static void spi1_dma_done(void)
+{
+	DMA0->DMA[SPI1_DMA_RX_CHANNEL].DSR_BCR = DMA_DSR_BCR_DONE_MASK;						//the last byte of the frame has been received
+	DMA0->DMA[SPI1_DMA_TX_CHANNEL].DSR_BCR = DMA_DSR_BCR_DONE_MASK;
+	SPI1->C2 &= ~(SPI_C2_RXDMAE_MASK | SPI_C2_TXDMAE_MASK);
+	spi1_receive_buffer_counter = spi1_data_s_size;
+	count = spi1_data_s_size;
+	spi1_busy = 0;
+	if(spi1_done)
+		spi1_done();
+}
 
+void DMA_IRQHANDLER(SPI1_DMA_RX_CHANNEL)(void)
+{
+	spi1_dma_done();
+}
+#endif
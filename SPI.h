@@ -9,10 +9,18 @@
 #ifndef SPI_H
 	#define SPI_H
 	 
-	#include "MKL46Z4.h" 
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
+	#include "delay.h"
+	#include "spiTrace.h"
 	
 	void spi0init(void);
 	void spi1init(void);
+	/* Polled single bytes; both wait for a transfer of the engine in progress first. They bypass the
+	*  bus manager (spiBus.h), so do not use them while bus transactions may be queued. */
 	int spi1_byte_send(uint8_t data, _Bool receive);
 	void spi0_byte_send(uint8_t data);
 	void spi1_data_send(uint8_t *data , int size, _Bool receive);
@@ -21,6 +29,37 @@
 	void spi1_set_receive_buffer(uint8_t *receive_buffer, int receive_buffer_size);
 	uint8_t spi1_read_byte(uint8_t data);
 
+	/* Interrupt driven transfer engine.
+	*  A transfer clocks out 'size' bytes from 'tx' (NOP bytes if tx is 0) and stores the bytes
+	*  clocked in to 'rx' (dropped if rx is 0). The engine is driven by SPI1_IRQHandler, or by two
+	*  DMA channels when SPI1_DMA_MODE is set, so the CPU is free during the transfer.
+	*  With SPI1_FIFO_MODE the bytes are moved in FIFO sized chunks and SPI1_IRQHandler runs once
+	*  per chunk, on the RX FIFO watermark (see spi1_chunk()).
+	*  Completion is signalled by clearing spi1_busy and calling 'done' (from the interrupt
+	*  context, may be 0). */
+	typedef void (*spi1_callback)(void);
+	int spi1_transfer_async(uint8_t *tx, uint8_t *rx, int size, spi1_callback done);  //returns 0 if started, -1 if the engine is busy
+	_Bool spi1_transfer_busy(void);
+	void spi1_transfer_wait(void);
+	void spi1_transfer(uint8_t *tx, uint8_t *rx, int size);                           //blocking transfer (polled per FIFO chunk, or DMA with SPI1_DMA_MODE)
+	void spi1_set_callback(spi1_callback done);
+	_Bool spi1_transfer_poll(void);                                                   //serve a finished chunk (or DMA frame) from outside the interrupt; returns spi1_busy
+
+	/* Baud rate configuration.
+	*  spi_baud_compute() finds the SPPR/SPR pair giving the highest rate not above 'target_hz'
+	*  from 'clock_hz' (the bus clock for SPI0, the system clock for SPI1) and returns that rate;
+	*  the slowest rate (divisor 4096) is returned if 'target_hz' is below it.
+	*  spi1_set_baud() writes the pair to SPI1 -> BR (SPI1 is stopped for the change). */
+	uint32_t spi_baud_compute(uint32_t target_hz, uint32_t clock_hz, uint8_t *br);
+	uint32_t spi1_set_baud(uint32_t target_hz, uint32_t clock_hz);                     //returns the rate achieved
+	uint32_t spi1_get_baud(void);                                                      //rate set by the last spi1_set_baud() or spi1_configure()
+
+	/* Device configuration (see spiBus.h).
+	*  spi1_configure() writes a BR value from spi_baud_compute() and the CPOL/CPHA bits ('mode', in
+	*  their SPI1 -> C1 positions) at once, SPI1 is stopped for the change; 'baud' is the rate the BR
+	*  value gives, returned by spi1_get_baud(). */
+	void spi1_configure(uint8_t br, uint8_t mode, uint32_t baud);
+
 	extern uint8_t *spi1_data_s_pointer;
 	extern int spi1_data_s_size;
 	extern int count;
@@ -28,6 +67,25 @@
 	extern uint8_t *spi1_receive_buffer;
 	extern int spi1_receive_buffer_size;
 	extern int spi1_receive_buffer_counter;
+	extern spi1_callback spi1_done;
+	void SPI1_IRQHandler(void);
+
+	/*SPI interrupt priority used by the transfer engine (0 - highest, 3 - lowest)*/
+	#define SPI1_IRQ_PRIORITY 1
+	/*Byte clocked out when there is no TX data*/
+	#define SPI1_DUMMY_BYTE 0xFF
+
+	/*SPI1 data path - the status and data registers are accessed only through these macros,
+	*so the host build (NRF24_SIM) can route them to the SPI1 model of nRF24sim.c*/
+	#ifdef NRF24_SIM
+		#define SPI1_STATUS()			nRF24sim_spi1Status()
+		#define SPI1_READ()				nRF24sim_spi1Read()
+		#define SPI1_WRITE(data)	nRF24sim_spi1Write(data)
+	#else
+		#define SPI1_STATUS()			(SPI1 -> S)
+		#define SPI1_READ()				(SPI1 -> DL)
+		#define SPI1_WRITE(data)	(SPI1 -> DL = (data))
+	#endif
 
 	/* Pins using as SPI0 I/O*/ 
 	#define SPI0_MISO_PORT E
@@ -43,7 +101,7 @@
 	#define SPI0_PCS0 16
 	#define SPI0_PCS0_MUX 2
 
-	/* Pins using as SPI1 I/O*/ 
+	/* Pins using as SPI1 I/O (radio bus); CSN is driven as GPIO by pin_CSN(), PCS1 is not muxed*/ 
 	#define SPI1_MISO_PORT E
 	#define SPI1_MISO 0
 	#define SPI1_MISO_MUX 2
@@ -61,7 +119,7 @@
 
 	/*Baud rate set for SPI0
 	The input to this prescaler is
-	the bus rate clock (BUSCLK). The output of this prescaler drives the input of the SPI baud rate divider.
+	the bus rate clock (BUSCLK) for SPI0 and the system clock for SPI1. The output of this prescaler drives the input of the SPI baud rate divider.
 	Refer to the description of SPI Baud Rate Generation for details.
 	0 Baud rate prescaler divisor is 1.
 	1 Baud rate prescaler divisor is 2.
@@ -73,7 +131,6 @@
 	7 Baud rate prescaler divisor is 8.
 	*/
 	#define SPI0_SPPR 7
-	#define SPI1_SPPR 7
 
 
 	/*This 4-bit field selects one of nine divisors for the SPI baud rate divider. The input to this divider comes
@@ -89,7 +146,12 @@
 	8 Baud rate divisor is 512.
 	All others Reserved*/
 	#define SPI0_SPR 4
-	#define SPI1_SPR 8
+
+	/*SPI1 baud rate set by spi1init() - SPPR and SPR are computed by spi1_set_baud() from the target rate and the clock.
+	*The devices on the bus manager (spiBus.h) carry their own rate, polarity and phase, written when the bus moves to them.*/
+	#define SPI1_BAUD_HZ 10000000
+	/*SPI1 input clock - the system clock (core clock)*/
+	#define SPI1_CLOCK_HZ F_CPU_DEF
 
 
 	/*SPI0 transfer mode 0 - 8 bit word 1- 16 bit word*/ 
@@ -127,12 +189,26 @@
 	#define SPI1_TRANSFER_MODE 0
 
 
-	/*SPI0 data memory transfer 1 - DMA transfer 0 - no DMA transfer*/
+	/*SPI0 data memory transfer 1 - DMA transfer 0 - no DMA transfer
+	*
+	*With DMA transfer every spi1_transfer()/spi1_transfer_async() frame is moved between memory and
+	*the data register by two DMA channels (RX and TX) and finished with a single DMA interrupt.
+	*The FIFO is not used in DMA transfer mode.
+	*/
 	#define SPI0_DMA_MODE 0
 	#define SPI1_DMA_MODE 0
 
+	/*DMA channels (0-3) used in DMA transfer mode, the RX channel raises the completion interrupt*/
+	#define SPI1_DMA_RX_CHANNEL 0
+	#define SPI1_DMA_TX_CHANNEL 1
+	/*DMAMUX request sources of SPI1*/
+	#define SPI1_DMA_RX_SOURCE 18
+	#define SPI1_DMA_TX_SOURCE 19
+
 	/*SPI1 1-FIFO mode 0-no FIFO mode*/ 
 	#define SPI1_FIFO_MODE 1
+	/*SPI1 TX and RX FIFO depth in 8 bit words*/
+	#define SPI1_FIFO_DEPTH 4
 
 
 
@@ -148,5 +224,11 @@
 	//Choosing SPI between 0 and 1
 	#define SPI(x) SSPI(x)
 	#define SSPI(x) (SPI##x)
+	//DMA channel interrupt number
+	#define DMA_IRQN(x) SDMA_IRQN(x)
+	#define SDMA_IRQN(x) (DMA##x##_IRQn)
+	//DMA channel interrupt handler name
+	#define DMA_IRQHANDLER(x) SDMA_IRQHANDLER(x)
+	#define SDMA_IRQHANDLER(x) DMA##x##_IRQHandler
 
 #endif
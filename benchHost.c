@@ -0,0 +1,147 @@
+/*! \brief The source file with the host benchmark program.
+*	\file benchHost.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the host program running the benchmark suite against the simulated radio. Module 0 is driven by the driver and lang4robots; module 1 is the peer, answering like a board with the normal firmware (the commands are not executed, the reply value is the argument block length).
+* \par Build (Linux): <tt>cc -DNRF24_SIM -o bench benchHost.c benchmark.c lang4robots.c nRF24.c nRF24sim.c delay.c spiTrace.c channelManager.c SPI.c spiBus.c</tt>
+* \par Run: <tt>./bench [loss permille] [seed] > results.csv</tt>
+* \par Built with \c -DSPI_TRACE=1 as well, the SPI trace report of one more point (1 Mbps, 4 bytes of arguments, ARD 500 us, ARC 3, batch 4) is printed to \c stderr after the sweep.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifdef NRF24_SIM
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+
+static uint8_t benchHost_node;	//!< driver-backed module
+static uint8_t benchHost_peer;	//!< peer module
+static nrf24_dev benchHost_radio=nRF24_DEV(PIN_RADIO_A);	//!< driver instance of \c benchHost_node (the first module added)
+
+/*! Module IRQ handler of the driver-backed module - the same work as PORTC_PORTD_IRQHandler() in main.c.
+*/
+static void benchHost_irq(void){
+	uint8_t statusReg=nRF24_getStatus(&benchHost_radio),irq_mask;
+
+	if(statusReg & RX_DR){
+		irq_mask=RX_DR;
+		nRF24_writeRegister(&benchHost_radio,STATUS,&irq_mask,1);
+		lang4robots_receiveFrames(&benchHost_radio);
+	}
+	if(statusReg & TX_DS){
+		irq_mask=TX_DS;
+		nRF24_writeRegister(&benchHost_radio,STATUS,&irq_mask,1);
+		lang4robots_txDone(&benchHost_radio);
+	}
+	if(statusReg & MAX_RT){
+		lang4robots_txFailed(&benchHost_radio);
+		irq_mask=MAX_RT;
+		nRF24_writeRegister(&benchHost_radio,STATUS,&irq_mask,1);
+	}
+}
+
+/*! Module IRQ handler of the peer: drain RX FIFO and answer reply requests with an ACK payload.
+*/
+static void benchHost_peerIrq(void){
+	uint8_t tx[33],rx[33],len,pipe;
+
+	tx[0]=NOP;
+	tx[1]=nRF24sim_spi(benchHost_peer,tx,0,1) & (RX_DR | TX_DS | MAX_RT);
+	tx[0]=W_REGISTER | STATUS;
+	nRF24sim_spi(benchHost_peer,tx,0,2);
+	for(;;){
+		tx[0]=R_REGISTER | FIFO_STATUS;
+		nRF24sim_spi(benchHost_peer,tx,rx,2);
+		if(rx[1] & RX_EMPTY){
+			break;
+		}
+		pipe=(rx[0]>>1) & 0x07;
+		tx[0]=R_RX_PL_WID;
+		nRF24sim_spi(benchHost_peer,tx,rx,2);
+		len=rx[1]>32 ? 32 : rx[1];
+		memset(tx,NOP,sizeof(tx));
+		tx[0]=R_RX_PAYLOAD;
+		nRF24sim_spi(benchHost_peer,tx,rx,len+1);
+		if(len>=L4R_FRAME_HDR_LEN+L4R_RECORD_HDR_LEN && (rx[1] & L4R_REPLY_REQ)){
+			tx[0]=W_ACK_PAYLOAD | pipe;
+			tx[1]=rx[1];
+			tx[2]=rx[2];
+			tx[3]=rx[3];
+			tx[4]=0;
+			tx[5]=0;
+			tx[6]=0;
+			nRF24sim_spi(benchHost_peer,tx,0,1+L4R_REPLY_LEN);
+		}
+	}
+}
+
+/*! Configure the peer like the driver-backed module and start listening.
+*/
+static void benchHost_sync(const bench_config* config){
+	uint8_t tx[2],rx[2];
+
+	(void)config; //the whole configuration is copied
+	nRF24sim_setCE(benchHost_peer,0);
+	nRF24sim_cloneConfig(benchHost_peer,benchHost_node);
+	tx[0]=R_REGISTER | CONFIG;
+	nRF24sim_spi(benchHost_peer,tx,rx,2);
+	tx[0]=W_REGISTER | CONFIG;
+	tx[1]=rx[1] | PWR_UP | PRIM_RX;
+	nRF24sim_spi(benchHost_peer,tx,0,2);
+	nRF24sim_setCE(benchHost_peer,1);
+}
+
+#if SPI_TRACE
+static void benchHost_report(const char* line){
+	fprintf(stderr,"%s\n",line);
+}
+#endif
+
+static void benchHost_emit(const bench_result* result){
+	char line[BENCH_LINE_LEN];
+
+	bench_format(result,"sim",line);
+	puts(line);
+	fflush(stdout);
+}
+
+int main(int argc, char** argv){
+	uint8_t addr[5]=nRF24_DEFAULT_TX_ADDR;
+	bench_port port;
+
+	nRF24sim_reset();
+	benchHost_node=nRF24sim_addNode();
+	benchHost_peer=nRF24sim_addNode();
+	nRF24sim_attach(benchHost_node,benchHost_irq);
+	nRF24sim_attach(benchHost_peer,benchHost_peerIrq);
+	nRF24sim_seed(argc>2 ? (uint32_t)strtoul(argv[2],0,0) : 1);
+
+	lang4robots_init(&benchHost_radio,0);
+	benchHost_sync(0);
+	nRF24sim_setLoss(argc>1 ? (uint16_t)atoi(argv[1]) : 0);
+
+	port.target="sim";
+	port.emit=benchHost_emit;
+	port.sync=benchHost_sync;
+	port.addr=addr;
+	port.radio=&benchHost_radio;
+	puts(bench_header());
+	bench_run(&port);
+#if SPI_TRACE
+	{
+		bench_config config={4,1,1,3,4};
+		bench_result result;
+
+		spiTrace_clear();
+		bench_runOne(&port,&config,&result);
+		spiTrace_print(benchHost_report);
+	}
+#endif
+
+	return 0;
+}
+
+#endif
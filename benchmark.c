@@ -0,0 +1,245 @@
+/*! \brief The source file with the lang4robots benchmark suite.
+*	\file benchmark.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the definition of the benchmark tests and of the sweep over the radio and lang4robots settings.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#include <stdio.h>
+#include "benchmark.h"
+
+static const uint8_t bench_argLens[]={0,4,12,L4R_ARGS_MAX};	//!< argument block lengths swept
+static const uint8_t bench_dataRates[]={0,1,2};								//!< data rates swept
+static const uint8_t bench_retrans[][2]={{1,3},{1,15},{5,15}};	//!< ARD, ARC pairs swept
+static const uint8_t bench_batches[]={1,4,8};									//!< batch sizes swept
+
+static uint8_t bench_args[L4R_ARGS_MAX]; //!< argument block sent with every command
+static nrf24_dev* bench_radio;						//!< module of the throughput test, read by bench_delivery()
+static uint8_t bench_arc;									//!< ARC of the throughput test
+static uint8_t bench_frameCommands[L4R_SEQ_MASK+1];	//!< commands packed into the frame with the sequence number
+static volatile uint16_t bench_delivered;	//!< commands of the throughput frames delivered
+static volatile uint16_t bench_retransmits;	//!< retransmissions of the throughput frames
+
+/*! Delivery hook of the throughput test.
+* \detail Counts the commands of the delivered frames and the retransmissions of every frame: \c ARC+1 transmissions for every software retransmission and \c ARC_CNT of the last one, read in the \c TX_DS or \c MAX_RT interrupt that finished the frame.
+* \param delivery	- the delivery report;
+*/
+static void bench_delivery(const l4r_delivery* delivery){
+	bench_retransmits+=(delivery->tries-1)*(bench_arc+1)+nRF24_getPacketRetranCount(bench_radio);
+	if(delivery->status==L4R_DELIVERED){
+		bench_delivered+=bench_frameCommands[delivery->seq];
+	}
+}
+
+/*! Wait until every frame sent is delivered or failed and the TX stream is empty.
+* \param radio	- the module;
+* \param start	- time stamp the wait is counted from;
+* \return \c '1' - empty, \c '0' - \c BENCH_TIMEOUT_US has passed;
+*/
+static _Bool bench_drain(nrf24_dev* radio, uint32_t start){
+	while(lang4robots_txService() || nRF24_streamBusy(radio)){
+		if(delay_expired(start+BENCH_TIMEOUT_US)){
+			return 0;
+		}
+		delay_yield();
+	}
+
+	return 1;
+}
+
+/*! Send the pending packed frame, waiting while the transmit window is full.
+*/
+static void bench_flush(void){
+	while(lang4robots_flush()==0xFF){
+		lang4robots_txService();
+		delay_yield();
+	}
+}
+
+/*! Clear the packet loss counter (\c PLOS_CNT is reset by writing \c RF_CH).
+* \param radio	- the module;
+*/
+static void bench_clearLoss(nrf24_dev* radio){
+	uint8_t rf_chReg=nRF24_getRegister(radio,RF_CH);
+
+	nRF24_writeRegister(radio,RF_CH,&rf_chReg,1); //the shadow keeps the same value
+}
+
+/*! Get the data rate the module is set to.
+* \param radio	- the module;
+* \return nRF24_setRFdataRate() value;
+*/
+static uint8_t bench_dataRate(nrf24_dev* radio){
+	uint8_t rf_setupReg=nRF24_getRegister(radio,RF_SETUP);
+
+	if(rf_setupReg & RF_DR_LOW){
+		return 0;
+	}
+	return (rf_setupReg & RF_DR_HIGH) ? 2 : 1;
+}
+
+/*! Run the tests of one point of the sweep.
+* \detail Three tests are run one after another: throughput (\c BENCH_COMMANDS commands, flushed every \c batch commands), one-way latency and round-trip latency (\c BENCH_SAMPLES single commands each).
+* \param port	- the port;
+* \param config	- the point;
+* \param result	- the results;
+* \sa bench_run()
+*/
+void bench_runOne(const bench_port* port, const bench_config* config, bench_result* result){
+	uint32_t start,sum;
+	uint32_t value;
+	uint16_t i;
+	uint8_t seq;
+
+	result->config=*config;
+	result->commands=BENCH_COMMANDS;
+	result->timeouts=0;
+	result->lost=0;
+
+	nRF24_batchBegin(port->radio);
+	nRF24_setRFdataRate(port->radio,config->dataRate);
+	nRF24_setAutoRetranDelay(port->radio,config->ard);
+	nRF24_setAutoRetranCount(port->radio,config->arc);
+	nRF24_batchCommit(port->radio);
+	if(port->sync){
+		port->sync(config);
+	}
+
+	//throughput
+	bench_clearLoss(port->radio);
+	bench_radio=port->radio;
+	bench_arc=config->arc;
+	bench_delivered=0;
+	bench_retransmits=0;
+	seq=0xFF;
+	lang4robots_setDeliveryHook(bench_delivery);
+	start=delay_micros();
+	for(i=0; i<BENCH_COMMANDS; i++){
+		while(!lang4robots_queueCommand(port->addr,BENCH_OPCODE,bench_args,config->argLen)){
+			lang4robots_txService(); //transmit window busy
+			delay_yield();
+		}
+		if(lang4robots_lastSeq()!=seq){
+			seq=lang4robots_lastSeq();
+			bench_frameCommands[seq]=0; //a new frame
+		}
+		bench_frameCommands[seq]++;
+		if((i+1)%config->batch==0){
+			bench_flush();
+		}
+	}
+	bench_flush();
+	if(!bench_drain(port->radio,start)){
+		result->timeouts++;
+	}
+	result->elapsedUs=delay_micros()-start;
+	lang4robots_setDeliveryHook(0);
+	result->delivered=bench_delivered;
+	result->retransmits=bench_retransmits;
+	result->commandsPerSec=result->elapsedUs ? (uint32_t)((uint64_t)result->delivered*1000000/result->elapsedUs) : 0;
+	result->lost+=nRF24_getPacketLossCount(port->radio);
+
+	//one-way latency
+	bench_clearLoss(port->radio);
+	sum=0;
+	for(i=0; i<BENCH_SAMPLES; i++){
+		start=delay_micros();
+		lang4robots_sendCommandWithArgs(port->addr,BENCH_OPCODE,bench_args,config->argLen);
+		if(!bench_drain(port->radio,start)){
+			result->timeouts++;
+		}
+		sum+=delay_micros()-start;
+		result->retransmits+=nRF24_getPacketRetranCount(port->radio);
+	}
+	result->latencyUs=sum/BENCH_SAMPLES;
+	result->lost+=nRF24_getPacketLossCount(port->radio);
+
+	//round-trip latency
+	bench_clearLoss(port->radio);
+	sum=0;
+	result->replies=0;
+	for(i=0; i<BENCH_SAMPLES; i++){
+		start=delay_micros();
+		if(lang4robots_sendCommandAndWait(port->addr,BENCH_OPCODE,bench_args,config->argLen,&value)){
+			sum+=delay_micros()-start;
+			result->replies++;
+		}
+	}
+	result->rttUs=result->replies ? sum/result->replies : 0;
+	result->lost+=nRF24_getPacketLossCount(port->radio);
+}
+
+/*! Run the whole sweep.
+* \detail Every combination of the argument block lengths, data rates, ARD/ARC pairs and batch sizes is run with bench_runOne(). Without \c port->sync only the current data rate is used. The radio configuration (data rate, ARD, ARC) is restored afterwards.
+* \param port	- the port;
+* \return amount of results passed to \c port->emit;
+* \sa bench_runOne(),bench_format()
+*/
+uint16_t bench_run(const bench_port* port){
+	uint8_t rf_setupReg=nRF24_getRegister(port->radio,RF_SETUP),setup_retrReg=nRF24_getRegister(port->radio,SETUP_RETR),dataRate=bench_dataRate(port->radio);
+	uint8_t a,d,r,b;
+	uint16_t results=0;
+	bench_config config;
+	bench_result result;
+
+	for(a=0; a<L4R_ARGS_MAX; a++){
+		bench_args[a]=a;
+	}
+	for(d=0; d<sizeof(bench_dataRates); d++){
+		if(!port->sync && bench_dataRates[d]!=dataRate){
+			continue; //the peer would not hear us
+		}
+		for(a=0; a<sizeof(bench_argLens); a++){
+			for(r=0; r<sizeof(bench_retrans)/sizeof(bench_retrans[0]); r++){
+				for(b=0; b<sizeof(bench_batches); b++){
+					config.argLen=bench_argLens[a];
+					config.dataRate=bench_dataRates[d];
+					config.ard=bench_retrans[r][0];
+					config.arc=bench_retrans[r][1];
+					config.batch=bench_batches[b];
+					bench_runOne(port,&config,&result);
+					port->emit(&result);
+					results++;
+				}
+			}
+		}
+	}
+
+	nRF24_batchBegin(port->radio);
+	nRF24_updateRegister(port->radio,RF_SETUP,rf_setupReg);
+	nRF24_updateRegister(port->radio,SETUP_RETR,setup_retrReg);
+	nRF24_batchCommit(port->radio);
+	if(port->sync){
+		config.dataRate=dataRate;
+		config.ard=(setup_retrReg>>4) & 0x0F;
+		config.arc=setup_retrReg & 0x0F;
+		port->sync(&config);
+	}
+
+	return results;
+}
+
+/*! Get the CSV header line matching bench_format().
+* \return the header line;
+*/
+const char* bench_header(void){
+	return "rev,target,arg_len,data_rate,ard,arc,batch,commands,delivered,elapsed_us,commands_per_s,latency_us,rtt_us,replies,samples,timeouts,retransmits,lost";
+}
+
+/*! Format a result as one CSV line.
+* \param result	- the result;
+* \param target	- target name;
+* \param line	- destination buffer (\c BENCH_LINE_LEN bytes);
+* \return line length;
+* \sa bench_header()
+*/
+int bench_format(const bench_result* result, const char* target, char* line){
+	return snprintf(line,BENCH_LINE_LEN,"%s,%s,%u,%u,%u,%u,%u,%u,%u,%lu,%lu,%lu,%lu,%u,%u,%u,%u,%u",
+		BENCH_REV,target,
+		result->config.argLen,result->config.dataRate,result->config.ard,result->config.arc,result->config.batch,
+		result->commands,result->delivered,(unsigned long)result->elapsedUs,(unsigned long)result->commandsPerSec,
+		(unsigned long)result->latencyUs,(unsigned long)result->rttUs,
+		result->replies,BENCH_SAMPLES,result->timeouts,result->retransmits,result->lost);
+}
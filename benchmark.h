@@ -0,0 +1,117 @@
+/*! \brief The header file with the lang4robots benchmark suite.
+*	\file benchmark.h
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the end-to-end benchmark of lang4robots: command throughput, one-way latency, round-trip latency of lang4robots_sendCommandAndWait(), retransmissions and packet loss, swept over the argument block size, the data rate, the ARD/ARC settings and the batch size.
+* \par The suite runs on the board (\c BENCHMARK in main.c, against a second board running the normal firmware) and on the host against the simulated radio (\c benchHost.c, built with \b NRF24_SIM). Every result is passed to the port as a \c bench_result and may be formatted as one CSV line (bench_format()), tagged with \c BENCH_REV, so results of different firmware revisions can be compared.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifndef BENCHMARK_H
+	#define BENCHMARK_H
+
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
+	#include "delay.h"
+	#include "nRF24.h"
+	#include "lang4robots.h"
+
+	/*! \name BENCHMARK SETTINGS
+	* Benchmark run settings.
+	* @{
+	*/
+	/********************
+	* BENCHMARK SETTINGS
+	********************/
+	#ifndef BENCH_REV
+		#define BENCH_REV					"unknown"	//!< Firmware revision written to every result line; pass e.g. \c -DBENCH_REV=\"$(git describe)\"
+	#endif
+	#define BENCH_OPCODE					0				//!< Command used by every test
+	#define BENCH_COMMANDS				32			//!< Commands queued by the throughput test
+	#define BENCH_SAMPLES					8				//!< Samples of each latency test
+	#define BENCH_TIMEOUT_US			1000000	//!< Longest wait for the TX stream to drain
+	#define BENCH_LINE_LEN				160			//!< Buffer size needed by bench_format()
+	//!@}
+
+	/*! \name BENCHMARK TYPES
+	* @{
+	*/
+	/*****************
+	* BENCHMARK TYPES
+	*****************/
+	/*! One point of the sweep. */
+	typedef struct{
+		uint8_t argLen;			//!< argument block length of every command (0-\c L4R_ARGS_MAX)
+		uint8_t dataRate;		//!< nRF24_setRFdataRate() value: \c 0 - 250 kbps, \c 1 - 1 Mbps, \c 2 - 2 Mbps
+		uint8_t ard;				//!< nRF24_setAutoRetranDelay() value
+		uint8_t arc;				//!< nRF24_setAutoRetranCount() value
+		uint8_t batch;			//!< commands queued before every lang4robots_flush()
+	}bench_config;
+
+	/*! Results of one point of the sweep. */
+	typedef struct{
+		bench_config config;
+		uint16_t commands;				//!< commands queued by the throughput test
+		uint32_t elapsedUs;				//!< throughput test time, until the TX stream is empty
+		uint16_t delivered;				//!< commands of the throughput test in frames delivered
+		uint32_t commandsPerSec;	//!< throughput: commands delivered per second
+		uint32_t latencyUs;				//!< mean one-way latency: lang4robots_sendCommandWithArgs() until the frame is acknowledged (\c TX_DS)
+		uint32_t rttUs;						//!< mean round-trip latency of the answered lang4robots_sendCommandAndWait() calls, \c 0 - none answered
+		uint8_t replies;					//!< answered lang4robots_sendCommandAndWait() calls out of \c BENCH_SAMPLES
+		uint8_t timeouts;					//!< waits longer than \c BENCH_TIMEOUT_US
+		uint16_t retransmits;			//!< retransmissions of the throughput frames (see the delivery hook) and the sum of nRF24_getPacketRetranCount() after every one-way sample
+		uint16_t lost;						//!< packets given up (nRF24_getPacketLossCount() increase, counted per test)
+	}bench_result;
+
+	/*! Benchmark port - what differs between the board and the host.
+	*/
+	typedef struct{
+		const char* target;													//!< target name written to the results, e.g. \c "board" or \c "sim"
+		void (*emit)(const bench_result* result);		//!< called with every result
+		void (*sync)(const bench_config* config);		//!< makes the peer follow the data rate; \c 0 - the peer is fixed, points with other data rates are skipped
+		uint8_t* addr;															//!< peer address
+		nrf24_dev* radio;														//!< the module the commands are sent from
+	}bench_port;
+	//!@}
+
+	/*! \name BENCHMARK FUNCTIONS
+	* @{
+	*/
+	/*********************
+	* BENCHMARK FUNCTIONS
+	*********************/
+	/*! Run the whole sweep.
+	* \detail The radio configuration (data rate, ARD, ARC) is restored afterwards.
+	* \param port	- the port;
+	* \return amount of results passed to \c port->emit;
+	* \sa bench_runOne()
+	*/
+	uint16_t bench_run(const bench_port* port);
+
+	/*! Run the tests of one point of the sweep.
+	* \param port	- the port;
+	* \param config	- the point;
+	* \param result	- the results;
+	*/
+	void bench_runOne(const bench_port* port, const bench_config* config, bench_result* result);
+
+	/*! Format a result as one CSV line.
+	* \param result	- the result;
+	* \param target	- target name;
+	* \param line	- destination buffer (\c BENCH_LINE_LEN bytes);
+	* \return line length;
+	* \sa bench_header()
+	*/
+	int bench_format(const bench_result* result, const char* target, char* line);
+
+	/*! Get the CSV header line matching bench_format().
+	* \return the header line;
+	*/
+	const char* bench_header(void);
+	//!@}
+
+#endif
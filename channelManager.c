@@ -0,0 +1,286 @@
+/*! \brief The source file with the radio channel manager.
+*	\file channelManager.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the definition of the channel scan, the hop decision of the master and the fallback walk of the slaves.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#include "channelManager.h"
+
+static const uint8_t channel_hopSet[CHANNEL_HOP_NR]=CHANNEL_HOP_SET;	//!< Hop set.
+static nrf24_dev* channel_radio;									//!< The module the link runs on.
+static uint8_t channel_activity[CHANNEL_HOP_NR];	//!< \c RPD hits of the last scan.
+static uint8_t channel_role;											//!< \c channel_Role.
+static uint8_t channel_index;											//!< Current hop set index.
+static uint16_t channel_hops;											//!< Channel changes since channel_init().
+static channel_announce channel_announceHook;			//!< Announcement hook of the master.
+static uint32_t channel_windowEnd;								//!< End of the loss window (master).
+static uint32_t channel_holdEnd;									//!< End of the hold time (master).
+static uint32_t channel_beaconAt;									//!< Next beacon (master).
+static volatile uint32_t channel_heardAt;					//!< delay_micros() time stamp the master was last heard at (slave).
+static uint32_t channel_dwellEnd;									//!< End of the dwell on the current channel of the walk (slave).
+
+/*! Wait until the TX stream is empty - \c RF_CH must not change under a payload.
+*/
+static void channel_drain(void){
+	while(nRF24_streamBusy(channel_radio)){delay_yield();}
+}
+
+/*! Bring the module back to its mode after the channel has been changed.
+* \param state	- \c nRF24_State before the change;
+*/
+static void channel_restore(enum nRF24_State state){
+	if(state==STATE_RX){
+		nRF24_modeRX(channel_radio);
+	}else if(state==STATE_POWER_DOWN){
+		nRF24_powerDown(channel_radio);
+	}
+}
+
+/*! Tune the module to a channel of the hop set.
+* \detail \c RF_CH is written even if it does not change, so the packet loss counter is reset in any case.
+* \param index	- hop set index;
+* \return the \c RF_CH value tuned to;
+*/
+static uint8_t channel_tune(uint8_t index){
+	uint8_t rf_chReg=channel_hopSet[index];
+	enum nRF24_State state;
+	uint32_t primask;
+
+	channel_drain();
+	state=nRF24_getState(channel_radio);
+	for(;;){
+		nRF24_standby(channel_radio); //mode changes are made with the interrupts enabled, they may wait for the oscillator start-up
+		primask=__get_PRIMASK(); //the module IRQ handler may have started a stream meanwhile
+		__disable_irq();
+		if(!nRF24_streamBusy(channel_radio)){
+			break;
+		}
+		__set_PRIMASK(primask);
+		channel_drain();
+	}
+	if(nRF24_getRegister(channel_radio,RF_CH)==rf_chReg){
+		nRF24_writeRegister(channel_radio,RF_CH,&rf_chReg,1); //PLOS_CNT is reset by the write
+	}else{
+		nRF24_setRFchannel(channel_radio,rf_chReg);
+	}
+	__set_PRIMASK(primask);
+	channel_restore(state);
+	channel_index=index;
+
+	return rf_chReg;
+}
+
+/*! Get the quietest channel of the last scan.
+* \param exclude	- hop set index not to pick, \c 0xFF - none;
+* \return hop set index; on a tie the earliest one after the current channel;
+*/
+static uint8_t channel_quietest(uint8_t exclude){
+	uint8_t i,index,best=0xFF;
+
+	for(i=1; i<=CHANNEL_HOP_NR; i++){
+		index=(channel_index+i)%CHANNEL_HOP_NR;
+		if(index!=exclude && (best==0xFF || channel_activity[index]<channel_activity[best])){
+			best=index;
+		}
+	}
+
+	return best;
+}
+
+/*! Initialize the channel manager.
+* \detail Call it after nRF24_init(). The master scans the hop set and tunes to the quietest channel; a slave tunes to the first channel and walks the hop set if it does not hear the master.
+* \param radio	- the module the link runs on;
+* \param role	- \c channel_Role;
+* \return the \c RF_CH value tuned to;
+*/
+uint8_t channel_init(nrf24_dev* radio, uint8_t role){
+	uint32_t now=delay_micros();
+
+	channel_radio=radio;
+	channel_role=role;
+	channel_index=0;
+	channel_hops=0;
+	channel_heardAt=now;
+	channel_dwellEnd=now;
+	channel_windowEnd=now+CHANNEL_WINDOW_MS*1000UL;
+	channel_holdEnd=now;
+	channel_beaconAt=now;
+	if(role==CHANNEL_MASTER){
+		return channel_tune(channel_scan());
+	}
+
+	return channel_tune(0);
+}
+
+/*! Set the announcement hook of the master.
+* \param announce	- the hook; \c 0 - no announcements, the slaves find the master by walking the hop set;
+*/
+void channel_setAnnounce(channel_announce announce){
+	channel_announceHook=announce;
+}
+
+/*! Measure the activity on every channel of the hop set.
+* \detail Every channel is listened to \c CHANNEL_SCAN_SAMPLES times, interleaved, for \c nRF24_T_STBY2A_US + \c CHANNEL_RPD_US each, and the \c RPD hits are counted. The current channel and mode are restored afterwards. Waits for the TX stream to drain first.
+* \return hop set index of the quietest channel (the earliest one after the current channel on a tie);
+* \sa channel_getActivity()
+*/
+uint8_t channel_scan(void){
+	enum nRF24_State state;
+	uint8_t i,sample,rpdReg;
+
+	channel_drain();
+	state=nRF24_getState(channel_radio);
+	for(i=0; i<CHANNEL_HOP_NR; i++){
+		channel_activity[i]=0;
+	}
+	for(sample=0; sample<CHANNEL_SCAN_SAMPLES; sample++){ //interleaved, so a burst on one channel is not sampled only once
+		for(i=0; i<CHANNEL_HOP_NR; i++){
+			nRF24_standby(channel_radio); //RPD is latched only in RX mode and cleared when RX is left
+			nRF24_setRFchannel(channel_radio,channel_hopSet[i]);
+			nRF24_modeRX(channel_radio);
+			delay_us(nRF24_T_STBY2A_US+CHANNEL_RPD_US);
+			nRF24_readRegister(channel_radio,RPD,&rpdReg,1);
+			if(rpdReg & RPD_MASK){
+				channel_activity[i]++;
+			}
+		}
+	}
+	nRF24_standby(channel_radio);
+	nRF24_setRFchannel(channel_radio,channel_hopSet[channel_index]);
+	channel_restore(state);
+
+	return channel_quietest(0xFF);
+}
+
+/*! Get the activity measured by the last channel_scan().
+* \param index	- hop set index;
+* \return \c RPD hits (0-\c CHANNEL_SCAN_SAMPLES) or \c 0xFF if \c index is out of the hop set;
+*/
+uint8_t channel_getActivity(uint8_t index){
+	if(index>=CHANNEL_HOP_NR){
+		return 0xFF; //error avoidance
+	}
+
+	return channel_activity[index];
+}
+
+/*! Move the link to another channel (master).
+* \detail The new index is announced on the current channel, the TX stream is drained and the module is tuned; it keeps listening if it was. The loss window starts again and the master holds the channel for \c CHANNEL_HOLD_MS.
+* \param index	- hop set index;
+* \return the \c RF_CH value tuned to or \c 0xFF if \c index is out of the hop set;
+*/
+uint8_t channel_hop(uint8_t index){
+	uint8_t rf_chReg;
+	uint32_t now;
+
+	if(index>=CHANNEL_HOP_NR){
+		return 0xFF; //error avoidance
+	}
+	if(channel_announceHook){
+		channel_announceHook(index);
+	}
+	rf_chReg=channel_tune(index); //the announcement leaves first
+	channel_hops++;
+	now=delay_micros();
+	channel_windowEnd=now+CHANNEL_WINDOW_MS*1000UL;
+	channel_holdEnd=now+CHANNEL_HOLD_MS*1000UL;
+	channel_beaconAt=now;
+
+	return rf_chReg;
+}
+
+/*! Follow the master to another channel (slave).
+* \param index	- hop set index announced by the master;
+* \return the \c RF_CH value tuned to or \c 0xFF if \c index is out of the hop set;
+* \sa channel_command()
+*/
+uint8_t channel_follow(uint8_t index){
+	if(index>=CHANNEL_HOP_NR){
+		return 0xFF; //error avoidance
+	}
+	channel_heardAt=delay_micros();
+	if(index==channel_index){
+		return channel_hopSet[index]; //a beacon
+	}
+	channel_hops++;
+
+	return channel_tune(index);
+}
+
+/*! Announcement command handler - list it in a lang4robots command registry of the slaves.
+* \detail <tt>L4R_COMMAND(comChannel, channel_command, channel_args)</tt>
+* \param args	- the announcement;
+* \return the hop set index followed;
+* \sa channel_follow()
+*/
+uint32_t channel_command(const channel_args* args){
+	if(channel_role==CHANNEL_SLAVE){
+		channel_follow(args->index);
+	}
+
+	return channel_index;
+}
+
+/*! Mark that the master has been heard (slave).
+* \detail Call it from the module IRQ handler on \c RX_DR; the slave stays on the channel as long as it hears the master.
+*/
+void channel_heard(void){
+	channel_heardAt=delay_micros();
+}
+
+/*! Run the channel schedule.
+* \detail Call it from the main loop. The master reads the packet loss counter every \c CHANNEL_WINDOW_MS and hops to the quietest other channel (a fresh channel_scan()) after \c CHANNEL_HOP_LOSSES lost packets, unless it holds the channel; it also sends the beacon. A slave that has not heard the master for \c CHANNEL_LOST_MS tunes to the next channel of the hop set every \c CHANNEL_DWELL_MS. Nothing is done while the TX stream runs.
+* \return \c '1' - the channel has been changed, \c '0' - not changed;
+*/
+uint8_t channel_tick(void){
+	uint8_t losses;
+
+	if(nRF24_streamBusy(channel_radio)){
+		return 0;
+	}
+	if(channel_role==CHANNEL_SLAVE){
+		if(!delay_expired(channel_heardAt+CHANNEL_LOST_MS*1000UL) || !delay_expired(channel_dwellEnd)){
+			return 0;
+		}
+		channel_tune((channel_index+1)%CHANNEL_HOP_NR); //the master is lost - walk the hop set
+		channel_hops++;
+		channel_dwellEnd=delay_deadline(CHANNEL_DWELL_MS*1000UL);
+		return 1;
+	}
+
+	if(delay_expired(channel_windowEnd)){
+		losses=nRF24_getPacketLossCount(channel_radio);
+		channel_windowEnd=delay_deadline(CHANNEL_WINDOW_MS*1000UL);
+		if(losses>=CHANNEL_HOP_LOSSES && delay_expired(channel_holdEnd)){
+			channel_scan();
+			channel_hop(channel_quietest(channel_index));
+			return 1;
+		}
+		if(losses){
+			channel_tune(channel_index); //a new window - PLOS_CNT is reset
+		}
+	}
+	if(CHANNEL_BEACON_MS && channel_announceHook && delay_expired(channel_beaconAt)){
+		channel_beaconAt=delay_deadline(CHANNEL_BEACON_MS*1000UL);
+		channel_announceHook(channel_index);
+	}
+
+	return 0;
+}
+
+/*! Get the current hop set index.
+* \return hop set index;
+*/
+uint8_t channel_getIndex(void){
+	return channel_index;
+}
+
+/*! Get the number of channel changes since channel_init().
+* \return number of hops (for a slave: follows and walk steps);
+*/
+uint16_t channel_getHops(void){
+	return channel_hops;
+}
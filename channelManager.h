@@ -0,0 +1,140 @@
+/*! \brief The header file with the radio channel manager.
+*	\file channelManager.h
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the channel manager: the channels of the hop set are scanned with the Received Power Detector (\c RPD), the quietest one is used and the link hops away from a channel as soon as its packet loss rate (\c PLOS_CNT of \c OBSERVE_TX, i.e. \c MAX_RT events) gets too high.
+* \par The master decides: it scans, hops and tells the slaves the new hop set index through a hook (see channel_setAnnounce()), normally a lang4robots command executed by channel_command() on the slaves. The announcement is repeated as a beacon. A slave that has missed it hears nothing on the old channel and falls back to walking the hop set, \c CHANNEL_DWELL_MS on every channel, until it hears the master again; the master holds the new channel long enough for a whole walk.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifndef CHANNELMANAGER_H
+	#define CHANNELMANAGER_H
+
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
+	#include "delay.h"
+	#include "nRF24.h"
+
+	/*! \name CHANNEL SETTINGS
+	* Channel manager settings.
+	* @{
+	*/
+	/******************
+	* CHANNEL SETTINGS
+	******************/
+	/*! Hop set - \c RF_CH values, in the order walked by the slaves.
+	* \detail Only channels inside the 2400-2483.5 MHz ISM band (\c RF_CH up to 83) may be used. The set has three groups. Channels 2, 26 and 50 lie in the gaps around Wi-Fi channels 1, 6 and 11. Channels 76, 80 and 83 lie above Wi-Fi channel 11. Channels 64 and 72 lie inside Wi-Fi channel 11 and are picked only when the scan finds them quiet. Must be the same on the master and the slaves.
+	*/
+	#define CHANNEL_HOP_SET				{76,2,26,50,80,64,83,72}
+	#define CHANNEL_HOP_NR				8			//!< Number of channels in \c CHANNEL_HOP_SET
+	#define CHANNEL_SCAN_SAMPLES	4			//!< \c RPD samples taken on every channel by channel_scan()
+	#define CHANNEL_RPD_US				40		//!< Time in RX mode after \c nRF24_T_STBY2A_US before \c RPD is valid
+	#define CHANNEL_WINDOW_MS			200		//!< Packet loss evaluation window of the master
+	#define CHANNEL_HOP_LOSSES		3			//!< Lost packets (\c MAX_RT) within a window that make the master hop (1-15)
+	#define CHANNEL_BEACON_MS			100		//!< Announcement repeat period of the master, \c 0 - no beacon
+	#define CHANNEL_LOST_MS				500		//!< Silence after which a slave starts walking the hop set
+	#define CHANNEL_DWELL_MS			250		//!< Time a walking slave listens on every channel; keep it above \c CHANNEL_BEACON_MS
+	#define CHANNEL_HOLD_MS				(CHANNEL_LOST_MS+CHANNEL_HOP_NR*CHANNEL_DWELL_MS)	//!< Time the master stays on a new channel, so the slaves can find it
+
+	/*! Channel manager role. */
+	enum channel_Role{
+		CHANNEL_MASTER,	//!< scans, hops and announces
+		CHANNEL_SLAVE		//!< follows the announcements, walks the hop set when the master is lost
+	};
+
+	/*! Announcement hook type.
+	* \detail The hook sends the hop set index to the slaves (e.g. a lang4robots command executed by channel_command()). It is called on the current channel; the channel is changed after the TX stream has drained.
+	* \sa channel_setAnnounce()
+	*/
+	typedef void (*channel_announce)(uint8_t index);
+
+	/*! Argument structure of the announcement command.
+	* \sa channel_command()
+	*/
+	typedef struct{
+		uint8_t index;	//!< hop set index the master is on (or moves to)
+	}channel_args;
+	//!@}
+
+	/*! \name CHANNEL FUNCTIONS
+	* Channel manager functions.
+	* @{
+	*/
+	/*******************
+	* CHANNEL FUNCTIONS
+	*******************/
+	/*! Initialize the channel manager.
+	* \detail Call it after nRF24_init(). The master scans the hop set and tunes to the quietest channel; a slave tunes to the first channel and walks the hop set if it does not hear the master.
+	* \param radio	- the module the link runs on;
+	* \param role	- \c channel_Role;
+	* \return the \c RF_CH value tuned to;
+	*/
+	uint8_t channel_init(nrf24_dev* radio, uint8_t role);
+
+	/*! Set the announcement hook of the master.
+	* \param announce	- the hook; \c 0 - no announcements, the slaves find the master by walking the hop set;
+	*/
+	void channel_setAnnounce(channel_announce announce);
+
+	/*! Measure the activity on every channel of the hop set.
+	* \detail Every channel is listened to \c CHANNEL_SCAN_SAMPLES times, interleaved, for \c nRF24_T_STBY2A_US + \c CHANNEL_RPD_US each, and the \c RPD hits are counted. The current channel and mode are restored afterwards. Waits for the TX stream to drain first.
+	* \return hop set index of the quietest channel (the earliest one after the current channel on a tie);
+	* \sa channel_getActivity()
+	*/
+	uint8_t channel_scan(void);
+
+	/*! Get the activity measured by the last channel_scan().
+	* \param index	- hop set index;
+	* \return \c RPD hits (0-\c CHANNEL_SCAN_SAMPLES) or \c 0xFF if \c index is out of the hop set;
+	*/
+	uint8_t channel_getActivity(uint8_t index);
+
+	/*! Move the link to another channel (master).
+	* \detail The new index is announced on the current channel, the TX stream is drained and the module is tuned; it keeps listening if it was. The loss window starts again and the master holds the channel for \c CHANNEL_HOLD_MS.
+	* \param index	- hop set index;
+	* \return the \c RF_CH value tuned to or \c 0xFF if \c index is out of the hop set;
+	*/
+	uint8_t channel_hop(uint8_t index);
+
+	/*! Follow the master to another channel (slave).
+	* \param index	- hop set index announced by the master;
+	* \return the \c RF_CH value tuned to or \c 0xFF if \c index is out of the hop set;
+	* \sa channel_command()
+	*/
+	uint8_t channel_follow(uint8_t index);
+
+	/*! Announcement command handler - list it in a lang4robots command registry of the slaves.
+	* \detail <tt>L4R_COMMAND(comChannel, channel_command, channel_args)</tt>
+	* \param args	- the announcement;
+	* \return the hop set index followed;
+	* \sa channel_follow()
+	*/
+	uint32_t channel_command(const channel_args* args);
+
+	/*! Mark that the master has been heard (slave).
+	* \detail Call it from the module IRQ handler on \c RX_DR; the slave stays on the channel as long as it hears the master.
+	*/
+	void channel_heard(void);
+
+	/*! Run the channel schedule.
+	* \detail Call it from the main loop. The master reads the packet loss counter every \c CHANNEL_WINDOW_MS and hops to the quietest other channel (a fresh channel_scan()) after \c CHANNEL_HOP_LOSSES lost packets, unless it holds the channel; it also sends the beacon. A slave that has not heard the master for \c CHANNEL_LOST_MS tunes to the next channel of the hop set every \c CHANNEL_DWELL_MS. Nothing is done while the TX stream runs.
+	* \return \c '1' - the channel has been changed, \c '0' - not changed;
+	*/
+	uint8_t channel_tick(void);
+
+	/*! Get the current hop set index.
+	* \return hop set index;
+	*/
+	uint8_t channel_getIndex(void);
+
+	/*! Get the number of channel changes since channel_init().
+	* \return number of hops (for a slave: follows and walk steps);
+	*/
+	uint16_t channel_getHops(void);
+	//!@}
+
+#endif
@@ -2,35 +2,165 @@
 * \file delay.c
 *	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
 *
-* This file contains definition of delay loops used in other modules.
+* This file contains definition of delay loops used in other modules, together with the SysTick based microsecond clock and deadline primitives they are built on.
 *
 * \b Copyright: Sebastian Pisklak & Jakub Olak
 */
 
 #include "delay.h"
+#include "spiTrace.h"
+
+#ifndef NRF24_SIM
+
+#define DELAY_TICKS_PER_US	(F_CPU_DEF/1000000)	//!< SysTick counts per microsecond.
+
+static volatile uint32_t delay_msTicks; //!< Milliseconds since delay_init(), incremented by SysTick_Handler().
+
+/*! SysTick interrupt handler - the millisecond tick of the clock.
+*/
+void SysTick_Handler(void){
+	delay_msTicks++;
+}
+
+/*! Start the microsecond clock.
+* \detail SysTick is clocked from the core clock and interrupts once per millisecond; the microseconds in between are read from the SysTick counter. The clock counts from the first call; every delay function starts it if needed.
+* \sa delay_micros()
+*/
+void delay_init(void){
+	if(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk){
+		return;
+	}
+	SysTick->LOAD=F_CPU_DEF/1000-1;
+	SysTick->VAL=0;
+	NVIC_SetPriority(SysTick_IRQn,DELAY_SYSTICK_PRIORITY);
+	SysTick->CTRL=SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+/*! Get the monotonic microsecond clock.
+* \detail A tick whose interrupt is pending (masked with \c PRIMASK, or by an interrupt handler of the same or a higher priority) is counted here and cleared, so the clock keeps running in masked sections as long as it is read at least once a millisecond (e.g. by delay_until()).
+* \return microseconds since delay_init(); wraps around after about 71 minutes, use delay_expired() to compare time stamps;
+* \sa delay_deadline(),delay_expired()
+*/
+uint32_t delay_micros(void){
+	uint32_t ms,ticks,primask;
+	
+	if(!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk)){
+		delay_init();
+	}
+	primask=__get_PRIMASK();
+	__disable_irq();
+	ticks=SysTick->VAL;
+	if(SCB->ICSR & SCB_ICSR_PENDSTSET_Msk){
+		SCB->ICSR=SCB_ICSR_PENDSTCLR_Msk; //the tick is counted here instead of in SysTick_Handler()
+		delay_msTicks++;
+		ticks=SysTick->VAL; //the counter has wrapped around, read again
+	}
+	ms=delay_msTicks;
+	__set_PRIMASK(primask);
+	
+	return ms*1000+(F_CPU_DEF/1000-1-ticks)/DELAY_TICKS_PER_US;
+}
+
+/*! Move the clock forward.
+* \detail Used after a low-power stop mode, in which SysTick does not run.
+* \param ms	- amount of milliseconds spent with SysTick stopped;
+*/
+void delay_advance(uint32_t ms){
+	delay_msTicks+=ms;
+}
+
+#else
+
+/*! Start the microsecond clock.
+* \detail The host build runs on the simulation clock, which starts with nRF24sim_reset().
+*/
+void delay_init(void){
+}
+
+/*! Get the monotonic microsecond clock.
+* \return simulated microseconds (see nRF24sim_micros());
+*/
+uint32_t delay_micros(void){
+	return nRF24sim_micros();
+}
+
+/*! Move the clock forward.
+* \param ms	- amount of milliseconds to run the simulation for;
+*/
+void delay_advance(uint32_t ms){
+	nRF24sim_runUntil(nRF24sim_micros()+ms*1000);
+}
+
+#endif
+
+/*! Give way while spinning on a condition.
+* \detail Nothing to do on the target, the condition is changed by an interrupt. In the host build the simulated time moves on, so that the radio events (and the IRQ handlers) can come.
+* \sa delay_until()
+*/
+void delay_yield(void){
+#ifdef NRF24_SIM
+	nRF24sim_yield();
+#endif
+}
+
+/*! Get a deadline.
+* \param timeout	- amount of microseconds from now (less than 2^31);
+* \return the deadline time stamp for delay_expired();
+* \sa delay_expired()
+*/
+uint32_t delay_deadline(uint32_t timeout){
+	return delay_micros()+timeout;
+}
+
+/*! Check a deadline without waiting.
+* \param deadline	- time stamp returned by delay_deadline() (or any delay_micros() value);
+* \return \c '1' - the deadline has passed, \c '0' - not yet;
+* \sa delay_deadline(),delay_until()
+*/
+_Bool delay_expired(uint32_t deadline){
+	return (int32_t)(delay_micros()-deadline)>=0;
+}
+
+/*! Wait for a deadline.
+* \detail Returns at once if the deadline has already passed, so a wait started early costs nothing. While at least \c DELAY_SLEEP_MIN_US is left, the core sleeps (\c WFI) between SysTick interrupts; not in an interrupt handler, which SysTick might not preempt.
+* \param deadline	- time stamp returned by delay_deadline();
+* \sa delay_expired()
+*/
+void delay_until(uint32_t deadline){
+	uint32_t start=SPI_TRACE_NOW();
+	
+	while(!delay_expired(deadline)){
+#ifndef NRF24_SIM
+		if((int32_t)(deadline-delay_micros())>=DELAY_SLEEP_MIN_US && !__get_IPSR()){
+			__WFI(); //woken up by the SysTick interrupt at the latest, even with PRIMASK set
+			continue;
+		}
+#endif
+		delay_yield();
+	}
+	SPI_TRACE_DELAY(start);
+}
 
 /*! Wait for time given in milliseconds.
+* \detail The core sleeps (\c WFI) between SysTick interrupts.
 * \param value	- amount of milliseconds delay;
-* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay loop execution may be different than expected.
+* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay may be different than expected.
 * \sa delay_us()
 */
 void delay_ms(uint32_t value){
-	uint32_t delay, x;
+	uint32_t deadline=delay_deadline(value*1000),start=SPI_TRACE_NOW();
 	
-	for(x=0; x < value; x++){
-		for(delay=0; delay < F_CPU_DEF/1000/5; delay++){;}
+	while(!delay_expired(deadline)){
+		__WFI(); //woken up by the SysTick interrupt at the latest
 	}
+	SPI_TRACE_DELAY(start);
 }
 
 /*! Wait for time given in microseconds.
 * \param value	- amount of microseconds delay;
-* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay loop execution may be different than expected.
+* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay may be different than expected.
 * \sa delay_ms()
 */
 void delay_us(uint32_t value){
-	uint32_t delay, x;
-	
-	for(x=0; x < value; x++){
-		for(delay=0; delay < F_CPU_DEF/1000000/5; delay++){;}
-	}
+	delay_until(delay_deadline(value));
 }
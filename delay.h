@@ -2,7 +2,7 @@
 * \file delay.h
 *	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
 *
-* This file contains declaration of delay loops used in other modules.
+* This file contains declaration of delay loops used in other modules, together with the SysTick based microsecond clock and deadline primitives they are built on.
 *
 * \b Copyright: Sebastian Pisklak & Jakub Olak
 */
@@ -10,24 +10,80 @@
 #ifndef delay_h
 	#define delay_h
 
-	#include "MKL46Z4.h"   /* Device header */	
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"   /* Device header */
+	#endif
 
 	/*!Core clock frequency.
 	*
 	* \warning In order to provide correct delay loops, modify this constant with appropriate value in Hz.
 	*/
 	#define F_CPU_DEF 48000000
+	
+	/*! SysTick interrupt priority (the tick only increments a counter). */
+	#define DELAY_SYSTICK_PRIORITY	0
+	
+	/*! Shortest time left to a deadline for delay_until() to sleep (\c WFI) until the next SysTick interrupt; shorter waits spin. */
+	#define DELAY_SLEEP_MIN_US	1000
+
+	/*! Start the microsecond clock.
+	* \detail SysTick is clocked from the core clock and interrupts once per millisecond; the microseconds in between are read from the SysTick counter. The clock counts from the first call; every delay function starts it if needed.
+	* \sa delay_micros()
+	*/
+	void delay_init(void);
+	
+	/*! Get the monotonic microsecond clock.
+	* \return microseconds since delay_init(); wraps around after about 71 minutes, use delay_expired() to compare time stamps;
+	* \sa delay_deadline(),delay_expired()
+	*/
+	uint32_t delay_micros(void);
+	
+	/*! Move the clock forward.
+	* \detail Used after a low-power stop mode, in which SysTick does not run.
+	* \param ms	- amount of milliseconds spent with SysTick stopped;
+	*/
+	void delay_advance(uint32_t ms);
+	
+	/*! Give way while spinning on a condition.
+	* \detail Nothing to do on the target, the condition is changed by an interrupt. In the host build the simulated time moves on, so that the radio events (and the IRQ handlers) can come.
+	* \sa delay_until()
+	*/
+	void delay_yield(void);
+	
+	/*! Get a deadline.
+	* \param timeout	- amount of microseconds from now (less than 2^31);
+	* \return the deadline time stamp for delay_expired();
+	* \sa delay_expired()
+	*/
+	uint32_t delay_deadline(uint32_t timeout);
+	
+	/*! Check a deadline without waiting.
+	* \param deadline	- time stamp returned by delay_deadline() (or any delay_micros() value);
+	* \return \c '1' - the deadline has passed, \c '0' - not yet;
+	* \sa delay_deadline(),delay_until()
+	*/
+	_Bool delay_expired(uint32_t deadline);
+	
+	/*! Wait for a deadline.
+	* \detail Returns at once if the deadline has already passed, so a wait started early costs nothing. While at least \c DELAY_SLEEP_MIN_US is left, the core sleeps (\c WFI) between SysTick interrupts; not in an interrupt handler, which SysTick might not preempt.
+	* \param deadline	- time stamp returned by delay_deadline();
+	* \sa delay_expired()
+	*/
+	void delay_until(uint32_t deadline);
 
 	/*! Wait for time given in milliseconds.
+	* \detail The core sleeps (\c WFI) between SysTick interrupts.
 	* \param value	- amount of milliseconds delay;
-	* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay loop execution may be different than expected.
+	* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay may be different than expected.
 	* \sa delay_us()
 	*/
 	void delay_ms(uint32_t value);
 	
 	/*! Wait for time given in microseconds.
 	* \param value	- amount of microseconds delay;
-	* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay loop execution may be different than expected.
+	* \note Remember to modify the \b F_CPU_DEF in delay.h with the appropriate core clock frequency. Otherwise, the time of delay may be different than expected.
 	* \sa delay_ms()
 	*/
 	void delay_us(uint32_t value);
@@ -8,16 +8,13 @@
 *	\b HOW \b TO \b DESIGN \b YOUR \b OWN \b LANGUAGE?
 *
 *	\e #lang4robots.h:
-*	- add language instructions you wish to implement (up to 256) simply by writing their declarations in *COMMAND HANDLERS* section. You may rename they as you wish.
-*	\warning All your instructions have to be the same type as defined \c commandHandler (C language restrictions) - by default it's \c 'uint32_t \c fun(uint32_t)', but you may adjust them according to your needs.
-*	\par Remember to obey this rule, otherwise it may cause malfuction.
-*	- modify \c 'enum \c CommandType' so that its enumerated members names fit your instructions name (in the same order!). It is recommended to start with first member's value = \c '0' and to name the members in the same order as your instructions name in *COMMAND HANDLERS* section without changing their values.
-*	- modify the defined value \c COMMANDS_NR with the number of your language instructions
-*	- optional: if you like, add more \c CommandType variables or declare more handlersArrays
+*	- add language instructions you wish to implement (up to 255) simply by adding their \c L4R_COMMAND(name, handler, argType) entries to \c L4R_COMMANDS in *COMMAND REGISTRY* section. The command number, the \c 'enum \c CommandType' member, the handler declaration, the dispatch table entry and the argument size are all generated from that entry.
+*	- optional: declare the argument structure of your instructions in the same section; every handler gets a pointer to its own argument type.
+*	- optional: if you like, add more \c CommandType variables
+*	- optional: give a data pipe a language of its own - declare another command table with \c L4R_TABLE_DECLARE, define it with \c L4R_TABLE_DEFINE and bind it with lang4robots_bindTable()
 *
 *	\e #lang4robots.c:
-*	- write your instructions functionality in the same order as declared in \c 'lang4robots.h'
-*	-	initialize your \c handlerArray(s) with written functions pointers. IT IS VITAL TO FILL THE ARRAY IN THE SAME ORDER AS GOES IN \c 'enum \c CommandType'! Otherwise, the command names does not match their functions and executing a specific command may call a different function.
+*	- write your instructions functionality in *COMMAND HANDLERS* section; the compiler checks every definition against the declaration generated from the registry.
 *
 *	For more information check the project documentation.
 *
@@ -27,6 +24,286 @@
 #include "lang4robots.h"
 #include "slcd.h"
 
+static nrf24_dev* rxRadio;								//!< Module the commands are received on (PRX).
+static nrf24_dev* txRadio;								//!< Module the commands are sent from (PTX); may be \c rxRadio.
+static uint8_t txBuf[L4R_FRAME_MAX];			//!< Frame being packed by lang4robots_queueCommand().
+static uint8_t txLen;											//!< Amount of bytes in \c txBuf, \c '0' - no frame pending.
+static uint8_t txPeer;										//!< \c peers index of the destination of the pending frame.
+static uint8_t txLastSeq;									//!< Sequence number of the frame the last command was queued in.
+static uint32_t txDeadline;								//!< delay_micros() time stamp the pending frame must be sent by.
+static uint8_t streamPeer=0xFF;						//!< \c peers index of the address written to the module, \c 0xFF - none.
+
+/*! Destination of the frames sent. */
+typedef struct{
+	uint8_t addr[5];												//!< radio address
+	uint8_t seq;														//!< sequence number of the next frame
+	_Bool used;															//!< the entry holds a destination
+	volatile _Bool synced;									//!< the last frame finished was delivered, the next ones go without \c L4R_SYNC
+}l4r_peer;
+
+/*! Transmit window entry states past \c l4r_Delivery. */
+enum{
+	L4R_TX_WAITING=L4R_FAILED+1,						//!< in the window, not handed to the radio
+	L4R_TX_QUEUED														//!< in the radio TX stream
+};
+
+/*! Transmit window entry. */
+typedef struct{
+	uint8_t data[L4R_FRAME_MAX];						//!< the frame
+	uint8_t len;														//!< frame length
+	uint8_t peer;														//!< \c peers index of the destination
+	uint8_t tries;													//!< transmissions so far (the current one included)
+	_Bool fetch;														//!< reply fetch: dropped at the first \c MAX_RT, not reported
+	volatile uint8_t state;									//!< \c L4R_TX_WAITING, \c L4R_TX_QUEUED or the \c l4r_Delivery status
+}l4r_txEntry;
+
+/*! Duplicate filter of a data pipe. */
+typedef struct{
+	uint32_t seen;													//!< bit n - sequence number (\c last - n) has been received
+	uint8_t last;														//!< newest sequence number received
+	_Bool synced;														//!< a frame has been received, the window is valid
+	_Bool lastSync;													//!< the newest frame carried \c L4R_SYNC
+}l4r_dupWindow;
+
+static l4r_peer peers[L4R_PEERS_MAX];			//!< Destinations with their sequence numbers.
+static uint8_t peerNext;									//!< \c peers index tried first for a new destination.
+static l4r_txEntry txWindow[L4R_TX_WINDOW];	//!< Frames sent and waiting for their delivery status, oldest first.
+static volatile uint8_t txHead;						//!< Free running write index of \c txWindow, advanced by sendFrame() only.
+static volatile uint8_t txFeed;						//!< Free running index of the first frame not handed to the radio; the frames from \c txTail up to it are in the TX stream.
+static volatile uint8_t txTail;						//!< Free running index of the oldest frame, advanced when its status is known.
+static volatile _Bool txHold;							//!< A software retransmission waits for \c txRetryAt.
+static volatile uint32_t txRetryAt;				//!< delay_micros() time stamp the retransmission may start at.
+static l4r_deliveryHook deliveryHook;			//!< Delivery hook, \c 0 - none.
+static l4r_transportStats txStats;				//!< Transport statistics since lang4robots_init().
+static l4r_dupWindow dupWindows[6];				//!< Duplicate filter of every data pipe.
+static nRF24_frame rxQueue[L4R_RX_QUEUE_LEN];	//!< Received frames queue, filled by the IRQ handler and emptied by the main loop.
+static volatile uint8_t rxHead;						//!< Free running write index of \c rxQueue, advanced by lang4robots_receiveFrames() only.
+static volatile uint8_t rxTail;						//!< Free running read index of \c rxQueue, advanced by lang4robots_receiveCommandWithArgs() only.
+static uint8_t rxBuf[L4R_FRAME_MAX];			//!< The frame being executed.
+static uint8_t rxLen;											//!< Amount of bytes in \c rxBuf.
+static uint8_t rxPos;											//!< Offset of the next command record in \c rxBuf.
+static uint8_t rxPipe;										//!< Data pipe of the frame in \c rxBuf.
+static volatile _Bool replyReady;					//!< A reply has been received; set by the IRQ handler.
+static volatile uint8_t replySeq;					//!< Sequence number of the received reply.
+static volatile uint32_t replyValue;			//!< Return value carried by the received reply.
+static union{
+	commandFrame frame;
+	uint32_t align;													//!< keeps \c frame.args word aligned for the handlers
+}rxCommand;																//!< The last command received.
+static const commandTable* pipeTables[6]={&lang4robots_commands,&lang4robots_commands,&lang4robots_commands,&lang4robots_commands,&lang4robots_commands,&lang4robots_commands};	//!< Command table bound to every data pipe.
+
+/*! Find the destination entry of an address, or make one.
+* \detail A new destination replaces the entry after the last one made that has no frame in the transmit window; the sequence numbers of a new destination start at a time-seeded value with \c L4R_SYNC set.
+* \param addr	- destination radio module address;
+* \return \c peers index or \c 0xFF if every entry has frames in the transmit window;
+*/
+static uint8_t peerFind(uint8_t* addr){
+	uint8_t i,j,n;
+	
+	for(n=0; n<L4R_PEERS_MAX; n++){
+		for(i=0; i<5 && peers[n].addr[i]==addr[i]; i++){;}
+		if(peers[n].used && i==5){
+			return n;
+		}
+	}
+	for(j=0; j<L4R_PEERS_MAX; j++){
+		n=(peerNext+j)%L4R_PEERS_MAX;
+		for(i=txTail; i!=txHead && txWindow[i & (L4R_TX_WINDOW-1)].peer!=n; i++){;}
+		if(!peers[n].used || i==txHead){
+			for(i=0; i<5; i++){
+				peers[n].addr[i]=addr[i];
+			}
+			peers[n].seq=(uint8_t)delay_micros();
+			peers[n].synced=0;
+			peers[n].used=1;
+			if(streamPeer==n){
+				streamPeer=0xFF; //the module holds the address of the replaced destination
+			}
+			peerNext=(n+1)%L4R_PEERS_MAX;
+			return n;
+		}
+	}
+	
+	return 0xFF; //every destination has frames in flight
+}
+
+/*! Check the transmit window for a free entry.
+* \return \c '1' - sendFrame() may be called, \c '0' - the window is full (lang4robots_txDone() makes room);
+*/
+static _Bool windowFree(void){
+	return (uint8_t)(txHead-txTail)<L4R_TX_WINDOW;
+}
+
+/*! Report the delivery status of the oldest frame of the transmit window and remove it.
+* \param status	- \c l4r_Delivery;
+*/
+static void finishFrame(uint8_t status){
+	l4r_txEntry* entry=&txWindow[txTail & (L4R_TX_WINDOW-1)];
+	l4r_delivery delivery;
+	
+	entry->state=status;
+	if(!entry->fetch){
+		peers[entry->peer].synced=(status==L4R_DELIVERED);
+		if(status==L4R_DELIVERED){
+			txStats.delivered++;
+		}else{
+			txStats.failed++;
+		}
+		if(deliveryHook){
+			delivery.addr=peers[entry->peer].addr;
+			delivery.seq=entry->data[0] & L4R_SEQ_MASK;
+			delivery.opcode=entry->data[L4R_FRAME_HDR_LEN];
+			delivery.tries=entry->tries;
+			delivery.status=status;
+			deliveryHook(&delivery);
+		}
+	}
+	txTail++;
+}
+
+/*! Hand the waiting frames of the transmit window to the radio TX stream, in their order.
+* \detail The addresses are changed only after the stream has finished. Called from the main loop and from the module IRQ handler.
+*/
+static void feedFrames(void){
+	l4r_txEntry* entry;
+	uint32_t primask;
+	
+	while(!txHold && txFeed!=txHead){
+		nRF24_powerUp(txRadio); //the start-up is not waited for with the interrupts masked
+		primask=__get_PRIMASK(); //the IRQ handler finishes the frames and rewinds txFeed
+		__disable_irq();
+		entry=&txWindow[txFeed & (L4R_TX_WINDOW-1)];
+		if(entry->peer!=streamPeer){
+			if(nRF24_streamBusy(txRadio)){
+				__set_PRIMASK(primask);
+				return; //frames for the previous destination must leave first
+			}
+			nRF24_batchBegin(txRadio);
+			nRF24_setTXaddr(txRadio,peers[entry->peer].addr);
+			if(ACKenabled){
+				nRF24_setRXaddr(txRadio,0,peers[entry->peer].addr); //required for ACK
+			}
+			nRF24_batchCommit(txRadio);
+			streamPeer=entry->peer;
+		}
+		if(!entry->fetch){
+			entry->data[0]=(entry->data[0] & ~L4R_SYNC) | (peers[entry->peer].synced ? 0 : L4R_SYNC);
+		}
+		if(!nRF24_streamWrite(txRadio,entry->data,entry->len,!ACKenabled)){
+			__set_PRIMASK(primask);
+			return; //queue full, TX_DS makes room
+		}
+		entry->state=L4R_TX_QUEUED;
+		txFeed++;
+		__set_PRIMASK(primask);
+	}
+}
+
+/*! Put a frame into the transmit window.
+* \detail The frame goes to the radio TX stream at once unless frames are waiting before it (see feedFrames()). Call it only with a free entry in the window (see windowFree()).
+* \param peer	- \c peers index of the destination;
+* \param frame	- a pointer to the frame;
+* \param len	- frame length;
+* \param fetch	- \c '1' - a reply fetch, \c '0' - a command frame;
+* \return free running \c txWindow index of the frame (see waitFrame());
+*/
+static uint8_t sendFrame(uint8_t peer, uint8_t* frame, uint8_t len, _Bool fetch){
+	l4r_txEntry* entry;
+	uint8_t i,index;
+	
+	index=txHead;
+	entry=&txWindow[index & (L4R_TX_WINDOW-1)];
+	for(i=0; i<len; i++){
+		entry->data[i]=frame[i];
+	}
+	entry->len=len;
+	entry->peer=peer;
+	entry->tries=1;
+	entry->fetch=fetch;
+	entry->state=L4R_TX_WAITING;
+	__DMB(); //the entry is filled before it is handed over to the IRQ handler
+	txHead++;
+	feedFrames();
+	
+	return index;
+}
+
+/*! Wait until the delivery status of a frame is known, servicing the transmit window.
+* \param index	- free running \c txWindow index returned by sendFrame();
+* \param deadline	- delay_deadline() time stamp to give up at;
+* \return \c l4r_Delivery or \c 0xFF if the deadline has passed first;
+*/
+static uint8_t waitFrame(uint8_t index, uint32_t deadline){
+	while((uint8_t)(index-txTail)<L4R_TX_WINDOW){
+		if(delay_expired(deadline)){
+			return 0xFF; //error avoidance
+		}
+		lang4robots_txService();
+		delay_yield();
+	}
+	
+	return txWindow[index & (L4R_TX_WINDOW-1)].state; //kept until the entry is reused by sendFrame()
+}
+
+/*! Check a received frame against the duplicate filter of its data pipe.
+* \detail A frame ahead of the newest one by less than \c L4R_DUP_WINDOW moves the window; an older one is taken if it has not been seen. A frame with \c L4R_SYNC starts the window again, unless it repeats the newest frame.
+* \param pipe	- data pipe number;
+* \param header	- frame header byte;
+* \return \c '1' - a new frame, \c '0' - a duplicate;
+*/
+static _Bool acceptFrame(uint8_t pipe, uint8_t header){
+	l4r_dupWindow* window=&dupWindows[pipe];
+	uint8_t seq=header & L4R_SEQ_MASK,ahead;
+	
+	ahead=(seq-window->last) & L4R_SEQ_MASK;
+	if(!window->synced || (header & L4R_SYNC)){
+		if(window->synced && ahead==0 && window->lastSync){
+			return 0; //the sync frame again, its ACK was lost
+		}
+		window->synced=1;
+		window->seen=1;
+		window->last=seq;
+		window->lastSync=(header & L4R_SYNC)!=0;
+		return 1;
+	}
+	if(ahead==0){
+		return 0;
+	}
+	if(ahead<L4R_DUP_WINDOW){
+		window->seen=(window->seen<<ahead) | 1;
+		window->last=seq;
+		window->lastSync=0;
+		return 1;
+	}
+	ahead=L4R_SEQ_MASK+1-ahead; //behind the newest frame
+	if(ahead>=L4R_DUP_WINDOW || (window->seen & (1UL<<ahead))){
+		return 0;
+	}
+	window->seen|=1UL<<ahead;
+	
+	return 1;
+}
+
+/*! Load a reply as the ACK payload of the data pipe of the frame being executed.
+* \detail A full TX FIFO holds replies nobody has fetched (unless a TX stream of the same module is using it); they are flushed, so the new reply is not dropped. A reply which still cannot be loaded is counted in \c repliesDropped of the transport statistics.
+* \param reply	- the reply, \c L4R_REPLY_LEN bytes;
+*/
+static void loadReply(uint8_t* reply){
+	uint32_t primask;
+	
+	primask=__get_PRIMASK(); //no stream may start between the check and the flush
+	__disable_irq();
+	if(nRF24_sendACKpayload(rxRadio,rxPipe,reply,L4R_REPLY_LEN)==0xFF){
+		if(!nRF24_streamBusy(rxRadio)){
+			nRF24_flushTX(rxRadio); //stale replies
+		}
+		if(nRF24_sendACKpayload(rxRadio,rxPipe,reply,L4R_REPLY_LEN)==0xFF){
+			txStats.repliesDropped++;
+		}
+	}
+	__set_PRIMASK(primask);
+}
+
 /*! \name INTERFACE FUNCTIONS
 	* The set of language functions provided with the \b Language \b for \b robots library.
 	*  @{
@@ -41,65 +318,507 @@
 	* \sa lang4robots_receiveCommand(),lang4robots_executeCommand()
 	*/
 uint8_t lang4robots_sendCommand(uint8_t* addr, uint8_t comm){
-	uint8_t status=1;
-	
-	pin_CE(LOW);
-	delay_us(10);
-	nRF24_setTXaddr(addr);
-	if(ACKenabled){
-		nRF24_setRXaddr(0,addr); //required for ACK
-		nRF24_sendData(&comm,1);
-	}else{
-		nRF24_sendDataNOACK(&comm,1);
+	return lang4robots_sendCommandWithArgs(addr,comm,0,0);
+}
+
+/*! Send command with an argument block via the radio module.
+	* \detail The opcode, the arguments and the sequence number go in one frame (see \c commandFrame), so a command with a value costs a single radio transmission. Commands queued for the same address with lang4robots_queueCommand() are sent in the same frame.
+	* \param addr	- destination radio module address; \c addr is a pointer to the LSByte of the address;
+	* \param comm	- command number to send; you may use a \c CommandType enumerator instead of a direct value;
+	* \param args	- a pointer to the argument block (LSByte first for multi-byte values); may be \c 0 if \c argLen is \c 0;
+	* \param argLen	- argument block length (0-\c L4R_ARGS_MAX);
+	* \return status of the operation: \c '1' - frame queued for transmission, \c '0' - argument block too long or the transmit window busy (see lang4robots_queueCommand());
+	* \sa lang4robots_sendCommand(),lang4robots_receiveCommandWithArgs()
+	*/
+uint8_t lang4robots_sendCommandWithArgs(uint8_t* addr, uint8_t comm, uint8_t* args, uint8_t argLen){
+	uint8_t queued;
+	
+	SPI_TRACE_BEGIN(SPI_TRACE_API_SEND_COMMAND);
+	queued=lang4robots_queueCommand(addr,comm,args,argLen);
+	if(queued){
+		lang4robots_flush();
+	}
+	SPI_TRACE_END();
+	
+	return queued;
+}
+
+/*! Send command and wait for the return value of its handler.
+	* \detail The return value travels back in the ACK payload, so no role swap of the two modules is needed. The receiver executes the command in its main loop, after the command frame has already been acknowledged, so the reply rides on the ACK of a following empty frame (a reply fetch, with the sequence number of the command). Fetches are repeated up to \c L4R_REPLY_TRIES times until the reply with the matching sequence number arrives. The transmit window is serviced while waiting; the call gives up when room in the window or a delivery status takes longer than \c L4R_WAIT_TIMEOUT_US.
+	* \note Auto ACK must be enabled (\c ACKenabled) and ACK Payload must be enabled on both modules (\c FEATURE_INIT).
+	* \param addr	- destination radio module address; \c addr is a pointer to the LSByte of the address;
+	* \param comm	- command number to send; you may use a \c CommandType enumerator instead of a direct value;
+	* \param args	- a pointer to the argument block (LSByte first for multi-byte values); may be \c 0 if \c argLen is \c 0;
+	* \param argLen	- argument block length (0-\c L4R_ARGS_MAX);
+	* \param result	- a pointer to the variable for the return value;
+	* \return status of the operation: \c '1' - return value received, \c '0' - no reply;
+	* \sa lang4robots_sendCommandWithArgs(),lang4robots_executeCommand()
+	*/
+uint8_t lang4robots_sendCommandAndWait(uint8_t* addr, uint8_t comm, uint8_t* args, uint8_t argLen, uint32_t* result){
+	uint8_t frame[L4R_FRAME_MAX];
+	uint8_t i,peer,seq,tries,answered=0;
+	uint32_t retryAt,deadline;
+	
+	if(!ACKenabled || argLen>L4R_ARGS_MAX){
+		return 0;
+	}
+	SPI_TRACE_BEGIN(SPI_TRACE_API_SEND_AND_WAIT);
+	deadline=delay_deadline(L4R_WAIT_TIMEOUT_US);
+	while(lang4robots_flush()==0xFF || (peer=peerFind(addr))==0xFF || !windowFree()){ //the command gets a frame of its own
+		if(delay_expired(deadline)){
+			SPI_TRACE_END();
+			return 0;
+		}
+		lang4robots_txService();
+		delay_yield();
+	}
+	seq=peers[peer].seq++ & L4R_SEQ_MASK;
+	txLastSeq=seq;
+	frame[0]=seq | L4R_REPLY_REQ;
+	frame[1]=comm;
+	frame[2]=argLen;
+	for(i=0; i<argLen; i++){
+		frame[L4R_FRAME_HDR_LEN+L4R_RECORD_HDR_LEN+i]=args[i];
+	}
+	replyReady=0;
+	if(waitFrame(sendFrame(peer,frame,L4R_FRAME_HDR_LEN+L4R_RECORD_HDR_LEN+argLen,0),delay_deadline(L4R_WAIT_TIMEOUT_US))==L4R_DELIVERED){
+		for(tries=0; tries<=L4R_REPLY_TRIES; tries++){
+			if(replyReady && replySeq==seq){
+				*result=replyValue;
+				answered=1;
+				break;
+			}
+			if(tries==L4R_REPLY_TRIES){
+				break;
+			}
+			retryAt=delay_deadline(L4R_REPLY_RETRY_US); //time for the receiver to execute the command
+			deadline=delay_deadline(L4R_WAIT_TIMEOUT_US);
+			while(!delay_expired(retryAt) || (!windowFree() && !delay_expired(deadline))){
+				lang4robots_txService(); //frames of the window keep going meanwhile
+				delay_yield();
+			}
+			frame[0]=seq; //a fetch takes no sequence number of its own
+			if(!windowFree() || waitFrame(sendFrame(peer,frame,L4R_FRAME_HDR_LEN,1),deadline)==0xFF){
+				break;
+			}
+		}
+	}
+	SPI_TRACE_END();
+	
+	return answered;
+}
+
+/*! Queue command for a packed transmission.
+	* \detail Commands for the same destination are packed into one frame. The pending frame is sent when the next command does not fit or goes to another address, when it is full, when lang4robots_flush() is called or when \c L4R_BATCH_DEADLINE_US has passed since the first command was queued (see lang4robots_batchTick()).
+	* \param addr	- destination radio module address; \c addr is a pointer to the LSByte of the address;
+	* \param comm	- command number to send; you may use a \c CommandType enumerator instead of a direct value;
+	* \param args	- a pointer to the argument block (LSByte first for multi-byte values); may be \c 0 if \c argLen is \c 0;
+	* \param argLen	- argument block length (0-\c L4R_ARGS_MAX);
+	* \return status of the operation: \c '1' - command queued, \c '0' - argument block too long, or the transmit window is busy (full, or every destination entry has frames in flight) and nothing has been queued - call it again after lang4robots_txService();
+	* \sa lang4robots_flush(),lang4robots_batchTick()
+	*/
+uint8_t lang4robots_queueCommand(uint8_t* addr, uint8_t comm, uint8_t* args, uint8_t argLen){
+	uint8_t i;
+	
+	if(argLen>L4R_ARGS_MAX){
+		return 0;
+	}
+	if(txLen){
+		for(i=0; i<5 && peers[txPeer].addr[i]==addr[i]; i++){;}
+		if((i<5 || txLen+L4R_RECORD_HDR_LEN+argLen>L4R_FRAME_MAX) && lang4robots_flush()==0xFF){
+			return 0; //the pending frame cannot leave yet
+		}
+	}
+	if(txLen==0){
+		txPeer=peerFind(addr);
+		if(txPeer==0xFF){
+			return 0;
+		}
+		txBuf[0]=peers[txPeer].seq++ & L4R_SEQ_MASK;
+		txLastSeq=txBuf[0];
+		txLen=L4R_FRAME_HDR_LEN;
+		txDeadline=delay_deadline(L4R_BATCH_DEADLINE_US);
+	}
+	
+	txBuf[txLen++]=comm;
+	txBuf[txLen++]=argLen;
+	for(i=0; i<argLen; i++){
+		txBuf[txLen++]=args[i];
+	}
+	if(txLen>L4R_FRAME_MAX-L4R_RECORD_HDR_LEN){
+		lang4robots_flush(); //no room left even for a command without arguments; kept pending if the window is full
+	}
+	
+	return 1;
+}
+
+/*! Send the pending packed frame at once.
+	* \return \c '1' - frame sent, \c '0' - no frame pending, \c 0xFF - the transmit window is full, the frame stays pending (lang4robots_batchTick() sends it later);
+	* \sa lang4robots_queueCommand()
+	*/
+uint8_t lang4robots_flush(void){
+	if(txLen==0){
+		return 0;
+	}
+	if(!windowFree()){
+		return 0xFF; //error avoidance
 	}
-	nRF24_modeTX();
-	pin_CE(HIGH);
+	SPI_TRACE_BEGIN(SPI_TRACE_API_FLUSH);
+	sendFrame(txPeer,txBuf,txLen,0);
+	txLen=0;
+	SPI_TRACE_END();
 	
-	return status;
+	return 1;
+}
+
+/*! Check the packing deadline.
+	* \detail The pending frame is sent once it has waited \c L4R_BATCH_DEADLINE_US. lang4robots_poll() calls it, so it is enough to poll the interface from the main loop.
+	* \return \c '1' - frame sent, \c '0' - nothing sent;
+	* \sa lang4robots_queueCommand()
+	*/
+uint8_t lang4robots_batchTick(void){
+	if(txLen==0 || !delay_expired(txDeadline)){
+		return 0;
+	}
+	
+	return lang4robots_flush()==1;
 }
 
 /*! Receive command via the radio module.
-	* \param dataPipe	- data pipe number, from which the data should be received;
-	* \return number of command received;
+	* \param dataPipe	- data pipe number (0-5) the command must come from, or \c L4R_PIPE_ANY (see lang4robots_getPipe());
+	* \return number of command received or \c 0xFF if no command of the pipe is pending;
 	* \sa lang4robots_sendCommand(),lang4robots_executeCommand()
 	*/
 uint8_t lang4robots_receiveCommand(uint8_t dataPipe){
-	uint8_t comm;//,statusReg;
+	return lang4robots_receiveCommandWithArgs(dataPipe,0);
+}
+
+/*! Receive command with its argument block.
+	* \detail Commands are taken from the frames queued by lang4robots_receiveFrames(), one command record per call, so call it until it returns \c 0xFF to get all of them (or use lang4robots_poll()). The command is kept until the next one is received (see lang4robots_getFrame()); its argument block is padded with zeros up to the argument size of the command. The first (up to) 4 argument bytes are decoded little-endian into \c param; missing bytes are zero. The commands are queued in the order their frames arrived: a command of another pipe than \c dataPipe is left in the queue, and the commands behind it wait until it is taken with its own pipe number or \c L4R_PIPE_ANY.
+	* \warning Call it from the main loop only - it is the single consumer of the received frames queue.
+	* \param dataPipe	- data pipe number (0-5) the command must come from, or \c L4R_PIPE_ANY (see lang4robots_getPipe());
+	* \param param	- a pointer to the handler parameter to fill; may be \c 0;
+	* \return number of command received or \c 0xFF if no command of the pipe is pending or the frame is malformed;
+	* \sa lang4robots_sendCommandWithArgs(),lang4robots_executeCommand()
+	*/
+uint8_t lang4robots_receiveCommandWithArgs(uint8_t dataPipe, uint32_t* param){
+	nRF24_frame* frame;
+	const commandTable* table;
+	uint8_t i,size;
+	uint32_t value=0;
+	
+	if(rxPos>=rxLen){
+		if(rxTail==rxHead){
+			return 0xFF; //error avoidance
+		}
+		frame=&rxQueue[rxTail & (L4R_RX_QUEUE_LEN-1)];
+		if(dataPipe!=L4R_PIPE_ANY && frame->pipe!=dataPipe){
+			return 0xFF; //a frame of another pipe is next
+		}
+		for(i=0; i<frame->len; i++){
+			rxBuf[i]=frame->data[i];
+		}
+		rxLen=frame->len;
+		rxPipe=frame->pipe;
+		__DMB(); //the slot is copied before it is handed back to the IRQ handler
+		rxTail++;
+		if(rxLen<L4R_FRAME_HDR_LEN+L4R_RECORD_HDR_LEN){
+			rxLen=0;
+			return 0xFF; //error avoidance (or a reply fetch - no command)
+		}
+		if(!acceptFrame(rxPipe,rxBuf[0])){
+			rxLen=0;
+			txStats.duplicates++;
+			return 0xFF; //a duplicate - its commands have been executed already
+		}
+		rxPos=L4R_FRAME_HDR_LEN;
+		rxCommand.frame.seq=rxBuf[0] & L4R_SEQ_MASK;
+	}else if(dataPipe!=L4R_PIPE_ANY && rxPipe!=dataPipe){
+		return 0xFF; //the rest of a frame of another pipe is next
+	}
+	if(rxLen-rxPos<L4R_RECORD_HDR_LEN || rxBuf[rxPos+1]>rxLen-rxPos-L4R_RECORD_HDR_LEN){
+		rxPos=rxLen; //drop the malformed rest of the frame
+		return 0xFF;
+	}
+	
+	rxCommand.frame.opcode=rxBuf[rxPos++];
+	rxCommand.frame.argLen=rxBuf[rxPos++];
+	for(i=0; i<rxCommand.frame.argLen; i++){
+		rxCommand.frame.args[i]=rxBuf[rxPos++];
+	}
+	table=pipeTables[rxPipe];
+	size=rxCommand.frame.opcode<table->count ? table->argSize[rxCommand.frame.opcode] : 0;
+	for(; i<size; i++){
+		rxCommand.frame.args[i]=0; //a short block reads as zeros in the argument structure
+	}
+	for(i=rxCommand.frame.argLen<4 ? rxCommand.frame.argLen : 4; i>0; i--){
+		value=(value<<8) | rxCommand.frame.args[i-1];
+	}
+	if(param){
+		*param=value;
+	}
+	
+	return rxCommand.frame.opcode;
+}
+
+/*! Move received frames from the radio RX FIFO to the received frames queue.
+	* \detail This is the only receive work to be done in the module IRQ handler (on \c RX_DR): no command is executed here. The whole RX FIFO is drained in one call and every frame is tagged with its own data pipe. ACK payloads received while transmitting (on a module that is not in RX mode) are taken as replies for lang4robots_sendCommandAndWait(). Frames stay in the radio RX FIFO while the queue is full and are moved on the next \c RX_DR interrupt.
+	* \param radio	- the module that raised \c RX_DR;
+	* \return number of frames queued;
+	* \sa lang4robots_poll()
+	*/
+uint8_t lang4robots_receiveFrames(nrf24_dev* radio){
+	nRF24_frame* frame;
+	uint8_t received=0;
+	
+	SPI_TRACE_BEGIN(SPI_TRACE_API_RECEIVE_FRAMES);
+	while((uint8_t)(rxHead-rxTail)<L4R_RX_QUEUE_LEN){
+		frame=&rxQueue[rxHead & (L4R_RX_QUEUE_LEN-1)];
+		if(nRF24_receiveFrame(radio,frame)==0xFF){
+			break; //RX FIFO empty
+		}
+		if(!(nRF24_getRegister(radio,CONFIG) & PRIM_RX)){
+			if(frame->len>=L4R_REPLY_LEN){ //ACK payload - a reply
+				replySeq=frame->data[0] & L4R_SEQ_MASK;
+				replyValue=frame->data[2] | (frame->data[3]<<8) | (frame->data[4]<<16) | ((uint32_t)frame->data[5]<<24);
+				replyReady=1;
+			}
+			continue;
+		}
+		__DMB(); //the slot is filled before it is handed over to the main loop
+		rxHead++;
+		received++;
+	}
+	SPI_TRACE_END();
 	
-	//statusReg=nRF24_getStatus();
-	//if((statusReg & RX_P_NO(7))==RX_P_NO(dataPipe)){
-		nRF24_receiveData(&comm, 1);
-	//}else{
-		//return 0xFF; //error avoidance
-	//}
+	return received;
+}
+
+/*! Execute every pending command.
+	* \detail Every command record of every queued frame is executed in the order it was sent; duplicate frames are dropped. Malformed records are skipped. Call it from the main loop; command handlers run here, outside of any interrupt. The packing deadline of queued commands is checked and the transmit window is serviced (see lang4robots_txService()) as well. If the frame requested a reply, the return value of its last command is loaded as the ACK payload of the frame's data pipe; replies nobody has fetched are flushed when they fill the TX FIFO.
+	* \return number of commands executed;
+	* \sa lang4robots_receiveFrames(),lang4robots_executeCommand()
+	*/
+uint8_t lang4robots_poll(void){
+	uint8_t comm,executed=0;
+	uint8_t reply[L4R_REPLY_LEN];
+	uint32_t result;
+	
+	SPI_TRACE_BEGIN(SPI_TRACE_API_POLL);
+	lang4robots_batchTick();
+	lang4robots_txService();
+	while(rxPos<rxLen || rxTail!=rxHead){
+		comm=lang4robots_receiveCommand(L4R_PIPE_ANY);
+		if(comm!=0xFF){
+			result=lang4robots_executeCommand(comm,rxCommand.frame.args);
+			executed++;
+			if(rxPos>=rxLen && (rxBuf[0] & L4R_REPLY_REQ)){
+				reply[0]=rxBuf[0];
+				reply[1]=comm;
+				reply[2]=result;
+				reply[3]=result>>8;
+				reply[4]=result>>16;
+				reply[5]=result>>24;
+				loadReply(reply); //goes out with the ACK of the next frame on this pipe
+			}
+		}
+	}
+	SPI_TRACE_END();
+	
+	return executed;
+}
+
+/*! Check if the interface has any work queued.
+	* \return \c '1' - received commands waiting for lang4robots_poll(), a packed frame waiting for its deadline or frames not delivered yet; \c '0' - idle;
+	* \sa lang4robots_poll()
+	*/
+_Bool lang4robots_busy(void){
+	return rxPos<rxLen || rxTail!=rxHead || txLen || txHead!=txTail || nRF24_streamBusy(txRadio);
+}
+
+/*! Hand the frames waiting in the transmit window to the radio TX stream.
+	* \detail Frames wait in the window while the stream is full, while frames for another address are still being sent and during the backoff of a software retransmission. Nothing blocks here: a frame whose backoff has not passed yet is left for a later call. lang4robots_poll() calls it, so it is enough to poll the interface from the main loop.
+	* \return number of frames sent and not yet delivered or failed;
+	* \sa lang4robots_txDone(),lang4robots_txFailed()
+	*/
+uint8_t lang4robots_txService(void){
+	if(txHold && delay_expired(txRetryAt)){
+		txHold=0;
+	}
+	feedFrames();
 	
-	return comm;
+	return (uint8_t)(txHead-txTail);
+}
+
+/*! Transmit window hook for \c TX_DS.
+	* \detail Call it from the module IRQ handler on \c TX_DS (after clearing the flag) instead of nRF24_streamService(): the oldest frame sent is delivered and the stream is topped up. When the stream has finished, every frame still counted in it is delivered, so merged \c TX_DS interrupts lose nothing.
+	* \param radio	- the module that raised \c TX_DS;
+	* \sa lang4robots_txFailed()
+	*/
+void lang4robots_txDone(nrf24_dev* radio){
+	if(radio==txRadio && txTail!=txFeed && !(nRF24_getRegister(radio,CONFIG) & PRIM_RX)){ //a PRX raises TX_DS for its ACK payloads
+		finishFrame(L4R_DELIVERED);
+	}
+	nRF24_streamService(radio); //load the next queued frames
+	if(radio==txRadio){
+		if(!nRF24_streamBusy(radio)){
+			while(txTail!=txFeed){
+				finishFrame(L4R_DELIVERED);
+			}
+		}
+		feedFrames();
+	}
+}
+
+/*! Transmit window hook for \c MAX_RT.
+	* \detail Call it from the module IRQ handler on \c MAX_RT, before clearing the flag. The stream is aborted: the failed frame is sent again after \c L4R_TX_BACKOFF_US (doubled with every try), or reported failed after \c L4R_TX_RETRIES retransmissions; the frames behind it, not sent yet, follow in their order. A failed reply fetch is dropped at once.
+	* \param radio	- the module that raised \c MAX_RT;
+	* \sa lang4robots_txDone(),lang4robots_txService()
+	*/
+void lang4robots_txFailed(nrf24_dev* radio){
+	l4r_txEntry* entry;
+	uint8_t i;
+	
+	if(radio!=txRadio || txTail==txFeed){
+		nRF24_flushTX(radio); //not a frame of the window - drop it, the stream goes on with the queued ones
+		nRF24_streamService(radio);
+		return;
+	}
+	nRF24_streamFlush(radio); //the frames behind the failed one have not been sent, they go again in order
+	entry=&txWindow[txTail & (L4R_TX_WINDOW-1)];
+	if(entry->fetch || entry->tries>L4R_TX_RETRIES){
+		finishFrame(L4R_FAILED);
+	}else{
+		txRetryAt=delay_deadline((uint32_t)L4R_TX_BACKOFF_US<<(entry->tries-1));
+		txHold=1;
+		entry->tries++;
+		txStats.retransmits++;
+	}
+	for(i=txTail; i!=txFeed; i++){
+		txWindow[i & (L4R_TX_WINDOW-1)].state=L4R_TX_WAITING;
+	}
+	txFeed=txTail;
+	feedFrames(); //nothing is fed during the backoff
+}
+
+/*! Set the delivery hook.
+	* \detail The hook is called with the delivery status of every frame but reply fetches, in the order the frames were sent, from the module IRQ handler.
+	* \param hook	- the hook, \c 0 - none;
+	* \sa l4r_delivery
+	*/
+void lang4robots_setDeliveryHook(l4r_deliveryHook hook){
+	deliveryHook=hook;
+}
+
+/*! Get the sequence number of the frame the last command was queued in.
+	* \return sequence number (\c L4R_SEQ_MASK bits), the one reported to the delivery hook;
+	*/
+uint8_t lang4robots_lastSeq(void){
+	return txLastSeq;
+}
+
+/*! Get the transport statistics.
+	* \param stats	- the statistics;
+	*/
+void lang4robots_getTransportStats(l4r_transportStats* stats){
+	uint32_t primask;
+	
+	primask=__get_PRIMASK();
+	__disable_irq();
+	*stats=txStats;
+	__set_PRIMASK(primask);
+}
+
+/*! Get the last received command.
+	* \return a pointer to the frame filled by lang4robots_receiveCommandWithArgs();
+	*/
+const commandFrame* lang4robots_getFrame(void){
+	return &rxCommand.frame;
+}
+
+/*! Get the data pipe of the last received command.
+	* \return data pipe number (0-5);
+	*/
+uint8_t lang4robots_getPipe(void){
+	return rxPipe;
 }
 
 /*! Execute the command received via the radio module.
-	* \param comm	- command number to execute; the function of that number in \c 'handlersArray' will be executed;
-	* \param param	- the argument parameter given to the executed function;
-	* \return the return value of the executed function;
+	* \detail A bounds checked direct jump through the command table bound to the data pipe of the last received command (see lang4robots_bindTable()); \c 'handlersArray' unless another table is bound.
+	* \param comm	- command number to execute; the handler of that number in the table will be executed;
+	* \param args	- a pointer to the argument structure of the command (word aligned, \c argSize[comm] bytes of the table); lang4robots_getFrame()->args for the received command;
+	* \return the return value of the executed function or \c 0xFF if \c comm is not a command of the table;
 	* \sa lang4robots_sendCommand(),lang4robots_receiveCommand(), handlersArray
 	*/
-uint32_t lang4robots_executeCommand(uint8_t comm, uint32_t param){
-	if(comm>COMMANDS_NR){
+uint32_t lang4robots_executeCommand(uint8_t comm, const void* args){
+	const commandTable* table=pipeTables[rxPipe];
+	
+	if(comm>=table->count){
 		return 0xFF; //error avoidance
 	}
 		
-	return handlersArray[comm](param);
+	return table->handlers[comm](args);
+}
+
+/*! Bind a command table to a data pipe.
+	* \detail Commands received on the pipe are executed from the table from then on. All pipes are bound to \c lang4robots_commands (\c L4R_COMMANDS) by default.
+	* \param pipe	- data pipe number (0-5);
+	* \param table	- the command table (see \c L4R_TABLE_DEFINE), \c 0 - \c lang4robots_commands;
+	* \return status of the operation: \c '1' - bound, \c '0' - wrong pipe number;
+	* \sa lang4robots_getTable()
+	*/
+uint8_t lang4robots_bindTable(uint8_t pipe, const commandTable* table){
+	if(pipe>5){
+		return 0;
+	}
+	
+	pipeTables[pipe]=table ? table : &lang4robots_commands;
+	return 1;
+}
+
+/*! Get the command table bound to a data pipe.
+	* \param pipe	- data pipe number (0-5);
+	* \return a pointer to the table or \c 0 - wrong pipe number;
+	* \sa lang4robots_bindTable()
+	*/
+const commandTable* lang4robots_getTable(uint8_t pipe){
+	if(pipe>5){
+		return 0;
+	}
+	
+	return pipeTables[pipe];
+}
+
+/*! Initialize one radio module for lang4robots frames.
+* \detail Frames are shorter or longer than one byte and replies ride on ACK payloads, so Dynamic Payload Length (all pipes) and ACK Payload are required; they are the nRF24_init() defaults and are enabled here again in case the defaults have been changed.
+* \param radio	- the module;
+*/
+static void initRadio(nrf24_dev* radio){
+	pin_Init(&radio->pins);
+	nRF24_init(radio);
+	nRF24_batchBegin(radio);
+	nRF24_enDisDynPayLen(radio,DPL_P0 | DPL_P1 | DPL_P2 | DPL_P3 | DPL_P4 | DPL_P5,1);
+	nRF24_enDisACKpayload(radio,1);
+	nRF24_batchCommit(radio);
 }
 
 /*! Initialize all modules needed.
-	* \detail This function initializes the pins, nRF24 and SPI modules.
+	* \detail This function initializes the clock, the SPI module and the radio modules with their pins (see initRadio()). Commands are received on \c rx and sent from \c tx; one module may do both.
 	* \note Make sure to check if all 'init' functions are configured properly.
+	* \param rx	- the module commands are received on;
+	* \param tx	- the module commands are sent from, \c 0 - \c rx;
 	* \return \c '0';
-	* \sa	nRF24_init(), pin_Init(), spi1init()
+	* \sa	delay_init(), nRF24_init(), pin_Init(), spiBus_init()
 	*/
-uint8_t lang4robots_init(void){
-	pin_Init();
-	spi1init();
-	nRF24_init();
+uint8_t lang4robots_init(nrf24_dev* rx, nrf24_dev* tx){
+	rxRadio=rx;
+	txRadio=tx ? tx : rx;
+	delay_init();
+	spiBus_init();
+	initRadio(rxRadio);
+	if(txRadio!=rxRadio){
+		initRadio(txRadio);
+	}
 	
 	return 0;
 }
@@ -113,30 +832,30 @@ uint8_t lang4robots_init(void){
 	* COMMAND HANDLERS
 	******************/
 	/*! Function 0 handler.
-	* \param comm;	
-	* \return comm;
+	* \param args	- the command value;
+	* \return the command value;
 	*/
-uint32_t fun0(uint32_t comm){
+uint32_t fun0(const l4r_valueArgs* args){
 	slcdErr(0);
-	return comm;
+	return args->value;
 }
 
 /*! Function 1 handler.
-	* \param comm;	
-	* \return comm;
+	* \param args	- the command value;
+	* \return the command value;
 	*/
-uint32_t fun1(uint32_t comm){
+uint32_t fun1(const l4r_valueArgs* args){
 	slcdErr(1);
-	return comm;
+	return args->value;
 }
 
 /*! Function 2 handler.
-	* \param comm;	
-	* \return comm;
+	* \param args	- the command value;
+	* \return the command value;
 	*/
-uint32_t fun2(uint32_t comm){
+uint32_t fun2(const l4r_valueArgs* args){
 	slcdErr(2);
-	return comm;
+	return args->value;
 }
 //!@}
 	
@@ -153,18 +872,29 @@ uint32_t fun2(uint32_t comm){
 	*/
 enum CommandType command;
 
-	/*! The array of function handlers.
-	* \detail Fill the written functions names in the specified order. All functions used in \c 'handlersArray' must have their corresponding enumerator in \c 'CommandType' enumeration type.
-	* \warning IT IS VITAL TO FILL THE ARRAY IN THE SAME ORDER AS GOES IN \c 'enum \c CommandType'! Otherwise, the command names does not match their functions and executing a specific command may call a different function.
-	* 
-	* The \c 'handlersArray' size must not exceed the number defined by the \b 'COMMANDS_NR' constant.
-	* \sa CommandType,commandHandlersArray
-	*/
-commandHandlersArray handlersArray={
-	fun0,
-	fun1,
-	fun2
+L4R_COMMANDS(L4R_COMMAND_CALL)
+L4R_COMMANDS(L4R_COMMAND_FITS) //compile time: every argument structure fits in a frame
+
+	/*! The dispatch table, generated from \c L4R_COMMANDS in \c 'enum \c CommandType' order.
+	* \sa CommandType,commandHandler
+	*/
+const commandHandler handlersArray[]={
+	L4R_COMMANDS(L4R_COMMAND_ENTRY)
+};
+
+	/*! Argument structure size of every command, generated from \c L4R_COMMANDS.
+	* \sa L4R_ARGS
+	*/
+const uint8_t lang4robots_argSize[]={
+	L4R_COMMANDS(L4R_COMMAND_SIZE)
 };
+
+typedef char lang4robots_commandsFit[(COMMANDS_NR<0xFF && sizeof(handlersArray)/sizeof(handlersArray[0])==COMMANDS_NR && sizeof(lang4robots_argSize)==COMMANDS_NR) ? 1 : -1]; //compile time: the tables match the enumeration, 0xFF stays the "no command" value
+
+	/*! The command table of \c L4R_COMMANDS - \c 'handlersArray' and \c lang4robots_argSize.
+	* \sa lang4robots_bindTable()
+	*/
+const commandTable lang4robots_commands={handlersArray,lang4robots_argSize,COMMANDS_NR};
 	
 	/*! The ACK enabled/disabled flag.
 	* \detail \c '1' - send command with Auto ACK feature enabled, \c '0' - send command with Auto ACK feature disabled;
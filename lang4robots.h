@@ -8,16 +8,13 @@
 *	\b HOW \b TO \b DESIGN \b YOUR \b OWN \b LANGUAGE?
 *
 *	\e #lang4robots.h:
-*	- add language instructions you wish to implement (up to 256) simply by writing their declarations in *COMMAND HANDLERS* section. You may rename they as you wish.
-*	\warning All your instructions have to be the same type as defined \c commandHandler (C language restrictions) - by default it's \c 'uint32_t \c fun(uint32_t)', but you may adjust them according to your needs.
-*	\par Remember to obey this rule, otherwise it may cause malfuction.
-*	- modify \c 'enum \c CommandType' so that its enumerated members names fit your instructions name (in the same order!). It is recommended to start with first member's value = \c '0' and to name the members in the same order as your instructions name in *COMMAND HANDLERS* section without changing their values.
-*	- modify the defined value \c COMMANDS_NR with the number of your language instructions
-*	- optional: if you like, add more \c CommandType variables or declare more handlersArrays
+*	- add language instructions you wish to implement (up to 255) simply by adding their \c L4R_COMMAND(name, handler, argType) entries to \c L4R_COMMANDS in *COMMAND REGISTRY* section. The command number, the \c 'enum \c CommandType' member, the handler declaration, the dispatch table entry and the argument size are all generated from that entry.
+*	- optional: declare the argument structure of your instructions in the same section; every handler gets a pointer to its own argument type.
+*	- optional: if you like, add more \c CommandType variables
+*	- optional: give a data pipe a language of its own - declare another command table with \c L4R_TABLE_DECLARE, define it with \c L4R_TABLE_DEFINE and bind it with lang4robots_bindTable()
 *
 *	\e #lang4robots.c:
-*	- write your instructions functionality in the same order as declared in \c 'lang4robots.h'
-*	-	initialize your \c handlerArray(s) with written functions pointers. IT IS VITAL TO FILL THE ARRAY IN THE SAME ORDER AS GOES IN \c 'enum \c CommandType'! Otherwise, the command names does not match their functions and executing a specific command may call a different function.
+*	- write your instructions functionality in *COMMAND HANDLERS* section; the compiler checks every definition against the declaration generated from the registry.
 *
 *	For more information check the project documentation.
 *
@@ -27,48 +24,203 @@
 #ifndef LANG4ROBOTS_H
 	#define LANG4ROBOTS_H
 	
-	#include "MKL46Z4.h"
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
 	#include "nRF24L01P.h"
 	#include "pinManagement.h"
 	#include "SPI.h"
 	#include "delay.h"
 	#include "nRF24.h"
+	#include "channelManager.h"
 	
 	/*! \name LANGUAGE DEFINES
 	*  Some defines used by the interface.
 	*  @{
 	*/
-	
-	/*! Number of commands used by end user.
-	* \warning Do not forget to modify this constant with the appropriate value.
-	*/
-	#define COMMANDS_NR				3
+	#define L4R_FRAME_MAX			32	//!< Maximum frame length - one radio payload
+	#define L4R_FRAME_HDR_LEN	1		//!< Frame header length: sequence number
+	#define L4R_RECORD_HDR_LEN	2	//!< Command record header length: opcode and argument block length
+	#define L4R_ARGS_MAX			(L4R_FRAME_MAX-L4R_FRAME_HDR_LEN-L4R_RECORD_HDR_LEN) //!< Maximum argument block length
+	#define L4R_BATCH_DEADLINE_US	2000	//!< Longest time a queued command waits for more commands to be packed with
+	#define L4R_RX_QUEUE_LEN	8		//!< Received frames queue length (power of 2, up to 128)
+	#define L4R_PIPE_ANY			0xFF	//!< lang4robots_receiveCommand() data pipe number: a command of any pipe
+	#define L4R_SEQ_MASK			0x3F	//!< Sequence number bits of the frame header
+	#define L4R_SYNC					0x40	//!< Frame header flag: no frame of the sender has been delivered yet (or the last one has failed) - the receiver restarts its duplicate window at this sequence number
+	#define L4R_REPLY_REQ			0x80	//!< Frame header flag: the sender waits for the return value (see lang4robots_sendCommandAndWait())
+	#define L4R_REPLY_LEN			6		//!< Reply length: sequence number, opcode and 4 bytes of the return value
+	#define L4R_REPLY_TRIES		20	//!< Reply fetch attempts of lang4robots_sendCommandAndWait()
+	#define L4R_REPLY_RETRY_US	500	//!< Pause between two reply fetch attempts
+	#define L4R_PEERS_MAX			4		//!< Destinations the sender keeps a sequence number for; the least recently added one without frames in flight is replaced
+	#define L4R_DUP_WINDOW		32	//!< Sequence numbers remembered by the duplicate filter of every data pipe (up to 32, at most half of the \c L4R_SEQ_MASK space); every sender needs a data pipe of its own (see \c commandFrame)
+	#define L4R_TX_WINDOW			16	//!< Frames sent and waiting for their delivery status (power of 2, up to 128)
+	#define L4R_TX_RETRIES		4		//!< Software retransmissions of a frame after \c MAX_RT before it is reported failed
+	#define L4R_TX_BACKOFF_US	500	//!< Pause before the first software retransmission; doubled for every next one
+	#define L4R_WAIT_TIMEOUT_US	500000	//!< Longest wait of lang4robots_sendCommandAndWait() for room in the transmit window or for a delivery status
 	
 	/******************
 	* LANGUAGE DEFINES
 	******************/
-	/*! Command type enumeration.
-	* \detail Fill the enumerators names according to functions names in \c 'handlersArray'. All functions used in \c 'handlersArray' must have their corresponding enumerator in \c 'CommandType' enumeration type.
-	* \warning IT IS VITAL TO FILL THE ENUMERATORS IN THE SAME ORDER AS COMMAND HANDLERS IN \c 'handlersArray'! Otherwise, the command names does not match their functions and executing a specific command may call a different function.
-	* \sa handlersArray
+	//!@}
+	
+	/*! \name COMMAND REGISTRY
+	*  The set of application specified commands written by end user.
+	*  @{
+	*/
+	/******************
+	* COMMAND REGISTRY
+	******************/
+	/*! Argument structure of the commands taking a single value. */
+	typedef struct{
+		uint32_t value;		//!< the first 4 bytes of the argument block
+	}l4r_valueArgs;
+	
+	/*! Command registry.
+	* \detail One \c L4R_COMMAND(name, handler, argType) entry per command, in command number order (the first entry is command \c 0):
+	*	- \c name - the \c 'enum \c CommandType' member;
+	*	- \c handler - the handler, declared as \c 'uint32_t \c handler(const \c argType* \c args)';
+	*	- \c argType - the argument structure of the command (at most \c L4R_ARGS_MAX bytes, at most 4-byte alignment). The structure is read in place from the received argument block, so it has to be laid out the same on both sides (LSByte first, the same padding); argument blocks shorter than the structure are padded with zeros.
+	*
+	* \note Entries are separated by nothing and every line but the last one ends with a backslash.
+	* \sa CommandType, handlersArray, lang4robots_argSize
+	*/
+	#define L4R_COMMANDS(L4R_COMMAND) \
+		L4R_COMMAND(com0,	fun0,	l4r_valueArgs) \
+		L4R_COMMAND(com1,	fun1,	l4r_valueArgs) \
+		L4R_COMMAND(com2,	fun2,	l4r_valueArgs) \
+		L4R_COMMAND(comChannel,	channel_command,	channel_args)
+	//!@}
+	
+	/*! \name COMMAND TYPES
+	*  The command types generated from the registry.
+	*  @{
+	*/
+	/***************
+	* COMMAND TYPES
+	***************/
+	#define L4R_COMMAND_ENUM(name,handler,argType)	name,
+	#define L4R_COMMAND_ARGS(name,handler,argType)	typedef argType name##_args;
+	#define L4R_COMMAND_DECL(name,handler,argType)	uint32_t handler(const argType* args);
+	#define L4R_COMMAND_CALL(name,handler,argType)	static uint32_t lang4robots_call_##name(const void* args){return handler((const argType*)args);}
+	#define L4R_COMMAND_ENTRY(name,handler,argType)	lang4robots_call_##name,
+	#define L4R_COMMAND_SIZE(name,handler,argType)	sizeof(argType),
+	#define L4R_COMMAND_FITS(name,handler,argType)	typedef char name##_argsFit[sizeof(argType)<=L4R_ARGS_MAX ? 1 : -1];
+	
+	/*! Command type enumeration, generated from \c L4R_COMMANDS.
+	* \detail \c COMMANDS_NR - the number of commands - is the last member.
+	* \sa L4R_COMMANDS
 	*/
 	enum CommandType{
-		com0,	//!< command 0
-		com1,	//!< command 1
-		com2	//!< command 2
+		L4R_COMMANDS(L4R_COMMAND_ENUM)
+		COMMANDS_NR
+	};
+	
+	/*! Argument types of the commands: \c '<name>_args' for every \c L4R_COMMANDS entry. */
+	L4R_COMMANDS(L4R_COMMAND_ARGS)
+	
+	/*! Command handler type definition - the dispatch table entry.
+	* \detail Every entry converts the argument block pointer to the argument type of its command and calls the handler directly.
+	* \sa handlersArray
+	*/
+	typedef uint32_t (*commandHandler)(const void* args);
+	
+	/*! Command table - a command namespace a data pipe may be bound to.
+	* \sa lang4robots_bindTable(), L4R_TABLE_DECLARE, L4R_TABLE_DEFINE
+	*/
+	typedef struct{
+		const commandHandler* handlers;		//!< dispatch table, indexed by the command number
+		const uint8_t* argSize;						//!< argument structure size of every command
+		uint8_t count;										//!< number of commands
+	}commandTable;
+	
+	/*! Declare a command table (in a header).
+	* \detail A command table is an independent command namespace: its commands are numbered from \c 0, as in \c L4R_COMMANDS. The list has the same \c L4R_COMMAND(name, handler, argType) entries; \c 'enum \c <table>Command' with \c <table>_NR as the last member, the \c '<name>_args' types and the handler declarations are generated. Command and handler names must be unique among all tables.
+	* \par Example - a motor control language on pipe 1 and a diagnostics language on pipe 2:
+	* <tt>\#define MOTOR_COMMANDS(L4R_COMMAND) L4R_COMMAND(motorSpeed, motor_speed, motorSpeedArgs) ...</tt>
+	* <tt>L4R_TABLE_DECLARE(motorTable,MOTOR_COMMANDS)</tt> in a header, <tt>L4R_TABLE_DEFINE(motorTable,MOTOR_COMMANDS)</tt> in a source file and <tt>lang4robots_bindTable(1,&motorTable);</tt> after lang4robots_init().
+	* \param table	- table variable name;
+	* \param LIST	- the registry macro of the table;
+	* \sa L4R_TABLE_DEFINE
+	*/
+	#define L4R_TABLE_DECLARE(table,LIST) \
+		enum table##Command{LIST(L4R_COMMAND_ENUM) table##_NR}; \
+		LIST(L4R_COMMAND_ARGS) \
+		LIST(L4R_COMMAND_DECL) \
+		extern const commandTable table;
+	
+	/*! Define a command table declared with \c L4R_TABLE_DECLARE (in one source file).
+	* \param table	- table variable name;
+	* \param LIST	- the registry macro of the table;
+	* \sa L4R_TABLE_DECLARE
+	*/
+	#define L4R_TABLE_DEFINE(table,LIST) \
+		LIST(L4R_COMMAND_CALL) \
+		LIST(L4R_COMMAND_FITS) \
+		static const commandHandler table##_handlers[]={LIST(L4R_COMMAND_ENTRY)}; \
+		static const uint8_t table##_argSize[]={LIST(L4R_COMMAND_SIZE)}; \
+		typedef char table##_fits[(table##_NR<0xFF && sizeof(table##_handlers)/sizeof(table##_handlers[0])==table##_NR) ? 1 : -1]; \
+		const commandTable table={table##_handlers,table##_argSize,table##_NR};
+	
+	/*! Argument block of a command to send, checked against the argument type of the command.
+	* \detail Expands to the \c args and \c argLen parameters of the send functions, e.g. <tt>lang4robots_sendCommandWithArgs(addr,com1,L4R_ARGS(com1,&value))</tt>; a pointer to another type is diagnosed by the compiler.
+	* \param name	- \c CommandType member;
+	* \param args	- a pointer to the \c '<name>_args' structure;
+	*/
+	#define L4R_ARGS(name,args)	(uint8_t*)(1 ? (args) : (const name##_args*)0),sizeof(name##_args)
+	
+	/*! Command frame - the radio payload of a single command.
+	* \detail On air a frame is the sequence number followed by one or more command records \c [opcode][argLen][args...] for the same destination (see lang4robots_queueCommand()); a frame with a single command has exactly this layout. The frame is sent with Dynamic Payload Length, so only the used bytes go on air. Multi-byte arguments are stored little-endian (LSByte first), the same order as used for radio addresses.
+	* \par The argument block is passed to the command handler in place, as a pointer to the argument type of the command (see \c L4R_COMMANDS); a handler needing more than its argument type may read the whole block with lang4robots_getFrame().
+	* \par The header byte holds a 6-bit sequence number, counted by the sender for every destination, and the \c L4R_SYNC and \c L4R_REPLY_REQ flags. The receiver drops a frame whose sequence number it has already seen on the same data pipe (a duplicate made by a lost ACK). The module does not tell the sender of a frame, so the filter is kept per data pipe: every sender must reach the receiver on a data pipe of its own (its own RX address), otherwise the frames of one sender are dropped as duplicates of another's. A frame with \c L4R_REPLY_REQ set is answered with an ACK payload \c [seq][opcode][return value, 4 bytes LSByte first] carrying the return value of its last command. A frame made of the header only (a reply fetch) carries no command and is not checked for duplicates.
+	*/
+	typedef struct{
+		uint8_t args[L4R_ARGS_MAX];		//!< argument block; first, so it is word aligned in a word aligned frame
+		uint8_t seq;									//!< sequence number (\c L4R_SEQ_MASK bits), incremented by the sender with every frame to the same destination
+		uint8_t opcode;								//!< command number (\c CommandType)
+		uint8_t argLen;								//!< amount of valid bytes in \c args (0-\c L4R_ARGS_MAX)
+	}commandFrame;
+	
+	//!@}
+	
+	/*! \name TRANSPORT TYPES
+	*  Delivery status of the frames sent.
+	*  @{
+	*/
+	/*****************
+	* TRANSPORT TYPES
+	*****************/
+	/*! Delivery status of a frame. */
+	enum l4r_Delivery{
+		L4R_DELIVERED,		//!< acknowledged by the receiver (or sent, with Auto ACK disabled)
+		L4R_FAILED				//!< not acknowledged after \c L4R_TX_RETRIES software retransmissions
 	};
 	
-	/*! Command handler type definition.
-	* \note You may adjust the functions type according to your needs, but remember that all functions handlers stored in \c 'handlersArray' must have the same type.
-	* \sa commandHandlersArray, handlersArray
+	/*! Delivery report of a frame.
+	* \sa lang4robots_setDeliveryHook()
 	*/
-	typedef uint32_t (*commandHandler)(uint32_t); 
+	typedef struct{
+		const uint8_t* addr;	//!< destination address, valid during the hook call only
+		uint8_t seq;					//!< sequence number of the frame (see lang4robots_lastSeq())
+		uint8_t opcode;				//!< first command of the frame
+		uint8_t tries;				//!< transmissions of the frame (\c 1 - no software retransmission)
+		uint8_t status;				//!< \c l4r_Delivery
+	}l4r_delivery;
 	
-	/*! Command handlers array type definition.
-	* \detail The \c 'commandHandlersArray' members will have the same type as defined by the \c 'commandHandler'.
-	* \sa commandHandler, handlersArray
+	/*! Delivery hook type - called from the module IRQ handler once the delivery status of a frame is known.
+	* \sa lang4robots_setDeliveryHook()
 	*/
-	typedef commandHandler commandHandlersArray[];
+	typedef void (*l4r_deliveryHook)(const l4r_delivery* delivery);
+	
+	/*! Transport statistics since lang4robots_init(). */
+	typedef struct{
+		uint32_t delivered;		//!< frames delivered
+		uint32_t failed;			//!< frames given up
+		uint32_t retransmits;	//!< software retransmissions (after \c MAX_RT)
+		uint32_t duplicates;	//!< received frames dropped as duplicates
+		uint32_t repliesDropped;	//!< replies not loaded as ACK payloads - the TX FIFO was taken by a TX stream of the same module
+	}l4r_transportStats;
 	//!@}
 	
 	/*! \name INTERFACE FUNCTIONS
@@ -86,54 +238,184 @@
 	*/
 	uint8_t lang4robots_sendCommand(uint8_t* addr, uint8_t comm);
 	
+	/*! Send command with an argument block via the radio module.
+	* \detail The opcode, the arguments and the sequence number go in one frame (see \c commandFrame), so a command with a value costs a single radio transmission. Commands queued for the same address with lang4robots_queueCommand() are sent in the same frame.
+	* \param addr	- destination radio module address; \c addr is a pointer to the LSByte of the address;
+	* \param comm	- command number to send; you may use a \c CommandType enumerator instead of a direct value;
+	* \param args	- a pointer to the argument block (LSByte first for multi-byte values); may be \c 0 if \c argLen is \c 0;
+	* \param argLen	- argument block length (0-\c L4R_ARGS_MAX);
+	* \return status of the operation: \c '1' - frame queued for transmission, \c '0' - argument block too long or the transmit window busy (see lang4robots_queueCommand());
+	* \sa lang4robots_sendCommand(),lang4robots_receiveCommandWithArgs()
+	*/
+	uint8_t lang4robots_sendCommandWithArgs(uint8_t* addr, uint8_t comm, uint8_t* args, uint8_t argLen);
+	
+	/*! Send command and wait for the return value of its handler.
+	* \detail The return value travels back in the ACK payload, so no role swap of the two modules is needed. The receiver executes the command in its main loop, after the command frame has already been acknowledged, so the reply rides on the ACK of a following empty frame (a reply fetch, with the sequence number of the command). Fetches are repeated up to \c L4R_REPLY_TRIES times until the reply with the matching sequence number arrives. The transmit window is serviced while waiting; the call gives up when room in the window or a delivery status takes longer than \c L4R_WAIT_TIMEOUT_US.
+	* \note Auto ACK must be enabled (\c ACKenabled) and ACK Payload must be enabled on both modules (\c FEATURE_INIT).
+	* \param addr	- destination radio module address; \c addr is a pointer to the LSByte of the address;
+	* \param comm	- command number to send; you may use a \c CommandType enumerator instead of a direct value;
+	* \param args	- a pointer to the argument block (LSByte first for multi-byte values); may be \c 0 if \c argLen is \c 0;
+	* \param argLen	- argument block length (0-\c L4R_ARGS_MAX);
+	* \param result	- a pointer to the variable for the return value;
+	* \return status of the operation: \c '1' - return value received, \c '0' - no reply;
+	* \sa lang4robots_sendCommandWithArgs(),lang4robots_executeCommand()
+	*/
+	uint8_t lang4robots_sendCommandAndWait(uint8_t* addr, uint8_t comm, uint8_t* args, uint8_t argLen, uint32_t* result);
+	
+	/*! Queue command for a packed transmission.
+	* \detail Commands for the same destination are packed into one frame. The pending frame is sent when the next command does not fit or goes to another address, when it is full, when lang4robots_flush() is called or when \c L4R_BATCH_DEADLINE_US has passed since the first command was queued (see lang4robots_batchTick()).
+	* \param addr	- destination radio module address; \c addr is a pointer to the LSByte of the address;
+	* \param comm	- command number to send; you may use a \c CommandType enumerator instead of a direct value;
+	* \param args	- a pointer to the argument block (LSByte first for multi-byte values); may be \c 0 if \c argLen is \c 0;
+	* \param argLen	- argument block length (0-\c L4R_ARGS_MAX);
+	* \return status of the operation: \c '1' - command queued, \c '0' - argument block too long, or the transmit window is busy (full, or every destination entry has frames in flight) and nothing has been queued - call it again after lang4robots_txService();
+	* \sa lang4robots_flush(),lang4robots_batchTick()
+	*/
+	uint8_t lang4robots_queueCommand(uint8_t* addr, uint8_t comm, uint8_t* args, uint8_t argLen);
+	
+	/*! Send the pending packed frame at once.
+	* \return \c '1' - frame sent, \c '0' - no frame pending, \c 0xFF - the transmit window is full, the frame stays pending (lang4robots_batchTick() sends it later);
+	* \sa lang4robots_queueCommand()
+	*/
+	uint8_t lang4robots_flush(void);
+	
+	/*! Check the packing deadline.
+	* \detail The pending frame is sent once it has waited \c L4R_BATCH_DEADLINE_US. lang4robots_poll() calls it, so it is enough to poll the interface from the main loop.
+	* \return \c '1' - frame sent, \c '0' - nothing sent;
+	* \sa lang4robots_queueCommand()
+	*/
+	uint8_t lang4robots_batchTick(void);
+	
 	/*! Receive command via the radio module.
-	* \param dataPipe	- data pipe number, from which the data should be received;
-	* \return number of command received;
+	* \param dataPipe	- data pipe number (0-5) the command must come from, or \c L4R_PIPE_ANY (see lang4robots_getPipe());
+	* \return number of command received or \c 0xFF if no command of the pipe is pending;
 	* \sa lang4robots_sendCommand(),lang4robots_executeCommand()
 	*/
 	uint8_t lang4robots_receiveCommand(uint8_t dataPipe);
 	
+	/*! Receive command with its argument block.
+	* \detail Commands are taken from the frames queued by lang4robots_receiveFrames(), one command record per call, so call it until it returns \c 0xFF to get all of them (or use lang4robots_poll()). The command is kept until the next one is received (see lang4robots_getFrame()); its argument block is padded with zeros up to the argument size of the command. The first (up to) 4 argument bytes are decoded little-endian into \c param; missing bytes are zero. The commands are queued in the order their frames arrived: a command of another pipe than \c dataPipe is left in the queue, and the commands behind it wait until it is taken with its own pipe number or \c L4R_PIPE_ANY.
+	* \warning Call it from the main loop only - it is the single consumer of the received frames queue.
+	* \param dataPipe	- data pipe number (0-5) the command must come from, or \c L4R_PIPE_ANY (see lang4robots_getPipe());
+	* \param param	- a pointer to the handler parameter to fill; may be \c 0;
+	* \return number of command received or \c 0xFF if no command of the pipe is pending or the frame is malformed;
+	* \sa lang4robots_sendCommandWithArgs(),lang4robots_executeCommand()
+	*/
+	uint8_t lang4robots_receiveCommandWithArgs(uint8_t dataPipe, uint32_t* param);
+	
+	/*! Move received frames from the radio RX FIFO to the received frames queue.
+	* \detail This is the only receive work to be done in the module IRQ handler (on \c RX_DR): no command is executed here. The whole RX FIFO is drained in one call and every frame is tagged with its own data pipe. ACK payloads received while transmitting (on a module that is not in RX mode) are taken as replies for lang4robots_sendCommandAndWait(). Frames stay in the radio RX FIFO while the queue is full and are moved on the next \c RX_DR interrupt.
+	* \param radio	- the module that raised \c RX_DR;
+	* \return number of frames queued;
+	* \sa lang4robots_poll()
+	*/
+	uint8_t lang4robots_receiveFrames(nrf24_dev* radio);
+	
+	/*! Execute every pending command.
+	* \detail Every command record of every queued frame is executed in the order it was sent; duplicate frames are dropped. Malformed records are skipped. Call it from the main loop; command handlers run here, outside of any interrupt. The packing deadline of queued commands is checked and the transmit window is serviced (see lang4robots_txService()) as well. If the frame requested a reply, the return value of its last command is loaded as the ACK payload of the frame's data pipe; replies nobody has fetched are flushed when they fill the TX FIFO.
+	* \return number of commands executed;
+	* \sa lang4robots_receiveFrames(),lang4robots_executeCommand()
+	*/
+	uint8_t lang4robots_poll(void);
+	
+	/*! Check if the interface has any work queued.
+	* \return \c '1' - received commands waiting for lang4robots_poll(), a packed frame waiting for its deadline or frames not delivered yet; \c '0' - idle;
+	* \sa lang4robots_poll()
+	*/
+	_Bool lang4robots_busy(void);
+	
+	/*! Hand the frames waiting in the transmit window to the radio TX stream.
+	* \detail Frames wait in the window while the stream is full, while frames for another address are still being sent and during the backoff of a software retransmission. Nothing blocks here: a frame whose backoff has not passed yet is left for a later call. lang4robots_poll() calls it, so it is enough to poll the interface from the main loop.
+	* \return number of frames sent and not yet delivered or failed;
+	* \sa lang4robots_txDone(),lang4robots_txFailed()
+	*/
+	uint8_t lang4robots_txService(void);
+	
+	/*! Transmit window hook for \c TX_DS.
+	* \detail Call it from the module IRQ handler on \c TX_DS (after clearing the flag) instead of nRF24_streamService(): the oldest frame sent is delivered and the stream is topped up.
+	* \param radio	- the module that raised \c TX_DS;
+	* \sa lang4robots_txFailed()
+	*/
+	void lang4robots_txDone(nrf24_dev* radio);
+	
+	/*! Transmit window hook for \c MAX_RT.
+	* \detail Call it from the module IRQ handler on \c MAX_RT, before clearing the flag. The stream is aborted: the failed frame is sent again after \c L4R_TX_BACKOFF_US (doubled with every try), or reported failed after \c L4R_TX_RETRIES retransmissions; the frames behind it, not sent yet, follow in their order. A failed reply fetch is dropped at once.
+	* \param radio	- the module that raised \c MAX_RT;
+	* \sa lang4robots_txDone(),lang4robots_txService()
+	*/
+	void lang4robots_txFailed(nrf24_dev* radio);
+	
+	/*! Set the delivery hook.
+	* \detail The hook is called with the delivery status of every frame but reply fetches, in the order the frames were sent, from the module IRQ handler.
+	* \param hook	- the hook, \c 0 - none;
+	* \sa l4r_delivery
+	*/
+	void lang4robots_setDeliveryHook(l4r_deliveryHook hook);
+	
+	/*! Get the sequence number of the frame the last command was queued in.
+	* \return sequence number (\c L4R_SEQ_MASK bits), the one reported to the delivery hook;
+	*/
+	uint8_t lang4robots_lastSeq(void);
+	
+	/*! Get the transport statistics.
+	* \param stats	- the statistics;
+	*/
+	void lang4robots_getTransportStats(l4r_transportStats* stats);
+	
+	/*! Get the last received command.
+	* \return a pointer to the frame filled by lang4robots_receiveCommandWithArgs();
+	*/
+	const commandFrame* lang4robots_getFrame(void);
+	
+	/*! Get the data pipe of the last received command.
+	* \return data pipe number (0-5);
+	*/
+	uint8_t lang4robots_getPipe(void);
+	
 	/*! Execute the command received via the radio module.
-	* \param comm	- command number to execute; the function of that number in \c 'handlersArray' will be executed;
-	* \param param	- the argument parameter given to the executed function;
-	* \return the return value of the executed function;
+	* \detail A bounds checked direct jump through the command table bound to the data pipe of the last received command (see lang4robots_bindTable()); \c 'handlersArray' unless another table is bound.
+	* \param comm	- command number to execute; the handler of that number in the table will be executed;
+	* \param args	- a pointer to the argument structure of the command (word aligned, \c argSize[comm] bytes of the table); lang4robots_getFrame()->args for the received command;
+	* \return the return value of the executed function or \c 0xFF if \c comm is not a command of the table;
 	* \sa lang4robots_sendCommand(),lang4robots_receiveCommand(), handlersArray
 	*/
-	uint32_t lang4robots_executeCommand(uint8_t comm, uint32_t param);
+	uint32_t lang4robots_executeCommand(uint8_t comm, const void* args);
+	
+	/*! Bind a command table to a data pipe.
+	* \detail Commands received on the pipe are executed from the table from then on. All pipes are bound to \c lang4robots_commands (\c L4R_COMMANDS) by default.
+	* \param pipe	- data pipe number (0-5);
+	* \param table	- the command table (see \c L4R_TABLE_DEFINE), \c 0 - \c lang4robots_commands;
+	* \return status of the operation: \c '1' - bound, \c '0' - wrong pipe number;
+	* \sa lang4robots_getTable()
+	*/
+	uint8_t lang4robots_bindTable(uint8_t pipe, const commandTable* table);
+	
+	/*! Get the command table bound to a data pipe.
+	* \param pipe	- data pipe number (0-5);
+	* \return a pointer to the table or \c 0 - wrong pipe number;
+	* \sa lang4robots_bindTable()
+	*/
+	const commandTable* lang4robots_getTable(uint8_t pipe);
 	
 	/*! Initialize all modules needed.
-	* \detail This function initializes the pins, nRF24 and SPI modules.
+	* \detail This function initializes the clock, the SPI module and the radio modules with their pins. Commands are received on \c rx and sent from \c tx; one module may do both. Dynamic Payload Length (all pipes) and ACK Payload are required; they are the nRF24_init() defaults and are enabled here again in case the defaults have been changed.
 	* \note Make sure to check if all 'init' functions are configured properly.
+	* \param rx	- the module commands are received on;
+	* \param tx	- the module commands are sent from, \c 0 - \c rx;
 	* \return \c '0';
-	* \sa	nRF24_init(), pin_Init(), spi1init()
+	* \sa	delay_init(), nRF24_init(), pin_Init(), spiBus_init()
 	*/
-	uint8_t lang4robots_init(void);
+	uint8_t lang4robots_init(nrf24_dev* rx, nrf24_dev* tx);
 	//!@}
 	
 	/*! \name COMMAND HANDLERS
-	*  The set of application specified command handlers written by end user.
+	*  The command handlers declarations generated from the registry.
 	*  @{
 	*/
 	/******************
 	* COMMAND HANDLERS
 	******************/
-	/*! Function 0 handler.
-	* \param comm;	
-	* \return comm;
-	*/
-	uint32_t fun0(uint32_t comm);
-	
-	/*! Function 1 handler.
-	* \param comm;	
-	* \return comm;
-	*/
-	uint32_t fun1(uint32_t comm);
-	
-	/*! Function 2 handler.
-	* \param comm;	
-	* \return comm;
-	*/
-	uint32_t fun2(uint32_t comm);
+	L4R_COMMANDS(L4R_COMMAND_DECL)
 	//!@}
 	
 	/*! \name COMMAND VARIABLES AND HANDLERS ARRAY
@@ -149,14 +431,20 @@
 	*/
 	extern enum CommandType command;
 	
-	/*! The array of function handlers.
-	* \detail Fill the written functions names in the specified order. All functions used in \c 'handlersArray' must have their corresponding enumerator in \c 'CommandType' enumeration type.
-	* \warning IT IS VITAL TO FILL THE ARRAY IN THE SAME ORDER AS GOES IN \c 'enum \c CommandType'! Otherwise, the command names does not match their functions and executing a specific command may call a different function.
-	* 
-	* The \c 'handlersArray' size must not exceed the number defined by the \b 'COMMANDS_NR' constant.
-	* \sa CommandType,commandHandlersArray
+	/*! The dispatch table, generated from \c L4R_COMMANDS in \c 'enum \c CommandType' order.
+	* \sa CommandType,commandHandler
+	*/
+	extern const commandHandler handlersArray[COMMANDS_NR];
+	
+	/*! Argument structure size of every command, generated from \c L4R_COMMANDS.
+	* \sa L4R_ARGS
+	*/
+	extern const uint8_t lang4robots_argSize[COMMANDS_NR];
+	
+	/*! The command table of \c L4R_COMMANDS - \c 'handlersArray' and \c lang4robots_argSize.
+	* \sa lang4robots_bindTable()
 	*/
-	extern commandHandlersArray handlersArray;
+	extern const commandTable lang4robots_commands;
 	
 	/*! The ACK enabled/disabled flag.
 	* \detail \c '1' - send command with Auto ACK feature enabled, \c '0' - send command with Auto ACK feature disabled;
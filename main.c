@@ -4,19 +4,66 @@
 #include "delay.h"
 #include "pinManagement.h"
 #include "nRF24.h"
+#include "powerManagement.h"
+#include "channelManager.h"
+#include "benchmark.h"
 
 #define MASTER	0
+#define BENCHMARK	0 //run the benchmark suite against a board with the normal firmware (MASTER 0), results in benchResults[]
+#define DUAL_RADIO	0 //second module on the PIN_RADIO_B pins: commands are received on radioA and sent from radioB
+
+static nrf24_dev radioA=nRF24_DEV(PIN_RADIO_A);
+#if DUAL_RADIO
+static nrf24_dev radioB=nRF24_DEV(PIN_RADIO_B);
+#define RADIO_TX	(&radioB)
+#else
+#define RADIO_TX	(&radioA)
+#endif
+static uint8_t peerAddr[5]=nRF24_DEFAULT_TX_ADDR;
+
+/*! Announce the hop set index to the slaves (master).
+*/
+static void channelAnnounce(uint8_t index){
+	channel_args args;
+	
+	args.index=index;
+	lang4robots_sendCommandWithArgs(peerAddr,comChannel,L4R_ARGS(comChannel,&args));
+}
+
+#if BENCHMARK
+#define BENCH_BOARD_RESULTS	36 //one data rate - the peer board does not follow the sweep
+
+bench_result benchResults[BENCH_BOARD_RESULTS]; //read out with the debugger
+uint16_t benchCount;
+
+static void benchStore(const bench_result* result){
+	if(benchCount<BENCH_BOARD_RESULTS){
+		benchResults[benchCount]=*result;
+	}
+	benchCount++;
+	slcdDisplay(benchCount,10);
+}
+#endif
 
 int main (void)
 {
 	uint8_t comm=0;
+	uint32_t next;
 	
+	delay_init();
+	power_init(RADIO_TX);
 	slcdInitialize();
-	pin_Init();
-	spi1init();
-	pin_CE(LOW);
-	nRF24_init();
+	lang4robots_init(&radioA,RADIO_TX); //clock, pins, SPI and nRF24 with the lang4robots payload settings
 	
+#if BENCHMARK
+	{
+		bench_port port={"board",benchStore,0,peerAddr,RADIO_TX};
+		
+		bench_run(&port);
+	}
+#endif
+	channel_init(MASTER ? RADIO_TX : &radioA,MASTER ? CHANNEL_MASTER : CHANNEL_SLAVE); //the quietest channel of the hop set; the master hops on the module it sends from
+	channel_setAnnounce(channelAnnounce);
 	if(MASTER){
 		while(1){
 			/*
@@ -26,8 +73,12 @@ int main (void)
 			nRF24_modeTX();
 			pin_CE(HIGH);
 			delay_ms(2000);*/
-			lang4robots_sendCommand(_TX_ADDR,comm);
-			delay_ms(2000);
+			lang4robots_sendCommand(peerAddr,comm);
+			next=delay_deadline(2000000);
+			while(!delay_expired(next)){
+				channel_tick(); //beacons and hops between the commands
+				lang4robots_poll(); //software retransmissions
+			}
 			comm++;
 			if(comm>2){
 				comm=0;
@@ -35,57 +86,59 @@ int main (void)
 		}
 	}else{
 		//delay_ms(10);
-		nRF24_modeRX();
-		pin_CE(HIGH);
+		nRF24_modeRX(&radioA);
 	}
 	while(1){
-		
+		channel_tick(); //walk the hop set while the master is not heard
+		if(lang4robots_poll()){
+			power_activity();
+		}else{
+			power_idle(lang4robots_busy); //sleep until the module IRQ pin or a timer wakes the core up
+		}
 	}
 
 }
 
-//IRQ Handler for module IRQ pin - move this function to main.c file//
-void PORTC_PORTD_IRQHandler(void){ //check irqhandler name
-  if(PIN_IRQ_SOURCE(PORT_IRQ, PIN_IRQ)){
-    uint8_t statusReg,irq_mask;
-    PIN_IRQ_CLEAR_FLAG(PORT_IRQ, PIN_IRQ);
-		pin_CE(LOW);
-    statusReg=nRF24_getStatus();
-		delay_us(10);
-		
-    if(statusReg & RX_DR){
-      //data received routine
-			irq_mask|=RX_DR;
-			nRF24_writeRegister(STATUS,&irq_mask,1);
-			//nRF24_receiveData(&irq_mask,1);
-			irq_mask=((statusReg&RX_P_NO(7))>>1);
-			if(irq_mask>5){
-				slcdErr(6);
-			}else{
-				//slcdDisplay((uint16_t)lang4robots_receiveCommand(irq_mask),16);
-				lang4robots_executeCommand(lang4robots_receiveCommand(irq_mask),0);
-			}
-			pin_CSN(HIGH);
-			//while(1){;}
-    }if(statusReg & TX_DS){
-      //data sent routine
-			irq_mask|=TX_DS;
-			nRF24_writeRegister(STATUS,&irq_mask,1);
-			pin_CSN(HIGH);
-			//while(1){;}
-    }if(statusReg & MAX_RT){
-      //max retransmission routine
-			irq_mask|=MAX_RT;
-			nRF24_writeRegister(STATUS,&irq_mask,1);
-			slcdDisplay((uint16_t)nRF24_getPacketLossCount(),16);
-			pin_CSN(HIGH);
-			delay_ms(1000);
-			//while(1){;}
-    }
-		
-		//delay_ms(10);
-		pin_CE(HIGH);
-  }else{
-    //error
-  }
+/*! Serve the interrupt of one module.
+* \param radio	- the module whose \c IRQ pin has fallen;
+*/
+static void radioIrq(nrf24_dev* radio){
+	uint8_t statusReg,irq_mask;
+	
+	statusReg=nRF24_getStatus(radio);
+	if(statusReg & RX_DR){
+		//data received routine
+		irq_mask=RX_DR;
+		nRF24_writeRegister(radio,STATUS,&irq_mask,1);
+		irq_mask=((statusReg&RX_P_NO(7))>>1);
+		if(irq_mask>5){
+			slcdErr(6);
+		}else{
+			lang4robots_receiveFrames(radio); //commands are executed by lang4robots_poll() in the main loop
+			channel_heard();
+		}
+	}if(statusReg & TX_DS){
+		//data sent routine
+		irq_mask=TX_DS;
+		nRF24_writeRegister(radio,STATUS,&irq_mask,1);
+		lang4robots_txDone(radio); //the oldest frame is delivered, load the next queued frames
+	}if(statusReg & MAX_RT){
+		//max retransmission routine
+		slcdDisplay((uint16_t)nRF24_getPacketLossCount(radio),16);
+		lang4robots_txFailed(radio); //the frame is sent again after a backoff, from the main loop
+		irq_mask=MAX_RT;
+		nRF24_writeRegister(radio,STATUS,&irq_mask,1); //cleared after the stream is stopped, so the module does not retransmit at once
+	}
+}
+
+//IRQ Handler for module IRQ pins - every module with its IRQ pin on PORTC or PORTD is checked//
+void PORTC_PORTD_IRQHandler(void){
+	if(pin_IRQ(&radioA.pins)){
+		radioIrq(&radioA);
+	}
+#if DUAL_RADIO
+	if(pin_IRQ(&radioB.pins)){
+		radioIrq(&radioB);
+	}
+#endif
 }
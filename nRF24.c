@@ -33,30 +33,21 @@ static uint8_t RX_PW_P2_INIT=		RX_PW(1); //!< default payload for data pipe 2 -
 static uint8_t RX_PW_P3_INIT=		RX_PW(1); //!< default payload for data pipe 3 - 1 byte
 static uint8_t RX_PW_P4_INIT=		RX_PW(1); //!< default payload for data pipe 4 - 1 byte
 static uint8_t RX_PW_P5_INIT=		RX_PW(1); //!< default payload for data pipe 5 - 1 byte
-static uint8_t DYN_PD_INIT=			0; //!< Dynamic Payload Length disabled for all data pipes
-static uint8_t FEATURE_INIT=		EN_DYN_ACK; //!< enabled W_TX_PAYLOAD_NOACK command; disabled ACK Payload and Dynamic Payload Length
+static uint8_t DYN_PD_INIT=			(DPL_P5 | DPL_P4 | DPL_P3 | DPL_P2 | DPL_P1 | DPL_P0); //!< Dynamic Payload Length enabled for all data pipes (RX_PW_Px is not used then)
+static uint8_t FEATURE_INIT=		(EN_DPL | EN_ACK_PAY | EN_DYN_ACK); //!< enabled W_TX_PAYLOAD_NOACK command, ACK Payload and Dynamic Payload Length
 //!@}
 
-/*! \name GLOBAL VARIABLES
-*  The global variables and arrays used in different interface functions.
+/*! \name DEFAULT ADDRESSES
+*  The addresses written to every module by nRF24_init().
 *  @{
 */
-/******************
-* GLOBAL VARIABLES 
-******************/
-
-volatile uint8_t TX_PLD[32]; //!< TX Payload buffer (up to 32 bytes). May be used to store data for transmission.
-volatile uint8_t RX_PLD[32]; //!< RX Payload buffer (up to 32 bytes). May be used to store received data.
-volatile uint8_t ACK_PLD[32]; //!< ACK Payload buffer (up to 32 bytes). May be used to store data which would be attached to ACK packet.
-	
-volatile uint8_t _RX_ADDR_P0[5]={0xD5,0xD5,0xD5,0xD5,0xD5}; //!< RX Address for data pipe 0 (up to 5 bytes). The address bytes' order is from LSByte (_RX_ADDR_P0[0]) to MSByte (_RX_ADDR_P0[4]).
-volatile uint8_t _RX_ADDR_P1[5]={0xC1,0xC3,0xC3,0xC3,0xC3}; //!< RX Address for data pipe 1 (up to 5 bytes). The address bytes' order is from LSByte (_RX_ADDR_P1[0]) to MSByte (_RX_ADDR_P1[4]).
-volatile uint8_t _RX_ADDR_P2=0xC2; //!< The LSByte for data pipe 2 RX Address. First 4 MSBytes are the same as for data pipe 1.
-volatile uint8_t _RX_ADDR_P3=0xC3; //!< The LSByte for data pipe 3 RX Address. First 4 MSBytes are the same as for data pipe 1.
-volatile uint8_t _RX_ADDR_P4=0xC4; //!< The LSByte for data pipe 4 RX Address. First 4 MSBytes are the same as for data pipe 1.
-volatile uint8_t _RX_ADDR_P5=0xC5; //!< The LSByte for data pipe 5 RX Address. First 4 MSBytes are the same as for data pipe 1.
-volatile uint8_t _TX_ADDR[5]={0xD5,0xD5,0xD5,0xD5,0xD5}; //!< TX Address (up to 5 bytes). The address bytes' order is from LSByte (_TX_ADDR[0]) to MSByte (_TX_ADDR[4]).																									/*!< \note In order to receive ACK packet, set the same address for data pipe 0 before start of the transmission. */
-																													/*!< \note In order to receive ACK packet, set the same address for data pipe 0 before start of the transmission. */
+/*******************
+* DEFAULT ADDRESSES
+*******************/
+static uint8_t RX_ADDR_P0_INIT[5]=nRF24_DEFAULT_RX_ADDR_P0; //!< RX Address for data pipe 0, from LSByte to MSByte
+static uint8_t RX_ADDR_P1_INIT[5]=nRF24_DEFAULT_RX_ADDR_P1; //!< RX Address for data pipe 1, from LSByte to MSByte
+static uint8_t RX_ADDR_P25_INIT[4]={nRF24_DEFAULT_RX_ADDR_P2,nRF24_DEFAULT_RX_ADDR_P3,nRF24_DEFAULT_RX_ADDR_P4,nRF24_DEFAULT_RX_ADDR_P5}; //!< LSBytes of the RX Addresses for data pipes 2-5
+static uint8_t TX_ADDR_INIT[5]=nRF24_DEFAULT_TX_ADDR; //!< TX Address, from LSByte to MSByte
 //!@}
 
 /*! \name LOW-LEVEL INSTRUCTIONS
@@ -67,69 +58,298 @@ volatile uint8_t _TX_ADDR[5]={0xD5,0xD5,0xD5,0xD5,0xD5}; //!< TX Address (up to
 * LOW-LEVEL INSTRUCTIONS
 ************************/
 
+/*! Chip select hook of the module on the SPI bus manager - drives its \c CSN pin.
+* \param device - \c bus member of the module handle;
+* \param level - \c CSN pin level;
+* \sa nRF24_DEV()
+*/
+void nRF24_select(spiBus_device* device, _Bool level){
+	pin_CSN(&((nrf24_dev*)device)->pins, level); //bus is the first member of the handle
+}
+
+/*! Execute one SPI transaction: the instruction followed by \c len data bytes in a single CSN frame.
+* \detail The whole frame is one transaction of the SPI bus manager, queued ahead of the lower priority devices and waited for; it costs one SPI1 FIFO watermark interrupt per 4 bytes (\c SPI1_FIFO_MODE), or a single DMA completion interrupt with \c SPI1_DMA_MODE enabled.
+* \param dev - the module;
+* \param com - module instruction value (use instruction mnemonics provided with \c 'nRF24L01P.h' file);
+* \param tx - a pointer to the data bytes sent after the instruction; if \c '0', NOP bytes are sent;
+* \param rx - a pointer to the destination array for the bytes clocked in after the instruction; if \c '0', they are dropped;
+* \param len - amount of data bytes (0-32);
+* \return \c STATUS register value shifted out together with the instruction;
+* \sa nRF24_sendCommand(),nRF24_readRegister(),nRF24_writeRegister()
+*/
+uint8_t nRF24_transaction(nrf24_dev* dev, const uint8_t com, uint8_t* tx, uint8_t* rx, uint8_t len){
+	uint8_t frameTX[33],frameRX[33];
+	int i;
+
+	if(len>32){
+		len=32;
+	}
+	frameTX[0]=com;
+	for(i=0; i<len; i++){
+		frameTX[i+1]=tx ? *(tx+i) : NOP;
+	}
+
+	spiBus_transfer(&dev->bus, frameTX, frameRX, len+1); //CSN is framed by nRF24_select()
+
+	if(rx){
+		for(i=0; i<len; i++){
+			*(rx+i)=frameRX[i+1];
+		}
+	}
+
+	return frameRX[0];
+}
+
 /*! Send an instruction to the module.
+* \param dev - the module;
 * \param com - module instruction value (use instruction mnemonics provided with \c 'nRF24L01P.h' file);
 * \return module instruction value passed to the function;
 * \sa nRF24L01P.h,nRF24_readRegister(),nRF24_writeRegister()
 */
-uint8_t nRF24_sendCommand(const uint8_t com){
-  pin_CSN(LOW);
-	//delay_us(130); //?
-  spi1_byte_send(com,0);
-	delay_us(10);
-  pin_CSN(HIGH);
+uint8_t nRF24_sendCommand(nrf24_dev* dev, const uint8_t com){
+	nRF24_transaction(dev, com, 0, 0, 0);
 	
 	return com;
 }
   
 /*! Write to the module register.
 * \warning Make sure the \c CE pin is low before writing to any register. The module cannot be in RX,TX or standby II mode, but may be powered down.
+* \param dev - the module;
 * \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
 * \param val - a pointer to the source array, from where the data will be written to the module register;
 * \param len - amount of bytes to write to the module register;
 * \return last value written to the register from \c val array;
 * \sa nRF24L01P.h,nRF24_readRegister(),nRF24_sendCommand()
 */
-uint8_t nRF24_writeRegister(const uint8_t reg, uint8_t* val, uint8_t len){
-  int i;
-	
-	pin_CSN(LOW);
-	//delay_us(130); //?
-  spi1_byte_send(W_REGISTER | reg,0);
-  for(i=0; i<len; i++){
-    //delay_us(10);
-		spi1_byte_send(*(val+i) , 0);
-  }
-	//delay_us(10);
-  pin_CSN(HIGH);
-	delay_us(10);
+uint8_t nRF24_writeRegister(nrf24_dev* dev, const uint8_t reg, uint8_t* val, uint8_t len){
+	nRF24_transaction(dev, W_REGISTER | reg, val, 0, len);
 
-	return *(val+i-1);
+	return *(val+len-1);
 }
 
 /*! Read from the module register.
 * \note In opposite to writing operations, reading from the module registers is allowed in any mode.
+* \param dev - the module;
 * \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
 * \param dest - a pointer to the destination array, where the read data will be stored;
 * \param len - amount of bytes to read from the module register;
 * \return last value read from the module register;
 * \sa nRF24L01P.h,nRF24_readRegister(),nRF24_sendCommand()
 */
-uint8_t nRF24_readRegister(const uint8_t reg, uint8_t* dest, uint8_t len){
-  int i;
-
-  pin_CSN(LOW);
-	//delay_us(130);
-  spi1_byte_send(R_REGISTER + reg,0);
-  for(i=0; i<len; i++){
-		//delay_us(10);
-		*(dest+i)=spi1_read_byte(NOP);
-  }
-	//delay_us(10);
-  pin_CSN(HIGH);
-	delay_us(10);
+uint8_t nRF24_readRegister(nrf24_dev* dev, const uint8_t reg, uint8_t* dest, uint8_t len){
+	nRF24_transaction(dev, R_REGISTER | reg, 0, dest, len);
 	
-	return *(dest+i-1);
+	return *(dest+len-1);
+}
+
+/*! Get the amount of bytes of the address register.
+* \param reg - \c RX_ADDR_P0-5 or \c TX_ADDR;
+* \return \c '5' for \c RX_ADDR_P0, \c RX_ADDR_P1 and \c TX_ADDR, \c '1' for \c RX_ADDR_P2-5;
+*/
+static uint8_t nRF24_addrLength(const uint8_t reg){
+	return (reg==RX_ADDR_P0 || reg==RX_ADDR_P1 || reg==TX_ADDR) ? 5 : 1;
+}
+
+/*! Write one shadowed register (or address) from the RAM shadow to the module and clear its dirty flag.
+* \param dev - the module;
+* \param reg - shadowed register address, \c RX_ADDR_P0-5 or \c TX_ADDR;
+*/
+static void nRF24_flushRegister(nrf24_dev* dev, const uint8_t reg){
+	uint8_t* shadow;
+	uint8_t len;
+#if nRF24_VERIFY_WRITES
+	uint8_t i,val[5];
+#endif
+
+	if(reg>=RX_ADDR_P0 && reg<=TX_ADDR){
+		shadow=dev->addrShadow[reg-RX_ADDR_P0];
+		len=nRF24_addrLength(reg);
+	}else{
+		shadow=&dev->shadow[reg];
+		len=1;
+	}
+	nRF24_writeRegister(dev, reg,shadow,len);
+	dev->dirty &= ~(1UL<<reg);
+#if nRF24_VERIFY_WRITES
+	nRF24_readRegister(dev, reg,val,len);
+	for(i=0; i<len; i++){
+		if(val[i]!=*(shadow+i)){
+			nRF24_writeRegister(dev, reg,shadow,len); //one retry, nRF24_verifyConfig() reports what is still wrong
+			break;
+		}
+	}
+#endif
+}
+
+/*! Update a configuration register through its RAM shadow.
+* \detail The register is written only if \c val differs from the shadow. Registers not listed in \c nRF24_SHADOW_REGS (e.g. \c STATUS) are always written.
+* \par Outside a batch the change is committed at once (see nRF24_batchCommit()); inside a batch it is only marked and written by the closing nRF24_batchCommit().
+* \param dev - the module;
+* \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
+* \param val - new register value;
+* \return new register value;
+* \sa nRF24_getRegister(),nRF24_verifyConfig(),nRF24_batchBegin()
+*/
+uint8_t nRF24_updateRegister(nrf24_dev* dev, const uint8_t reg, uint8_t val){
+	if(reg>FEATURE || !(nRF24_SHADOW_REGS & (1UL<<reg))){
+		return nRF24_writeRegister(dev, reg,&val,1);
+	}
+	if(dev->shadow[reg]!=val){
+		nRF24_batchBegin(dev);
+		dev->shadow[reg]=val;
+		dev->dirty |= (1UL<<reg);
+		nRF24_batchCommit(dev);
+	}
+
+	return val;
+}
+
+/*! Update an address register through its RAM shadow.
+* \detail The register is written only if \c addr differs from the shadow; batches are handled as in nRF24_updateRegister().
+* \param dev - the module;
+* \param reg - \c RX_ADDR_P0-5 or \c TX_ADDR;
+* \param addr - a pointer to the LSByte of the address;
+* \return the LSByte of the address;
+*/
+static uint8_t nRF24_updateAddress(nrf24_dev* dev, const uint8_t reg, uint8_t* addr){
+	uint8_t* shadow=dev->addrShadow[reg-RX_ADDR_P0];
+	uint8_t i,len=nRF24_addrLength(reg);
+
+	for(i=0; i<len; i++){
+		if(*(shadow+i)!=*(addr+i)){
+			*(shadow+i)=*(addr+i);
+			dev->dirty |= (1UL<<reg);
+		}
+	}
+	if(dev->dirty & (1UL<<reg)){
+		nRF24_batchBegin(dev);
+		nRF24_batchCommit(dev);
+	}
+
+	return *addr;
+}
+
+/*! Write \c CONFIG for an operational mode change.
+* \detail Mode changes cannot wait for a batch commit, so the register is written at once (if it changes) and without touching \c CE.
+* \param dev - the module;
+* \param val - new \c CONFIG register value;
+*/
+static void nRF24_setConfig(nrf24_dev* dev, uint8_t val){
+	if(dev->shadow[CONFIG]!=val){
+		dev->shadow[CONFIG]=val;
+		nRF24_flushRegister(dev, CONFIG);
+	}
+}
+
+/*! Open a configuration batch.
+* \detail Until the matching nRF24_batchCommit() every setter only updates the RAM shadow and marks the register as changed. Batches may be nested; only the outermost commit writes to the module.
+* \param dev - the module;
+* \sa nRF24_batchCommit()
+*/
+void nRF24_batchBegin(nrf24_dev* dev){
+	dev->batchDepth++;
+}
+
+/*! Close a configuration batch and write every changed register to the module.
+* \detail If the module is in RX, TX or standby II mode, \c CE is dropped (standby I) for the time of writing and raised again afterwards, so the operational mode is kept. Unchanged registers are skipped. \c FEATURE is written first (it gates \c DYN_PD) and \c CONFIG last.
+* \param dev - the module;
+* \return number of registers written to the module;
+* \sa nRF24_batchBegin()
+*/
+uint8_t nRF24_batchCommit(nrf24_dev* dev){
+	uint8_t reg,written=0;
+	_Bool ceHigh;
+
+	if(dev->batchDepth>0){
+		dev->batchDepth--;
+	}
+	if(dev->batchDepth>0 || dev->dirty==0){
+		return 0;
+	}
+
+	ceHigh=(dev->state==STATE_RX || dev->state==STATE_TX || dev->state==STATE_STANDBY_II);
+	if(ceHigh){
+		pin_CE(&dev->pins, LOW);
+	}
+	if(dev->dirty & (1UL<<FEATURE)){
+		nRF24_flushRegister(dev, FEATURE);
+		written++;
+	}
+	for(reg=EN_AA; reg<=DYN_PD; reg++){
+		if(dev->dirty & (1UL<<reg)){
+			nRF24_flushRegister(dev, reg);
+			written++;
+		}
+	}
+	if(dev->dirty & (1UL<<CONFIG)){
+		nRF24_flushRegister(dev, CONFIG);
+		written++;
+	}
+	if(ceHigh){
+		pin_CE(&dev->pins, HIGH);
+	}
+
+	return written;
+}
+
+/*! Get the configuration register value.
+* \detail Registers listed in \c nRF24_SHADOW_REGS are returned from the RAM shadow without any SPI traffic. Other registers are read from the module.
+* \param dev - the module;
+* \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
+* \return register value;
+* \sa nRF24_updateRegister(),nRF24_verifyConfig()
+*/
+uint8_t nRF24_getRegister(nrf24_dev* dev, const uint8_t reg){
+	uint8_t val;
+
+	if(reg<=FEATURE && (nRF24_SHADOW_REGS & (1UL<<reg))){
+		return dev->shadow[reg];
+	}
+	nRF24_readRegister(dev, reg,&val,1);
+
+	return val;
+}
+
+/*! Verify the module configuration against the RAM shadow.
+* \detail All shadowed registers and addresses are read back from the module and compared with the shadow.
+* \param dev - the module;
+* \param repair - \c '1': rewrite every register that does not match the shadow, \c '0': only count them;
+* \return number of registers that did not match the shadow (\c '0' - configuration verified);
+* \sa nRF24_updateRegister(),nRF24_getRegister()
+*/
+uint8_t nRF24_verifyConfig(nrf24_dev* dev, _Bool repair){
+	uint8_t reg,i,len,val[5],errors=0;
+	_Bool match;
+
+	for(reg=CONFIG; reg<=FEATURE; reg++){
+		if(nRF24_SHADOW_REGS & (1UL<<reg)){
+			nRF24_readRegister(dev, reg,val,1);
+			if(val[0]!=dev->shadow[reg]){
+				errors++;
+				if(repair){
+					nRF24_writeRegister(dev, reg,&dev->shadow[reg],1);
+				}
+			}
+		}
+	}
+	for(reg=RX_ADDR_P0; reg<=TX_ADDR; reg++){
+		len=nRF24_addrLength(reg);
+		nRF24_readRegister(dev, reg,val,len);
+		match=1;
+		for(i=0; i<len; i++){
+			if(val[i]!=dev->addrShadow[reg-RX_ADDR_P0][i]){
+				match=0;
+			}
+		}
+		if(!match){
+			errors++;
+			if(repair){
+				nRF24_writeRegister(dev, reg,dev->addrShadow[reg-RX_ADDR_P0],len);
+			}
+		}
+	}
+
+	return errors;
 }
 //!@}
 
@@ -142,184 +362,259 @@ uint8_t nRF24_readRegister(const uint8_t reg, uint8_t* dest, uint8_t len){
 *********************/
 
 /*! Get \c STATUS register value. 
+* \param dev - the module;
 * \return \c STATUS register value;
 * \sa nRF24L01P.h,nRF24_getFIFOstatus()
 */
-uint8_t nRF24_getStatus(void){
-	uint8_t statusReg;
-	
-	pin_CSN(0);
-	statusReg=spi1_read_byte(0xFF);
-	pin_CSN(1);
-	
-	return statusReg;
+uint8_t nRF24_getStatus(nrf24_dev* dev){
+	return nRF24_transaction(dev, NOP, 0, 0, 0);
 }
 
 /*! Get \c FIFO_STATUS register value. 
+* \param dev - the module;
 * \return \c FIFO_STATUS register value;
 * \sa nRF24L01P.h,nRF24_getStatus()
 */
-uint8_t nRF24_getFIFOstatus(void){
+uint8_t nRF24_getFIFOstatus(nrf24_dev* dev){
 	uint8_t fifo_statusReg;
 	
-	nRF24_readRegister(FIFO_STATUS,&fifo_statusReg,1);
+	nRF24_readRegister(dev, FIFO_STATUS,&fifo_statusReg,1);
 	
 	return fifo_statusReg;
 }
 
 /*! Power down the module. 
+* \detail The \c CE pin is cleared and \c PWR_UP is written only if the module is not powered down already.
+* \param dev - the module;
+* \return \c CONFIG register value;
+* \sa nRF24L01P.h,nRF24_standby(),nRF24_modeRX(),nRF24_modeTX()
+*/
+uint8_t nRF24_powerDown(nrf24_dev* dev){
+	pin_CE(&dev->pins, LOW);
+	nRF24_setConfig(dev, dev->shadow[CONFIG] & ~PWR_UP);
+	dev->state=STATE_POWER_DOWN;
+
+	return dev->shadow[CONFIG];
+}
+
+/*! Switch to standby I mode.
+* \detail The \c CE pin is cleared. If the module is powered down, \c PWR_UP is set; the \c nRF24_T_PD2STBY_US oscillator start-up is not waited for here but only by the next nRF24_modeRX()/nRF24_modeTX(), so the time may be used for other work. Otherwise no register is accessed.
+* \par Standby I is the mode in which the module registers may be written.
+* \param dev - the module;
 * \return \c CONFIG register value;
-* \sa nRF24L01P.h,nRF24_modeRX(),nRF24_modeTX()
+* \sa nRF24_powerDown(),nRF24_modeRX(),nRF24_modeTX()
 */
-uint8_t nRF24_powerDown(void){
-	uint8_t configReg;
+uint8_t nRF24_standby(nrf24_dev* dev){
+	pin_CE(&dev->pins, LOW);
+	if(dev->state==STATE_POWER_DOWN){
+		nRF24_setConfig(dev, dev->shadow[CONFIG] | PWR_UP);
+		dev->readyAt=delay_deadline(nRF24_T_PD2STBY_US);
+	}
+	dev->state=STATE_STANDBY_I;
+
+	return dev->shadow[CONFIG];
+}
+
 
-	nRF24_readRegister(CONFIG,&configReg,1);
-  configReg &= ~PWR_UP;
-  nRF24_writeRegister(CONFIG,&configReg,1);
-  //delay_ms(5);
+/*! Power the module up and wait for the oscillator start-up.
+* \detail Standby I is entered if the module is powered down; then the \c nRF24_T_PD2STBY_US start-up of the last power up is waited for. Nothing is done if the module is ready. Call it with interrupts enabled before a masked section which may switch the mode (as nRF24_streamWrite() does), so the wait is not made with the delay clock stopped.
+* \param dev - the module;
+* \return \c CONFIG register value;
+* \sa nRF24_standby(),nRF24_powerDown()
+*/
+uint8_t nRF24_powerUp(nrf24_dev* dev){
+	if(dev->state==STATE_POWER_DOWN){
+		nRF24_standby(dev);
+	}
+	if(!delay_expired(dev->readyAt)){
+		delay_until(dev->readyAt);
+	}
 
-	return configReg;
+	return dev->shadow[CONFIG];
 }
+
 	
 /*! Switch to RX mode. 
+* \detail The module is kept powered up; only \c PRIM_RX (if it differs) and the \c CE pin are changed. Nothing is done if the module already is in RX mode.
+* \par The module starts listening \c nRF24_T_STBY2A_US after the function returns.
+* \param dev - the module;
 * \return \c CONFIG register value;
-* \sa nRF24L01P.h,nRF24_modeTX(),nRF24_powerDown()
+* \sa nRF24L01P.h,nRF24_modeTX(),nRF24_standby(),nRF24_powerDown()
 */
-uint8_t nRF24_modeRX(void){
-  uint8_t configReg;
+uint8_t nRF24_modeRX(nrf24_dev* dev){
+	if(dev->state==STATE_RX){
+		return dev->shadow[CONFIG];
+	}
 
-	configReg=nRF24_powerDown();
-  configReg |= PRIM_RX | PWR_UP;
-  nRF24_writeRegister(CONFIG,&configReg,1); 
-  delay_ms(5);
+	nRF24_standby(dev);
+	nRF24_setConfig(dev, dev->shadow[CONFIG] | PRIM_RX);
+	delay_until(dev->readyAt); //returns at once unless the module has just been powered up
+	pin_CE(&dev->pins, HIGH);
+	dev->state=STATE_RX;
 	
-	return configReg;
+	return dev->shadow[CONFIG];
 }
+
 	
 /*! Switch to TX mode. 
+* \detail The module is kept powered up; only \c PRIM_RX (if it differs) and the \c CE pin are changed. With \c CE held high the module transmits every payload in TX FIFO and then waits in standby II for the next one, so nothing is done if the module is already in TX or standby II mode.
+* \param dev - the module;
 * \return \c CONFIG register value;
-* \sa nRF24L01P.h,nRF24_modeRX(),nRF24_powerDown()
+* \sa nRF24L01P.h,nRF24_modeRX(),nRF24_standby(),nRF24_powerDown()
 */
-uint8_t nRF24_modeTX(void){
-  uint8_t configReg;
+uint8_t nRF24_modeTX(nrf24_dev* dev){
+	if(dev->state==STATE_TX || dev->state==STATE_STANDBY_II){
+		return dev->shadow[CONFIG];
+	}
 
-	configReg=nRF24_powerDown();
-	configReg &= ~PRIM_RX;
-  configReg |= PWR_UP;
-  nRF24_writeRegister(CONFIG,&configReg,1);
-  delay_ms(5);
+	nRF24_standby(dev);
+	nRF24_setConfig(dev, dev->shadow[CONFIG] & ~PRIM_RX);
+	delay_until(dev->readyAt); //returns at once unless the module has just been powered up
+	pin_CE(&dev->pins, HIGH);
+	dev->state=STATE_TX;
 	
-	return configReg;
- }
+	return dev->shadow[CONFIG];
+}
+
+/*! Get the current operational mode of the module.
+* \detail The mode is tracked in RAM. In TX mode the \c FIFO_STATUS register is read to tell TX from standby II (empty TX FIFO).
+* \param dev - the module;
+* \return current \c nRF24_State;
+* \sa nRF24_State,nRF24_standby(),nRF24_modeRX(),nRF24_modeTX(),nRF24_powerDown()
+*/
+enum nRF24_State nRF24_getState(nrf24_dev* dev){
+	if(dev->state==STATE_TX && (nRF24_getFIFOstatus(dev) & TX_EMPTY)){
+		dev->state=STATE_STANDBY_II;
+	}else if(dev->state==STATE_STANDBY_II && !(nRF24_getFIFOstatus(dev) & TX_EMPTY)){
+		dev->state=STATE_TX;
+	}
+
+	return dev->state;
+}
 
 /*! Initialize the module with the default configuration. 
-* \detail The function updates all module registers with the *DEFAULT CONFIGURATION* registers. You may modify them according to your needs.
+* \detail The function updates all module registers with the *DEFAULT CONFIGURATION* registers. You may modify them according to your needs. Every module is initialized on its own; its pins must be set up with pin_Init() and the bus with spiBus_init() first. The module is registered with the SPI bus manager.
+* \param dev - the module;
 * \return \c STATUS register value;
 * \sa nRF24L01P.h
 */
-uint8_t nRF24_init(void){
-	pin_CSN(HIGH);
-	delay_ms(100);
-  nRF24_writeRegister(CONFIG,&CONFIG_INIT,1);
-	delay_ms(5);
-  nRF24_writeRegister(EN_AA,&EN_AA_INIT,1);
-	nRF24_writeRegister(EN_RXADDR,&EN_RXADDR_INIT,1);
-	nRF24_writeRegister(SETUP_AW,&SETUP_AW_INIT,1);
-	nRF24_writeRegister(SETUP_RETR,&SETUP_RETR_INIT,1);
-	nRF24_writeRegister(RF_CH,&RF_CH_INIT,1);
-	nRF24_writeRegister(RF_SETUP,&RF_SETUP_INIT,1);
-	nRF24_writeRegister(STATUS,&STATUS_INIT,1);
-	nRF24_writeRegister(RX_PW_P0,&RX_PW_P0_INIT,1);
-	nRF24_writeRegister(RX_PW_P1,&RX_PW_P1_INIT,1);
-	nRF24_writeRegister(RX_PW_P2,&RX_PW_P2_INIT,1);
-	nRF24_writeRegister(RX_PW_P3,&RX_PW_P3_INIT,1);
-	nRF24_writeRegister(RX_PW_P4,&RX_PW_P4_INIT,1);
-	nRF24_writeRegister(RX_PW_P5,&RX_PW_P5_INIT,1);
-	nRF24_writeRegister(DYN_PD,&DYN_PD_INIT,1);
-	nRF24_writeRegister(FEATURE,&FEATURE_INIT,1);
-	nRF24_writeRegister(RX_ADDR_P0,_RX_ADDR_P0,5);
-	nRF24_writeRegister(RX_ADDR_P1,_RX_ADDR_P1,5);
-	nRF24_writeRegister(RX_ADDR_P2,&_RX_ADDR_P2,1);
-	nRF24_writeRegister(RX_ADDR_P3,&_RX_ADDR_P3,1);
-	nRF24_writeRegister(RX_ADDR_P4,&_RX_ADDR_P4,1);
-	nRF24_writeRegister(RX_ADDR_P5,&_RX_ADDR_P5,1);
-	nRF24_writeRegister(TX_ADDR,_TX_ADDR,5);
-	//delay_ms(100);
-	//pin_CE(HIGH);
-	nRF24_sendCommand(FLUSH_RX);
-	delay_us(10);
-	nRF24_sendCommand(FLUSH_TX);
-	delay_us(10);
+uint8_t nRF24_init(nrf24_dev* dev){
+	uint8_t reg,i;
+
+	SPI_TRACE_BEGIN(SPI_TRACE_API_NRF24_INIT);
+	pin_CE(&dev->pins, LOW);
+	pin_CSN(&dev->pins, HIGH);
+	spiBus_register(&dev->bus);
+	if(delay_micros()<nRF24_T_POR_MS*1000){ //a time stamp, not a timeout: valid only before the clock has run that long
+		delay_until(nRF24_T_POR_MS*1000); //counted from the clock start, so time already spent after reset is not waited again
+	}
+
+	//seed the shadow with the default configuration
+	dev->shadow[CONFIG]=CONFIG_INIT;
+	dev->shadow[EN_AA]=EN_AA_INIT;
+	dev->shadow[EN_RXADDR]=EN_RXADDR_INIT;
+	dev->shadow[SETUP_AW]=SETUP_AW_INIT;
+	dev->shadow[SETUP_RETR]=SETUP_RETR_INIT;
+	dev->shadow[RF_CH]=RF_CH_INIT;
+	dev->shadow[RF_SETUP]=RF_SETUP_INIT;
+	dev->shadow[RX_PW_P0]=RX_PW_P0_INIT;
+	dev->shadow[RX_PW_P1]=RX_PW_P1_INIT;
+	dev->shadow[RX_PW_P2]=RX_PW_P2_INIT;
+	dev->shadow[RX_PW_P3]=RX_PW_P3_INIT;
+	dev->shadow[RX_PW_P4]=RX_PW_P4_INIT;
+	dev->shadow[RX_PW_P5]=RX_PW_P5_INIT;
+	dev->shadow[DYN_PD]=DYN_PD_INIT;
+	dev->shadow[FEATURE]=FEATURE_INIT;
+	for(i=0; i<5; i++){
+		dev->addrShadow[RX_ADDR_P0-RX_ADDR_P0][i]=RX_ADDR_P0_INIT[i];
+		dev->addrShadow[RX_ADDR_P1-RX_ADDR_P0][i]=RX_ADDR_P1_INIT[i];
+		dev->addrShadow[TX_ADDR-RX_ADDR_P0][i]=TX_ADDR_INIT[i];
+	}
+	dev->addrShadow[RX_ADDR_P2-RX_ADDR_P0][0]=RX_ADDR_P25_INIT[0];
+	dev->addrShadow[RX_ADDR_P3-RX_ADDR_P0][0]=RX_ADDR_P25_INIT[1];
+	dev->addrShadow[RX_ADDR_P4-RX_ADDR_P0][0]=RX_ADDR_P25_INIT[2];
+	dev->addrShadow[RX_ADDR_P5-RX_ADDR_P0][0]=RX_ADDR_P25_INIT[3];
+
+	//the module state is unknown after MCU reset, so every register is written once in a single batch
+	dev->batchDepth=0;
+	dev->txHead=dev->txTail=0;
+	dev->streaming=0;
+	dev->dirty=nRF24_SHADOW_REGS;
+	for(reg=RX_ADDR_P0; reg<=TX_ADDR; reg++){
+		dev->dirty |= (1UL<<reg);
+	}
+	nRF24_flushRegister(dev, CONFIG); //power up first, the oscillator starts while the rest is written
+	dev->state=(dev->shadow[CONFIG] & PWR_UP) ? STATE_STANDBY_I : STATE_POWER_DOWN;
+	dev->readyAt=delay_deadline(nRF24_T_PD2STBY_US);
+	nRF24_batchBegin(dev);
+	nRF24_batchCommit(dev);
+	nRF24_writeRegister(dev, STATUS,&STATUS_INIT,1);
+	nRF24_sendCommand(dev, FLUSH_RX);
+	nRF24_sendCommand(dev, FLUSH_TX);
+	reg=nRF24_getStatus(dev);
+	SPI_TRACE_END();
 	
-  return nRF24_getStatus();
+  return reg;
 }
 
 /*! Set TX Address.
 * \warning The module must be in standby I mode and \c CE pin must be low. Rewriting the TX Address during a transmission is prohibited.
-* \param txAddr - a pointer to the LSByte of the address. You may use the \c '_TX_ADDR' array to store your address;
+* \param dev - the module;
+* \param txAddr - a pointer to the LSByte of the address. \c nRF24_DEFAULT_TX_ADDR is written by nRF24_init();
 * \return the LSByte of the address;
-* \sa nRF24_setRXaddr(),_TX_ADDR
+* \sa nRF24_setRXaddr()
 */
-uint8_t nRF24_setTXaddr(uint8_t* txAddr){
-	nRF24_writeRegister(TX_ADDR,txAddr,5);
-	
-	return *txAddr;
+uint8_t nRF24_setTXaddr(nrf24_dev* dev, uint8_t* txAddr){
+	return nRF24_updateAddress(dev, TX_ADDR,txAddr);
 }
 
 /*! Set RX Address for specific data pipe.
 * \warning The module must be in standby I mode and \c CE pin must be low. Rewriting the RX Address during a transmission is prohibited.
+* \param dev - the module;
 * \param dataPipe - number of data pipe for which the address will be set. The function knows how many bytes should be written depending on the data pipe number;
-* \param rxAddr - a pointer to the LSByte of the address. You may use the \c '_RX_ADDR_P0-1' arrays or \c '_RX_ADDR_P2-5' variables to store your address.
+* \param rxAddr - a pointer to the LSByte of the address. \c nRF24_DEFAULT_RX_ADDR_P0-5 are written by nRF24_init();
 * \return the LSByte of the address;
-* \sa nRF24_setTXaddr(),_RX_ADDR
+* \sa nRF24_setTXaddr()
 */
-uint8_t nRF24_setRXaddr(uint8_t dataPipe, uint8_t* rxAddr){
+uint8_t nRF24_setRXaddr(nrf24_dev* dev, uint8_t dataPipe, uint8_t* rxAddr){
 	if(dataPipe>5){
 		return 0xFF; //error avoidance
 	}
 	
-	if(dataPipe==0 || dataPipe==1){
-		nRF24_writeRegister(RX_ADDR_P0+dataPipe,rxAddr,5);
-	}else{
-		nRF24_writeRegister(RX_ADDR_P0+dataPipe,rxAddr,1);
-	}
-	
-	return *rxAddr;
+	return nRF24_updateAddress(dev, RX_ADDR_P0+dataPipe,rxAddr);
 }
 
 /*! Interrupt settings.
 * \note The IRQ pin must be connected to the MCU and the module should not be in any transmission mode during IRQ configuration.
 * \par The interrupt flags in \c STATUS register should be cleared before enabling IRQ's.
+* \param dev - the module;
 * \param irqVal - pass the combination of interrupt mnemonics (TX_DS, RX_DR, MAX_RT) which will be enabled/disabled. You may enable/disable more than one IRQ at a time by summing mnemonics with the '|' operator;
 * \param irqEn - \c '1': enable IRQ's with \c irqVal, \c '0': disable IRQ's with \c irqVal;
 * \return \c CONFIG register value;
 * \sa 
 */
-uint8_t nRF24_enDisIRQ(uint8_t irqVal, _Bool irqEn){
-	uint8_t configReg;
-	
-	nRF24_readRegister(CONFIG,&configReg,1);
+uint8_t nRF24_enDisIRQ(nrf24_dev* dev, uint8_t irqVal, _Bool irqEn){
+	uint8_t configReg=dev->shadow[CONFIG];
+
 	if(irqEn){
 		configReg &= ~irqVal; //'0' - IRQ reflected on the pin
 	}else{
 		configReg |= irqVal;
 	}
-  nRF24_writeRegister(CONFIG,&configReg,1);
    
-	return configReg;
+	return nRF24_updateRegister(dev, CONFIG,configReg);
 }
 
 /*! CRC settings.
 * \note The module should not be in any transmission mode during CRC configuration.
+* \param dev - the module;
 * \param crc - \c '0': no CRC, \c '1': 1 byte CRC, \c default: 2 byte CRC;
 * \return \c CONFIG register value;
 * \sa 
 */
-uint8_t nRF24_setCRC(uint8_t crc){
-	uint8_t configReg;
-	
-	nRF24_readRegister(CONFIG,&configReg,1);
+uint8_t nRF24_setCRC(nrf24_dev* dev, uint8_t crc){
+	uint8_t configReg=dev->shadow[CONFIG];
+
 	switch(crc){
 		case 0:
 			configReg &= ~(EN_CRC | CRC0);
@@ -331,131 +626,115 @@ uint8_t nRF24_setCRC(uint8_t crc){
 		default:
 			configReg |= (EN_CRC | CRC0);
 	}
-  nRF24_writeRegister(CONFIG,&configReg,1);
   
-	return configReg;
+	return nRF24_updateRegister(dev, CONFIG,configReg);
 }
 
 /*! Auto ACK settings.
 * \note The module should not be in any transmission mode during Auto ACK configuration.
+* \param dev - the module;
 * \param AAval - pass the combination of EN_AA mnemonics (ENAA_P0-5) which will be enabled/disabled. You may enable/disable Auto ACK on more than one data pipe at a time by summing mnemonics with the '|' operator;
 * \param AAen - \c '1': enable Auto ACK with \c AAval, \c '0': disable Auto ACK with \c AAval;
 * \return \c EN_AA register value;
 * \sa nRF24_enDisDataPipe(),nRF24_enDisDynPayLen(),nRF24_enDisDynACK(),nRF24_enDisACKpayload()
 */
-uint8_t nRF24_enDisAutoACK(uint8_t AAval, _Bool AAen){
-	uint8_t en_aaReg;
+uint8_t nRF24_enDisAutoACK(nrf24_dev* dev, uint8_t AAval, _Bool AAen){
+	uint8_t en_aaReg=dev->shadow[EN_AA];
 	
-	nRF24_readRegister(EN_AA,&en_aaReg,1);
 	if(AAen){
 		en_aaReg |= AAval;
 	}else{
 		en_aaReg &= ~AAval;
 	}
-  nRF24_writeRegister(EN_AA,&en_aaReg,1);
   
-	return en_aaReg;
+	return nRF24_updateRegister(dev, EN_AA,en_aaReg);
 }
+
 	
 /*! Data pipes settings.
 * \note The module should not be in any transmission mode during data pipe configuration.
+* \param dev - the module;
 * \param dataPipeVal - pass the combination of EN_RXADDR mnemonics (ERX_P0-5) which will be enabled/disabled. You may enable/disable more than one data pipe at a time by summing mnemonics with the '|' operator;
 * \param dataPipeEn - \c '1': enable data pipes with \c dataPipeVal, \c '0': disable data pipes with \c dataPipeVal;
 * \return \c EN_RXADDR register value;
 * \sa nRF24_enDisAutoACK(),nRF24_enDisDynPayLen(),nRF24_enDisDynACK(),nRF24_enDisACKpayload()
 */
-uint8_t nRF24_enDisDataPipe(uint8_t dataPipeVal, _Bool dataPipeEn){
-	uint8_t en_rxaddrReg;
+uint8_t nRF24_enDisDataPipe(nrf24_dev* dev, uint8_t dataPipeVal, _Bool dataPipeEn){
+	uint8_t en_rxaddrReg=dev->shadow[EN_RXADDR];
 	
-	nRF24_readRegister(EN_RXADDR,&en_rxaddrReg,1);
 	if(dataPipeEn){
 		en_rxaddrReg |= dataPipeVal;
 	}else{
 		en_rxaddrReg &= ~dataPipeVal;
 	}
-  nRF24_writeRegister(EN_RXADDR,&en_rxaddrReg,1);
   
-	return en_rxaddrReg;
+	return nRF24_updateRegister(dev, EN_RXADDR,en_rxaddrReg);
 }
 
 /*! Set Address Width for data pipes.
 * \note The module should not be in any transmission mode during Address Width configuration.
+* \param dev - the module;
 * \param addrW - \c '5': 5 bytes, \c '4': 4 bytes, \c '3': 3 bytes, \c default: 5 bytes;
 * \return \c SETUP_AW register value;
 * \sa 
 */
-uint8_t nRF24_setAddresWidth(uint8_t addrW){
-	uint8_t setup_awReg;
-
+uint8_t nRF24_setAddresWidth(nrf24_dev* dev, uint8_t addrW){
 	if(addrW<3 || addrW>5){
 		addrW=5;
 	}
-	setup_awReg=AW(addrW-2);
-  nRF24_writeRegister(SETUP_AW,&setup_awReg,1);
   
-	return setup_awReg;
+	return nRF24_updateRegister(dev, SETUP_AW,AW(addrW-2));
 }
 
 /*! Set Automatic Retransmission Delay.
 * \note The module should not be in any transmission mode during Automatic Retransmission Delay configuration.
+* \param dev - the module;
 * \param ard - \c '15': 4000 us, \c '14': 3750 us, ... , \c '1': 500 us, \c '0': 250 us, \c default: 4000 us;
 * \return \c SETUP_RETR register value;
 * \sa nRF24_setAutoRetranCount()
 */
-uint8_t nRF24_setAutoRetranDelay(uint8_t ard){
-	uint8_t setup_retrReg;
-
+uint8_t nRF24_setAutoRetranDelay(nrf24_dev* dev, uint8_t ard){
 	if(ard>15){
 		ard=15;
 	}
-	nRF24_readRegister(SETUP_RETR,&setup_retrReg,1);
-	setup_retrReg |= ARD(ard);
-  nRF24_writeRegister(SETUP_RETR,&setup_retrReg,1);
 
-	return setup_retrReg;
+	return nRF24_updateRegister(dev, SETUP_RETR,(dev->shadow[SETUP_RETR] & ~ARD(15)) | ARD(ard));
 }
 
 /*! Set Automatic Retransmission Count.
+* \param dev - the module;
 * \param ard - \c '15': up to 15 times, \c '14': up to 14 times, ... , \c '1': up to 1 time, \c '0': no auto retransmissions, \c default: up to 15 times;
 * \return \c SETUP_RETR register value;
 * \sa nRF24_setAutoRetranDelay()
 */
-uint8_t nRF24_setAutoRetranCount(uint8_t arc){
-	uint8_t setup_retrReg;
-
+uint8_t nRF24_setAutoRetranCount(nrf24_dev* dev, uint8_t arc){
 	if(arc>15){
 		arc=15;
 	}
-	nRF24_readRegister(SETUP_RETR,&setup_retrReg,1);
-	setup_retrReg |= ARC(arc);
-  nRF24_writeRegister(SETUP_RETR,&setup_retrReg,1);
 
-	return setup_retrReg;	
+	return nRF24_updateRegister(dev, SETUP_RETR,(dev->shadow[SETUP_RETR] & ~ARC(15)) | ARC(arc));
 }
 
 /*! Set RF Channel.
+* \note The Packet Loss Counter is reset only when \c RF_CH is actually written, i.e. when the channel changes.
+* \param dev - the module;
 * \param channel - number of RF Channel on which the module will operate;
 * \return \c RF_CH register value;
 * \sa nRF24_setRFdataRate(),nRF24_setRFoutputPower()
 */
-uint8_t nRF24_setRFchannel(uint8_t channel){
-	uint8_t rf_chReg;
-
-	rf_chReg=RF_CH_MASK(channel);
-  nRF24_writeRegister(RF_CH,&rf_chReg,1);
-  
-	return rf_chReg;
+uint8_t nRF24_setRFchannel(nrf24_dev* dev, uint8_t channel){
+	return nRF24_updateRegister(dev, RF_CH,RF_CH_MASK(channel & 0x7F));
 }
 
 /*! Set RF Data Rate.
+* \param dev - the module;
 * \param dataRate - \c '1': 1 Mbps, \c '0': 250 Kbps, \c default: 2 Mbps;
 * \return \c RF_SETUP register value;
 * \sa nRF24_setRFchannel(),nRF24_setRFoutputPower()
 */
-uint8_t nRF24_setRFdataRate(uint8_t dataRate){
-	uint8_t rf_setupReg;
+uint8_t nRF24_setRFdataRate(nrf24_dev* dev, uint8_t dataRate){
+	uint8_t rf_setupReg=dev->shadow[RF_SETUP];
 
-	nRF24_readRegister(RF_SETUP,&rf_setupReg,1);
 	switch(dataRate){
 		case 0:
 			rf_setupReg |= RF_DR_LOW;
@@ -469,20 +748,19 @@ uint8_t nRF24_setRFdataRate(uint8_t dataRate){
 			rf_setupReg &= ~RF_DR_LOW;
 			rf_setupReg |= RF_DR_HIGH;
 	}
-  nRF24_writeRegister(RF_SETUP,&rf_setupReg,1);
   
-	return rf_setupReg;	
+	return nRF24_updateRegister(dev, RF_SETUP,rf_setupReg);
 }
 
 /*! Set RF Output Power.
+* \param dev - the module;
 * \param power - \c '2': -6 dBm, \c '1': -12 dBm, \c '0': -18 dBm, \c default: 0 dBm;
 * \return \c RF_SETUP register value;
 * \sa nRF24_setRFdataRate(),nRF24_setRFchannel()
 */
-uint8_t nRF24_setRFoutputPower(uint8_t power){
-	uint8_t rf_setupReg;
+uint8_t nRF24_setRFoutputPower(nrf24_dev* dev, uint8_t power){
+	uint8_t rf_setupReg=dev->shadow[RF_SETUP];
 
-	nRF24_readRegister(RF_SETUP, &rf_setupReg, 1);
 	rf_setupReg &= ~RF_PWR(3); //clear actual power settings
 	switch(power){
 		case 0:
@@ -497,72 +775,72 @@ uint8_t nRF24_setRFoutputPower(uint8_t power){
 		default:
 			rf_setupReg |= RF_PWR(3);
 	}
-	nRF24_writeRegister(RF_SETUP, &rf_setupReg, 1);
 
-	return rf_setupReg;
+	return nRF24_updateRegister(dev, RF_SETUP,rf_setupReg);
 }
 
 /*! Start PLL carrier test.
 * \detail Not implemented yet.
+* \param dev - the module;
 */
-uint8_t nRF24_PLLcarrierTest(void){
-	//not implemented yet
+uint8_t nRF24_PLLcarrierTest(nrf24_dev* dev){
+	(void)dev; //not implemented yet
 	return 0;
 }
 
 /*! Get Packet Loss Counter.
+* \param dev - the module;
 * \return Packet Loss Counter value;
 * \sa nRF24_getPacketRetranCount()
 */
-uint8_t nRF24_getPacketLossCount(void){
+uint8_t nRF24_getPacketLossCount(nrf24_dev* dev){
 	uint8_t observe_txReg;
 
-	nRF24_readRegister(OBSERVE_TX, &observe_txReg, 1);
+	nRF24_readRegister(dev, OBSERVE_TX, &observe_txReg, 1);
 
 	return (observe_txReg>>4);
 }
 
 /*! Get Packet Retransmit Counter.
+* \param dev - the module;
 * \return Packet Retransmit Counter value;
 * \sa nRF24_getPacketLossCount()
 */
-uint8_t nRF24_getPacketRetranCount(void){
+uint8_t nRF24_getPacketRetranCount(nrf24_dev* dev){
 	uint8_t observe_txReg;
 
-	nRF24_readRegister(OBSERVE_TX, &observe_txReg, 1);
+	nRF24_readRegister(dev, OBSERVE_TX, &observe_txReg, 1);
 
 	return (observe_txReg & 0x0F);
 }
 
 /*! Set payload width for specific data pipe.
+* \param dev - the module;
 * \param dataPipe - number of data pipe the payload width will be set (0-5);
 * \param payWidth - amount of bytes in the payload for given data pipe (0-32);
 * \return if payWidth and dataPipe values are in correct value range, the function returns payload width value. Otherwise, the \c '0xFF' is returned;
 * \sa nRF24_getRXpayWidth()
 */
-uint8_t nRF24_setRXpayloadWidth(uint8_t dataPipe, uint8_t payWidth){		
+uint8_t nRF24_setRXpayloadWidth(nrf24_dev* dev, uint8_t dataPipe, uint8_t payWidth){
 	if(dataPipe>5 || payWidth > 32){
 		return 0xFF; //error avoidance
 	}
 
-	nRF24_writeRegister(RX_ADDR_P0 + dataPipe, &payWidth, 1);
-
-	return payWidth;
+	return nRF24_updateRegister(dev, RX_PW_P0 + dataPipe, RX_PW(payWidth));
 }
 
 /*! Dynamic Payload Length settings.
 * \note The module should not be in any transmission mode during Dynamic Payload Length configuration.
 * \warning In order to enable DPL on data pipes, Auto ACK must be enabled for them (EN_AA configuration).
+* \param dev - the module;
 * \param dataPipeVal - pass the combination of DYN_PD mnemonics (DPL_P0-5) which will be enabled/disabled. You may enable/disable DPL on more than one data pipe at a time by summing mnemonics with the '|' operator;
 * \param DPLenable - \c '1': enable DPL on data pipes with \c dataPipeVal, \c '0': disable DPL on data pipes with \c dataPipeVal;
 * \return \c DYN_PD register value;
 * \sa nRF24_enDisDataPipe(),nRF24_enDisAutoACK(),nRF24_enDisDynACK(),nRF24_enDisACKpayload()
 */
-uint8_t nRF24_enDisDynPayLen(uint8_t dataPipeVal, _Bool DPLenable){
-	uint8_t dyn_pdReg,featureReg;
+uint8_t nRF24_enDisDynPayLen(nrf24_dev* dev, uint8_t dataPipeVal, _Bool DPLenable){
+	uint8_t dyn_pdReg=dev->shadow[DYN_PD],featureReg=dev->shadow[FEATURE];
 		
-	nRF24_readRegister(DYN_PD, &dyn_pdReg, 1);
-	nRF24_readRegister(FEATURE, &featureReg, 1);
 	if(DPLenable){
 		dyn_pdReg |= dataPipeVal;
 		featureReg |= EN_DPL;
@@ -572,7 +850,13 @@ uint8_t nRF24_enDisDynPayLen(uint8_t dataPipeVal, _Bool DPLenable){
 			featureReg &= ~EN_DPL;
 		}
 	}
-	nRF24_writeRegister(DYN_PD, &dyn_pdReg, 1);
+	if(DPLenable){
+		nRF24_updateRegister(dev, FEATURE, featureReg); //EN_DPL is set before DYN_PD and cleared after it
+		nRF24_updateRegister(dev, DYN_PD, dyn_pdReg);
+	}else{
+		nRF24_updateRegister(dev, DYN_PD, dyn_pdReg);
+		nRF24_updateRegister(dev, FEATURE, featureReg);
+	}
 
 	return dyn_pdReg;
 }
@@ -580,187 +864,365 @@ uint8_t nRF24_enDisDynPayLen(uint8_t dataPipeVal, _Bool DPLenable){
 /*! ACK Payload settings.
 * \note The module should not be in any transmission mode during ACK Payload configuration.
 * \warning If ACK packet payload is activated, ACK packets have dynamic payload length and Dynamic Payload Length feature should be enabled for data pipe 0 on the PTX and PRX devices (EN_DPL,ENAA_P0,DPL_P0). This is to ensure that they receive ACK packets with payloads. Also set the correct ARD value..
+* \param dev - the module;
 * \param enDis - \c '1': enable ACK Payload, \c '0': disable ACK Payload;
 * \return \c FEATURE register value;
 * \sa nRF24_enDisDataPipe(),nRF24_enDisDynPayLen(),nRF24_enDisDynACK(),nRF24_enDisAutoACK()
 */
-uint8_t nRF24_enDisACKpayload(_Bool enDis){
-	uint8_t featureReg;
+uint8_t nRF24_enDisACKpayload(nrf24_dev* dev, _Bool enDis){
+	uint8_t featureReg=dev->shadow[FEATURE];
 		
-	nRF24_readRegister(FEATURE, &featureReg, 1);
 	if(enDis){
 		featureReg |= EN_ACK_PAY;
 	}else{
 		featureReg &= ~ EN_ACK_PAY;
 	}
-	nRF24_writeRegister(FEATURE, &featureReg, 1);
 
-	return featureReg;
+	return nRF24_updateRegister(dev, FEATURE, featureReg);
 }
 
 /*! Dynamic ACK settings.
 * \note The module should not be in any transmission mode during Dynamic ACK configuration.
+* \param dev - the module;
 * \param enDis - \c '1': enable Dynamic ACK, \c '0': disable Dynamic ACK;
 * \return \c FEATURE register value;
 * \sa nRF24_enDisDataPipe(),nRF24_enDisDynPayLen(),nRF24_enDisAutoACK(),nRF24_enDisACKpayload()
 */
-uint8_t nRF24_enDisDynACK(_Bool enDis){
-	uint8_t featureReg;
+uint8_t nRF24_enDisDynACK(nrf24_dev* dev, _Bool enDis){
+	uint8_t featureReg=dev->shadow[FEATURE];
 		
-	nRF24_readRegister(FEATURE, &featureReg, 1);
 	if(enDis){
 		featureReg |= EN_DYN_ACK;
 	}else{
 		featureReg &= ~ EN_DYN_ACK;
 	}
-	nRF24_writeRegister(FEATURE, &featureReg, 1);
 
-	return featureReg;
+	return nRF24_updateRegister(dev, FEATURE, featureReg);
 }
 
 /*! Set TX Payload Reuse.
 * \note The module should not be in any transmission mode during TX Payload Reuse configuration.
 * \warning TX Payload Reuse may be set only if there was at least one packet successfully transmitted after powering up the module. 
+* \param dev - the module;
 * \param payloadReuse - \c '1': enable TX Payload Reuse, \c '0': disable TX Payload Reuse and flush TX FIFO;
 * \return \c FIFO_STATUS register value;
 * \sa nRF24_flushTX()
 */
-uint8_t nRF24_setTXpayloadReuse(_Bool payloadReuse){
+uint8_t nRF24_setTXpayloadReuse(nrf24_dev* dev, _Bool payloadReuse){
 	uint8_t fifo_statusReg;
 
 	if(payloadReuse){
-		nRF24_sendCommand(REUSE_TX_PL);		
+		nRF24_sendCommand(dev, REUSE_TX_PL);		
 	}else{
-		nRF24_sendCommand(FLUSH_TX);	
+		nRF24_sendCommand(dev, FLUSH_TX);	
 	}
-	nRF24_readRegister(FIFO_STATUS, &fifo_statusReg, 1);
+	nRF24_readRegister(dev, FIFO_STATUS, &fifo_statusReg, 1);
 
 	return fifo_statusReg;
 }
 
 /*! Flush RX FIFO.
+* \param dev - the module;
 * \return \c FIFO_STATUS register value;
 * \sa nRF24_flushTX()
 */
-uint8_t nRF24_flushRX(void){
+uint8_t nRF24_flushRX(nrf24_dev* dev){
 	uint8_t fifo_statusReg;
 
-	nRF24_sendCommand(FLUSH_RX);		
-	nRF24_readRegister(FIFO_STATUS, &fifo_statusReg, 1);
+	nRF24_sendCommand(dev, FLUSH_RX);		
+	nRF24_readRegister(dev, FIFO_STATUS, &fifo_statusReg, 1);
 
 	return fifo_statusReg;
 }
 
 /*! Flush TX FIFO.
+* \param dev - the module;
 * \return \c FIFO_STATUS register value;
 * \sa nRF24_flushRX()
 */
-uint8_t nRF24_flushTX(void){
+uint8_t nRF24_flushTX(nrf24_dev* dev){
 	uint8_t fifo_statusReg;
 
-	nRF24_sendCommand(FLUSH_TX);		
-	nRF24_readRegister(FIFO_STATUS, &fifo_statusReg, 1);
+	nRF24_sendCommand(dev, FLUSH_TX);		
+	nRF24_readRegister(dev, FIFO_STATUS, &fifo_statusReg, 1);
 
 	return fifo_statusReg;
 }
 
 /*! Get payload width for the next RX Payload in RX FIFO.
+* \param dev - the module;
 * \return payload width for the next RX Payload in RX FIFO;
 * \sa nRF24_setRXpayloadWidth()
 */
-uint8_t nRF24_getRXpayWidth(void){		
-	nRF24_sendCommand(R_RX_PL_WID);		
+uint8_t nRF24_getRXpayWidth(nrf24_dev* dev){
+	uint8_t width;
 
-	return spi1_read_byte(NOP);
+	nRF24_transaction(dev, R_RX_PL_WID, 0, &width, 1);
+
+	return width;
 }
 
 /*! Send data to TX FIFO.
 * \note The module should not be in any transmission mode during writing to TX FIFO.
+* \param dev - the module;
 * \param val - a pointer to data array;
 * \param len - amount of bytes to send (0-32). If the \c len value is greater than 32, the function will write only first 32 bytes to TX FIFO;
 * \return \c FIFO_STATUS register value;
 * \sa nRF24_sendDataNOACK(),nRF24_receiveData()
 */
-uint8_t nRF24_sendData(uint8_t* data, uint8_t len){
-	uint8_t fifo_statusReg,i;
+uint8_t nRF24_sendData(nrf24_dev* dev, uint8_t* data, uint8_t len){
+	uint8_t fifo_statusReg;
 
 	do{
-		fifo_statusReg=nRF24_getFIFOstatus();
+		fifo_statusReg=nRF24_getFIFOstatus(dev);
 	}while(fifo_statusReg & TX_FULL_FS);
 
 	if(len>32){
 		len=32;
 	}
-	pin_CSN(LOW);
-	delay_ms(5);
-  spi1_byte_send(W_TX_PAYLOAD,0);
-	delay_us(10);
-	for(i=0; i<len; i++){
-		spi1_byte_send(*(data+i) , 0);
-  }
-	pin_CSN(HIGH);
-	delay_us(10);
+	nRF24_transaction(dev, W_TX_PAYLOAD, data, 0, len);
 	
-	fifo_statusReg=nRF24_getFIFOstatus();
+	fifo_statusReg=nRF24_getFIFOstatus(dev);
 	return fifo_statusReg;
 }
 
 /*! Send data to TX FIFO with NOACK flag set.
 * \note The module should not be in any transmission mode during writing to TX FIFO.
 * \par In order to use this function, the Dynamic ACK must be enabled (FEATURE).
+* \param dev - the module;
 * \param val - a pointer to data array;
 * \param len - amount of bytes to send (0-32). If the \c len value is greater than 32, the function will write only first 32 bytes to TX FIFO;
 * \return \c FIFO_STATUS register value;
 * \sa nRF24_sendData(),nRF24_receiveData(),nRF24_enDisDynACK() 
 */
-uint8_t nRF24_sendDataNOACK(uint8_t* data, uint8_t len){
-	uint8_t fifo_statusReg,i;
+uint8_t nRF24_sendDataNOACK(nrf24_dev* dev, uint8_t* data, uint8_t len){
+	uint8_t fifo_statusReg;
 
 	do{
-		fifo_statusReg=nRF24_getFIFOstatus();
+		fifo_statusReg=nRF24_getFIFOstatus(dev);
 	}while(fifo_statusReg & TX_FULL_FS);
 
 	if(len>32){
 		len=32;
 	}
-	pin_CSN(LOW);
-	delay_ms(5);
-  spi1_byte_send(W_TX_PAYLOAD_NOACK,0);
-	delay_us(10);
-	for(i=0; i<len; i++){
-		spi1_byte_send(*(data+i) , 0);
-	}
-	pin_CSN(HIGH);
-	delay_us(10);
+	nRF24_transaction(dev, W_TX_PAYLOAD_NOACK, data, 0, len);
 
-	fifo_statusReg=nRF24_getFIFOstatus();
+	fifo_statusReg=nRF24_getFIFOstatus(dev);
 	return fifo_statusReg;
 }
 
+/*! Load a payload to be sent with the next ACK packet on the given data pipe.
+* \detail The payload goes out with the ACK of the next packet received on \c dataPipe (PRX only). ACK payloads share the 3-slot TX FIFO; Dynamic Payload Length and ACK Payload must be enabled (FEATURE).
+* \param dev - the module;
+* \param dataPipe - data pipe number (0-5);
+* \param data - a pointer to the payload;
+* \param len - payload length (1-32);
+* \return \c FIFO_STATUS register value or \c 0xFF if the TX FIFO is full;
+* \sa nRF24_enDisACKpayload(),nRF24_enDisDynPayLen()
+*/
+uint8_t nRF24_sendACKpayload(nrf24_dev* dev, uint8_t dataPipe, uint8_t* data, uint8_t len){
+	if(nRF24_getStatus(dev) & TX_FULL){
+		return 0xFF; //error avoidance
+	}
+	if(len>32){
+		len=32;
+	}
+	nRF24_transaction(dev, W_ACK_PAYLOAD | (dataPipe & 0x07), data, 0, len);
+
+	return nRF24_getFIFOstatus(dev);
+}
+
 /*! Receive data from RX FIFO.
 * \note Usage of nRF24_getRXpayWidth() function to specify the \c len value is recommended.
+* \param dev - the module;
 * \param dest - a pointer to the destination array, where the received data will be stored;
 * \param len - amount of bytes to send (0-32). If the \c len value is greater than 32, the function will write only first 32 bytes to TX FIFO;
 * \return if there is less bytes in RX FIFO then the \c len value, the function returns \c '0xFF'. Otherwise, \c FIFO_STATUS register value is returned;
 * \sa nRF24_sendData(),nRF24_sendDataNOACK(),nRF24_getRXpayWidth()
 */
-uint8_t nRF24_receiveData(uint8_t* dest, uint8_t len){
-	uint8_t fifo_statusReg,i;
+uint8_t nRF24_receiveData(nrf24_dev* dev, uint8_t* dest, uint8_t len){
+	uint8_t fifo_statusReg;
+
+	if(nRF24_getFIFOstatus(dev) & RX_EMPTY){
+		return 0xFF; //error avoidance
+	}
+	if(len>32){
+		len=32;
+	}
+	nRF24_transaction(dev, R_RX_PAYLOAD, 0, dest, len);
+
+	fifo_statusReg=nRF24_getFIFOstatus(dev);
+	return fifo_statusReg;
+}
+
+/*! Read the top payload of RX FIFO together with its data pipe number and length.
+* \detail The data pipe is taken from \c RX_P_NO of the \c STATUS register clocked out with the width query, so no separate \c FIFO_STATUS read is needed. The length is read with \c R_RX_PL_WID if Dynamic Payload Length is enabled for the pipe, otherwise it is the \c RX_PW_Px value.
+* \param dev - the module;
+* \param frame - a pointer to the destination frame;
+* \return data pipe number or \c 0xFF if RX FIFO is empty (or a corrupted payload had to be flushed);
+* \sa nRF24_receiveFrames()
+*/
+uint8_t nRF24_receiveFrame(nrf24_dev* dev, nRF24_frame* frame){
+	uint8_t statusReg,pipe,width;
+
+	statusReg=nRF24_transaction(dev, R_RX_PL_WID, 0, &width, 1);
+	pipe=(statusReg & RX_P_NO(7))>>1;
+	if(pipe>5){
+		return 0xFF; //RX FIFO empty
+	}
+	if(!(dev->shadow[FEATURE] & EN_DPL) || !(dev->shadow[DYN_PD] & (1<<pipe))){
+		width=dev->shadow[RX_PW_P0+pipe];
+	}
+	if(width>32){
+		nRF24_sendCommand(dev, FLUSH_RX); //corrupted payload width, the datasheet requires flushing RX FIFO
+		return 0xFF;
+	}
+	nRF24_transaction(dev, R_RX_PAYLOAD, 0, frame->data, width);
+	frame->pipe=pipe;
+	frame->len=width;
+
+	return pipe;
+}
+
+/*! Read every payload from RX FIFO.
+* \detail The RX FIFO (up to 3 payloads) is emptied in one call, so it does not overflow between two \c RX_DR interrupts.
+* \param dev - the module;
+* \param frames - a pointer to the destination frames array;
+* \param max - \c frames array length;
+* \return number of frames read;
+* \sa nRF24_receiveFrame()
+*/
+uint8_t nRF24_receiveFrames(nrf24_dev* dev, nRF24_frame* frames, uint8_t max){
+	uint8_t n=0;
+
+	while(n<max && nRF24_receiveFrame(dev, frames+n)!=0xFF){
+		n++;
+	}
+
+	return n;
+}
+//!@}
 
-	pin_CSN(LOW);
-	delay_ms(5);
-  spi1_byte_send(R_RX_PAYLOAD,0);
-	delay_us(10);
+/*! \name TX STREAM
+*  Back to back transmission of queued payloads.
+*  @{
+*/
+/***********
+* TX STREAM
+***********/
+
+/*! Queue a payload for streamed transmission.
+* \detail The payload is copied to the software TX queue and the hardware TX FIFO is topped up at once. The module stays in TX mode (standby II between payloads, \c CE held high) until both queues are empty, so queued payloads go out back to back without a mode switch per payload. A powered down module is powered up first, with interrupts enabled (see nRF24_powerUp()).
+* \warning Do not change the TX address while nRF24_streamBusy() - the payloads already queued would go to the new address.
+* \param dev - the module;
+* \param data - a pointer to the payload;
+* \param len - payload length (1-32);
+* \param noACK - \c '1' - send with \c W_TX_PAYLOAD_NOACK (Dynamic ACK must be enabled), \c '0' - send with Auto ACK;
+* \return \c '1' - payload queued, \c '0' - queue full or wrong \c len;
+* \sa nRF24_streamService(),nRF24_streamBusy()
+*/
+uint8_t nRF24_streamWrite(nrf24_dev* dev, uint8_t* data, uint8_t len, _Bool noACK){
+	nRF24_txEntry* entry;
+	uint8_t i;
+	uint32_t primask;
+
+	if(len==0 || len>32 || (uint8_t)(dev->txHead-dev->txTail)>=nRF24_TX_QUEUE_LEN){
+		return 0;
+	}
+	entry=&dev->txQueue[dev->txHead & (nRF24_TX_QUEUE_LEN-1)];
 	for(i=0; i<len; i++){
-		*(dest+i)=spi1_read_byte(NOP);
-		if(nRF24_getFIFOstatus() & RX_EMPTY){
-			return 0xFF; //error avoidance
+		entry->data[i]=data[i];
+	}
+	entry->com=noACK ? W_TX_PAYLOAD_NOACK : W_TX_PAYLOAD;
+	entry->len=len;
+	__DMB(); //the entry is filled before it is handed over to the IRQ handler
+	dev->txHead++;
+
+	nRF24_powerUp(dev); //the start-up is not waited for with the interrupts masked
+	primask=__get_PRIMASK(); //the module IRQ handler services the stream as well
+	__disable_irq();
+	nRF24_streamService(dev);
+	__set_PRIMASK(primask);
+
+	return 1;
+}
+
+/*! Top up the hardware TX FIFO from the software TX queue.
+* \detail Call it from the module IRQ handler on \c TX_DS (after clearing the flag). Payloads are loaded while the TX FIFO has a free slot. When both queues are empty the module leaves TX mode: it goes back to RX if it was listening when the stream started, otherwise to standby I.
+* \param dev - the module;
+* \return number of payloads loaded;
+* \sa nRF24_streamWrite()
+*/
+uint8_t nRF24_streamService(nrf24_dev* dev){
+	nRF24_txEntry* entry;
+	uint8_t statusReg,loaded=0;
+
+	if(!dev->streaming){
+		if(dev->txHead==dev->txTail){
+			return 0;
 		}
+		dev->streaming=1;
+		dev->streamResumeRX=(dev->state==STATE_RX);
+	}
+	SPI_TRACE_BEGIN(SPI_TRACE_API_STREAM_SERVICE);
+
+	statusReg=nRF24_getStatus(dev);
+	while(!(statusReg & TX_FULL) && dev->txTail!=dev->txHead){
+		entry=&dev->txQueue[dev->txTail & (nRF24_TX_QUEUE_LEN-1)];
+		nRF24_transaction(dev, entry->com, entry->data, 0, entry->len);
+		dev->txTail++;
+		loaded++;
+		statusReg=nRF24_getStatus(dev);
 	}
-	pin_CSN(HIGH);
-	delay_us(10);
 
-	fifo_statusReg=nRF24_getFIFOstatus();
-	return fifo_statusReg;
+	if(loaded){
+		nRF24_modeTX(dev); //nothing is done if the module already is in TX mode
+	}else if(dev->txTail==dev->txHead && (nRF24_getFIFOstatus(dev) & TX_EMPTY)){
+		dev->streaming=0;
+		if(dev->streamResumeRX){
+			nRF24_modeRX(dev);
+		}else{
+			nRF24_standby(dev);
+		}
+	}
+	SPI_TRACE_END();
+
+	return loaded;
+}
+
+/*! Abort the TX stream.
+* \detail The module leaves TX mode (\c CE low) first, then the TX FIFO and the software TX queue are emptied and the module goes back to RX if it was listening when the stream started, otherwise it stays in standby I. Call it from the module IRQ handler on \c MAX_RT before clearing the flag, so the failed payload is not sent again meanwhile.
+* \param dev - the module;
+* \return number of payloads dropped from the software TX queue;
+* \sa nRF24_streamWrite(),nRF24_streamService()
+*/
+uint8_t nRF24_streamFlush(nrf24_dev* dev){
+	uint8_t dropped;
+	uint32_t primask;
+
+	primask=__get_PRIMASK(); //the module IRQ handler services the stream as well
+	__disable_irq();
+	dropped=(uint8_t)(dev->txHead-dev->txTail);
+	dev->txTail=dev->txHead;
+	if(dev->streaming){
+		nRF24_standby(dev);
+		nRF24_flushTX(dev);
+		dev->streaming=0;
+		if(dev->streamResumeRX){
+			nRF24_modeRX(dev);
+		}
+	}
+	__set_PRIMASK(primask);
+
+	return dropped;
+}
+
+/*! Check if the TX stream is running.
+* \param dev - the module;
+* \return \c '1' - payloads are waiting in the software queue or in the TX FIFO, \c '0' - stream idle;
+* \sa nRF24_streamWrite()
+*/
+_Bool nRF24_streamBusy(nrf24_dev* dev){
+	return dev->streaming || dev->txHead!=dev->txTail;
 }
 //!@}
@@ -10,8 +10,13 @@
 #ifndef nRF24_H
   #define nRF24_H
 
-  #include "MKL46Z4.h"
+  #ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
   #include "SPI.h"
+  #include "spiBus.h"
   #include "nRF24L01P.h"
 	#include "pinManagement.h"
 	#include "delay.h"
@@ -45,31 +50,128 @@
   RX_PW_P3_INIT		RX_PW(1) //default payload for data pipe 3 - 1 byte
   RX_PW_P4_INIT		RX_PW(1) //default payload for data pipe 4 - 1 byte
   RX_PW_P5_INIT		RX_PW(1) //default payload for data pipe 5 - 1 byte
-  DYN_PD_INIT			0 //Dynamic Payload Length disabled for all data pipes
-  FEATURE_INIT		EN_DYN_ACK //enabled W_TX_PAYLOAD_NOACK command; disabled ACK Payload and Dynamic Payload Length
+  DYN_PD_INIT			(DPL_P5 | DPL_P4 | DPL_P3 | DPL_P2 | DPL_P1 | DPL_P0) //Dynamic Payload Length enabled for all data pipes (RX_PW_Px is not used then)
+  FEATURE_INIT		(EN_DPL | EN_ACK_PAY | EN_DYN_ACK) //enabled W_TX_PAYLOAD_NOACK command, ACK Payload and Dynamic Payload Length
   */
   //!@}
 
-	/*! \name GLOBAL VARIABLES
-	*  The global variables and arrays used in different interface functions.
+	/*! \name TIMING
+	*  The \b nRF24L01+ timing limits (\b nRF24L01+ \b Product \b Specification \b v1.0, tables 16 and 22). The driver waits only where the module requires it.
+	*  \note The CSN timings are a few nanoseconds. A \c pin_CSN() call alone takes longer at \c F_CPU_DEF, so no explicit wait is inserted around CSN edges.
 	*  @{
 	*/
-  /******************
-  * GLOBAL VARIABLES 
-  ******************/
-  volatile extern uint8_t TX_PLD[32]; //!< TX Payload buffer (up to 32 bytes). May be used to store data for transmission.
-  volatile extern uint8_t RX_PLD[32]; //!< RX Payload buffer (up to 32 bytes). May be used to store received data.
-  volatile extern uint8_t ACK_PLD[32]; //!< ACK Payload buffer (up to 32 bytes). May be used to store data which would be attached to ACK packet.
+	/********
+	* TIMING
+	********/
+	#define nRF24_T_POR_MS				100		//!< Power on reset; the module ignores SPI access until it elapses
+	#define nRF24_T_PD2STBY_US		1500	//!< Power down to standby mode (Tpd2stby); required only after setting \c PWR_UP
+	#define nRF24_T_STBY2A_US			130		//!< Standby to TX/RX mode (Tstby2a); PLL settle time after CE goes high
+	#define nRF24_T_HCE_US				10		//!< Minimum CE high pulse to start a transmission (Thce)
+	#define nRF24_T_PECE2CSN_US		4			//!< Delay from CE positive edge to CSN low (Tpece2csn)
+	#define nRF24_T_CSN_SETUP_NS	2			//!< CSN to SCK setup (Tcc)
+	#define nRF24_T_CSN_HOLD_NS		2			//!< SCK to CSN hold (Tcch)
+	#define nRF24_T_CSN_HIGH_NS		50		//!< CSN inactive time between transactions (Tcwh)
+	#define nRF24_SPI_HZ					10000000	//!< Highest SCK rate (Fsclk); from the 48 MHz system clock the bus manager sets 8 MHz (divisor 6)
+	//!@}
+
+	/*! \name SHADOW REGISTERS
+	*  The driver keeps a RAM shadow of the module configuration. Setters update the shadow and write a register only when its value changes.
+	*  @{
+	*/
+	/******************
+	* SHADOW REGISTERS
+	******************/
+	/*! Mask of the registers kept in the RAM shadow (bit n - register address n). \c STATUS, \c OBSERVE_TX, \c RPD and \c FIFO_STATUS change on their own and are always read from the module. */
+	#define nRF24_SHADOW_REGS	((1UL<<CONFIG) | (1UL<<EN_AA) | (1UL<<EN_RXADDR) | (1UL<<SETUP_AW) | (1UL<<SETUP_RETR) | (1UL<<RF_CH) | (1UL<<RF_SETUP) | \
+														 (1UL<<RX_PW_P0) | (1UL<<RX_PW_P1) | (1UL<<RX_PW_P2) | (1UL<<RX_PW_P3) | (1UL<<RX_PW_P4) | (1UL<<RX_PW_P5) | \
+														 (1UL<<DYN_PD) | (1UL<<FEATURE))
+	/*! Verify pass after every shadow flush: \c '1' - read the configuration back with nRF24_verifyConfig() and repair it, \c '0' - no verification. */
+	#define nRF24_VERIFY_WRITES	0
+	//!@}
+
+	/*! \name OPERATIONAL MODES
+	*  The module operational modes tracked by the driver.
+	*  @{
+	*/
+	/*******************
+	* OPERATIONAL MODES
+	*******************/
+	/*! Operational mode enumeration.
+	* \detail The module stays powered up between TX and RX; switching between them costs only a \c PRIM_RX write and a \c CE toggle.
+	* \sa nRF24_getState(),nRF24_powerDown(),nRF24_standby(),nRF24_modeRX(),nRF24_modeTX()
+	*/
+	enum nRF24_State{
+		STATE_POWER_DOWN,	//!< \c PWR_UP cleared; registers kept, lowest current
+		STATE_STANDBY_I,	//!< powered up, \c CE low; registers may be written
+		STATE_STANDBY_II,	//!< PTX, \c CE high and TX FIFO empty; the next payload goes out after \c nRF24_T_STBY2A_US
+		STATE_RX,					//!< PRX, \c CE high; listening
+		STATE_TX					//!< PTX, \c CE high; transmitting TX FIFO
+	};
 	
-  volatile extern uint8_t _RX_ADDR_P0[5]; //!< RX Address for data pipe 0 (up to 5 bytes). The address bytes' order is from LSByte (_RX_ADDR_P0[0]) to MSByte (_RX_ADDR_P0[4]).
-  volatile extern uint8_t _RX_ADDR_P1[5]; //!< RX Address for data pipe 1 (up to 5 bytes). The address bytes' order is from LSByte (_RX_ADDR_P1[0]) to MSByte (_RX_ADDR_P1[4]).
-  volatile extern uint8_t _RX_ADDR_P2; //!< The LSByte for data pipe 2 RX Address. First 4 MSBytes are the same as for data pipe 1.
-  volatile extern uint8_t _RX_ADDR_P3; //!< The LSByte for data pipe 3 RX Address. First 4 MSBytes are the same as for data pipe 1.
-  volatile extern uint8_t _RX_ADDR_P4; //!< The LSByte for data pipe 4 RX Address. First 4 MSBytes are the same as for data pipe 1.
-  volatile extern uint8_t _RX_ADDR_P5; //!< The LSByte for data pipe 5 RX Address. First 4 MSBytes are the same as for data pipe 1.
-  volatile extern uint8_t _TX_ADDR[5]; //!< TX Address (up to 5 bytes). The address bytes' order is from LSByte (_TX_ADDR[0]) to MSByte (_TX_ADDR[4]).
-																/*!< \note In order to receive ACK packet, set the same address for data pipe 0 before start of the transmission. */
-	//!@}	
+	/*! Received payload tagged with its data pipe.
+	* \sa nRF24_receiveFrame(),nRF24_receiveFrames()
+	*/
+	typedef struct{
+		uint8_t pipe;				//!< data pipe number (\c RX_P_NO) the payload was received on
+		uint8_t len;				//!< payload length
+		uint8_t data[32];		//!< payload
+	}nRF24_frame;
+	//!@}
+
+	/*! \name MODULE HANDLE
+	*  Everything the driver keeps about one module: its bus device, its pins, the register shadow and the TX stream. Every interface function takes the handle first, so several modules may be driven at once (e.g. a PRX for control and a PTX for telemetry).
+	*  @{
+	*/
+	/***************
+	* MODULE HANDLE
+	***************/
+	#define nRF24_DEFAULT_RX_ADDR_P0	{0xD5,0xD5,0xD5,0xD5,0xD5}	//!< RX Address for data pipe 0 written by nRF24_init(), from LSByte to MSByte
+	#define nRF24_DEFAULT_RX_ADDR_P1	{0xC1,0xC3,0xC3,0xC3,0xC3}	//!< RX Address for data pipe 1 written by nRF24_init(), from LSByte to MSByte
+	#define nRF24_DEFAULT_RX_ADDR_P2	0xC2												//!< LSByte of the data pipe 2 RX Address; first 4 MSBytes are the same as for data pipe 1
+	#define nRF24_DEFAULT_RX_ADDR_P3	0xC3												//!< LSByte of the data pipe 3 RX Address
+	#define nRF24_DEFAULT_RX_ADDR_P4	0xC4												//!< LSByte of the data pipe 4 RX Address
+	#define nRF24_DEFAULT_RX_ADDR_P5	0xC5												//!< LSByte of the data pipe 5 RX Address
+	#define nRF24_DEFAULT_TX_ADDR			{0xD5,0xD5,0xD5,0xD5,0xD5}	//!< TX Address written by nRF24_init(), from LSByte to MSByte
+																															/*!< \note In order to receive ACK packet, set the same address for data pipe 0 before start of the transmission. */
+	#define nRF24_TX_QUEUE_LEN	8	//!< Software TX queue length (power of 2, up to 128)
+
+	/*! Software TX queue entry. */
+	typedef struct{
+		uint8_t com;				//!< \c W_TX_PAYLOAD or \c W_TX_PAYLOAD_NOACK
+		uint8_t len;				//!< payload length
+		uint8_t data[32];		//!< payload
+	}nRF24_txEntry;
+
+	/*! Module handle.
+	* \detail Fill \c bus and \c pins with nRF24_DEV(); the rest is set up by nRF24_init().
+	* \sa nRF24_DEV(),nRF24_init()
+	*/
+	typedef struct{
+		spiBus_device bus;																	//!< the module on the SPI bus manager; the first member, so nRF24_select() gets the handle from it
+		pin_radio pins;																		//!< \c CE, \c CSN and \c IRQ pins
+		enum nRF24_State state;														//!< current operational mode, tracked in RAM
+		uint8_t shadow[FEATURE+1];												//!< RAM shadow of the registers listed in \c nRF24_SHADOW_REGS, indexed by the register address
+		uint8_t addrShadow[TX_ADDR-RX_ADDR_P0+1][5];			//!< RAM shadow of \c RX_ADDR_P0-5 and \c TX_ADDR, indexed by (register address - \c RX_ADDR_P0)
+		uint32_t dirty;																		//!< registers changed in the shadow but not written yet (bit n - register address n)
+		uint8_t batchDepth;																//!< nesting level of nRF24_batchBegin() calls
+		uint32_t readyAt;																	//!< delay_micros() deadline of the oscillator start-up (Tpd2stby) after the last power up
+		nRF24_txEntry txQueue[nRF24_TX_QUEUE_LEN];				//!< software TX queue, filled by nRF24_streamWrite() and emptied by nRF24_streamService()
+		volatile uint8_t txHead;													//!< free running write index of \c txQueue
+		volatile uint8_t txTail;													//!< free running read index of \c txQueue
+		volatile _Bool streaming;													//!< TX stream running (payloads in the software queue or in the TX FIFO)
+		_Bool streamResumeRX;															//!< the module was in RX mode when the stream started
+		uint8_t txPayload[32];														//!< TX payload buffer of the application
+		uint8_t rxPayload[32];														//!< RX payload buffer of the application
+		uint8_t ackPayload[32];														//!< ACK payload buffer of the application
+	}nrf24_dev;
+
+	/*! Static initializer of a module handle.
+	* \detail The module is an SPI mode 0 device of the highest priority, clocked at up to \c nRF24_SPI_HZ; its frames are never split. The fields set up by nRF24_init() start zeroed.
+	* \param radioPins - \c pin_radio initializer (e.g. \c PIN_RADIO_A);
+	*/
+	#define nRF24_DEV(radioPins)	{.bus=SPIBUS_DEVICE(nRF24_select,nRF24_SPI_HZ,0,0,SPIBUS_PRIORITY_HIGH,0),.pins=radioPins}
+	//!@}
+
 	/*! \name LOW-LEVEL INSTRUCTIONS
 	*  Some low-level instructions used by interface functions.
 	*  @{
@@ -78,30 +180,103 @@
   * LOW-LEVEL INSTRUCTIONS
   ************************/
 	
+	/*! Chip select hook of the module on the SPI bus manager - drives its \c CSN pin.
+	* \param device - \c bus member of the module handle;
+	* \param level - \c CSN pin level;
+	* \sa nRF24_DEV()
+	*/
+	void nRF24_select(spiBus_device* device, _Bool level);
+	
+	/*! Execute one SPI transaction: the instruction followed by \c len data bytes in a single CSN frame.
+	* \detail The whole frame is one transaction of the SPI bus manager, queued ahead of the lower priority devices and waited for; it costs one SPI1 FIFO watermark interrupt per 4 bytes (\c SPI1_FIFO_MODE), or a single DMA completion interrupt with \c SPI1_DMA_MODE enabled.
+	* \param dev - the module;
+	* \param com - module instruction value (use instruction mnemonics provided with \c 'nRF24L01P.h' file);
+	* \param tx - a pointer to the data bytes sent after the instruction; if \c '0', NOP bytes are sent;
+	* \param rx - a pointer to the destination array for the bytes clocked in after the instruction; if \c '0', they are dropped;
+	* \param len - amount of data bytes (0-32);
+	* \return \c STATUS register value shifted out together with the instruction;
+	* \sa nRF24_sendCommand(),nRF24_readRegister(),nRF24_writeRegister()
+	*/
+	uint8_t nRF24_transaction(nrf24_dev* dev, const uint8_t com, uint8_t* tx, uint8_t* rx, uint8_t len);
+	
 	/*! Send an instruction to the module.
+	* \param dev - the module;
 	* \param com - module instruction value (use instruction mnemonics provided with \c 'nRF24L01P.h' file);
 	* \return module instruction value passed to the function;
 	* \sa nRF24L01P.h,nRF24_readRegister(),nRF24_writeRegister()
 	*/
-	uint8_t nRF24_sendCommand(const uint8_t com);
+	uint8_t nRF24_sendCommand(nrf24_dev* dev, const uint8_t com);
   
 	/*! Write to the module register.
+	* \param dev - the module;
 	* \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
 	* \param val - an address for first value to write to the module register;
 	* \param len - amount of bytes to write to the module register;
 	* \return last value written to the register from \c val array;
 	* \sa nRF24L01P.h,nRF24_readRegister(),nRF24_sendCommand()
 	*/
-	uint8_t nRF24_writeRegister(const uint8_t reg, uint8_t* val, uint8_t len);
+	uint8_t nRF24_writeRegister(nrf24_dev* dev, const uint8_t reg, uint8_t* val, uint8_t len);
 	
 	/*! Read from the module register.
+	* \param dev - the module;
 	* \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
 	* \param dest - a pointer to first address, where the read data will be written;
 	* \param len - amount of bytes to read from the module register;
 	* \return last value read from the module register;
 	* \sa nRF24L01P.h,nRF24_readRegister(),nRF24_sendCommand()
 	*/
-  uint8_t nRF24_readRegister(const uint8_t reg, uint8_t* val, uint8_t len);
+  uint8_t nRF24_readRegister(nrf24_dev* dev, const uint8_t reg, uint8_t* val, uint8_t len);
+	
+	/*! Update a configuration register through its RAM shadow.
+	* \detail The register is written only if \c val differs from the shadow. Registers not listed in \c nRF24_SHADOW_REGS (e.g. \c STATUS) are always written.
+	* \par Outside a batch the change is committed at once (see nRF24_batchCommit()); inside a batch it is only marked and written by the closing nRF24_batchCommit().
+	* \param dev - the module;
+	* \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
+	* \param val - new register value;
+	* \return new register value;
+	* \sa nRF24_getRegister(),nRF24_verifyConfig(),nRF24_batchBegin()
+	*/
+	uint8_t nRF24_updateRegister(nrf24_dev* dev, const uint8_t reg, uint8_t val);
+	
+	/*! Open a configuration batch.
+	* \detail Until the matching nRF24_batchCommit() every setter only updates the RAM shadow and marks the register as changed. Batches may be nested; only the outermost commit writes to the module.
+	* \par Typical use - hop to another channel and data rate with one commit:
+	* \code
+	* nRF24_batchBegin(&radio);
+	* nRF24_setRFchannel(&radio,76);
+	* nRF24_setRFdataRate(&radio,2);
+	* nRF24_batchCommit(&radio);
+	* \endcode
+	* \param dev - the module;
+	* \sa nRF24_batchCommit()
+	*/
+	void nRF24_batchBegin(nrf24_dev* dev);
+	
+	/*! Close a configuration batch and write every changed register to the module.
+	* \detail If the module is in RX, TX or standby II mode, \c CE is dropped (standby I) for the time of writing and raised again afterwards, so the operational mode is kept. Unchanged registers are skipped. \c FEATURE is written first (it gates \c DYN_PD) and \c CONFIG last.
+	* \param dev - the module;
+	* \return number of registers written to the module;
+	* \sa nRF24_batchBegin()
+	*/
+	uint8_t nRF24_batchCommit(nrf24_dev* dev);
+	
+	/*! Get the configuration register value.
+	* \detail Registers listed in \c nRF24_SHADOW_REGS are returned from the RAM shadow without any SPI traffic. Other registers are read from the module.
+	* \param dev - the module;
+	* \param reg - module register address (use register mnemonics provided with \c 'nRF24L01P.h' file);
+	* \return register value;
+	* \sa nRF24_updateRegister(),nRF24_verifyConfig()
+	*/
+	uint8_t nRF24_getRegister(nrf24_dev* dev, const uint8_t reg);
+	
+	/*! Verify the module configuration against the RAM shadow.
+	* \detail All shadowed registers and addresses are read back from the module and compared with the shadow.
+	* \param dev - the module;
+	* \param repair - \c '1': rewrite every register that does not match the shadow, \c '0': only count them;
+	* \return number of registers that did not match the shadow (\c '0' - configuration verified);
+	* \sa nRF24_updateRegister(),nRF24_getRegister()
+	*/
+	uint8_t nRF24_verifyConfig(nrf24_dev* dev, _Bool repair);
   //!@}
 
 	/*! \name INTERFACE FUNCTIONS
@@ -112,245 +287,380 @@
   * INTERFACE FUNCTIONS
   *********************/
 	/*! Get \c STATUS register value. 
+	* \param dev - the module;
 	* \return \c STATUS register value;
 	* \sa nRF24L01P.h,nRF24_getFIFOstatus()
 	*/
-	uint8_t nRF24_getStatus(void);
+	uint8_t nRF24_getStatus(nrf24_dev* dev);
 
 	/*! Get \c FIFO_STATUS register value. 
+	* \param dev - the module;
 	* \return \c FIFO_STATUS register value;
 	* \sa nRF24L01P.h,nRF24_getStatus()
 	*/
-	uint8_t nRF24_getFIFOstatus(void);
+	uint8_t nRF24_getFIFOstatus(nrf24_dev* dev);
 	
 	/*! Power down the module. 
+	* \detail The \c CE pin is cleared and \c PWR_UP is written only if the module is not powered down already.
+	* \param dev - the module;
+	* \return \c CONFIG register value;
+	* \sa nRF24L01P.h,nRF24_standby(),nRF24_modeRX(),nRF24_modeTX()
+	*/
+	uint8_t nRF24_powerDown(nrf24_dev* dev);
+	
+	/*! Switch to standby I mode.
+	* \detail The \c CE pin is cleared. If the module is powered down, \c PWR_UP is set; the \c nRF24_T_PD2STBY_US oscillator start-up is not waited for here but only by the next nRF24_modeRX()/nRF24_modeTX(), so the time may be used for other work. Otherwise no register is accessed.
+	* \par Standby I is the mode in which the module registers may be written.
+	* \param dev - the module;
 	* \return \c CONFIG register value;
-	* \sa nRF24L01P.h,nRF24_modeRX(),nRF24_modeTX()
+	* \sa nRF24_powerDown(),nRF24_modeRX(),nRF24_modeTX()
 	*/
-	uint8_t nRF24_powerDown(void);
+	uint8_t nRF24_standby(nrf24_dev* dev);
+	
+	/*! Power the module up and wait for the oscillator start-up.
+	* \detail Standby I is entered if the module is powered down; then the \c nRF24_T_PD2STBY_US start-up of the last power up is waited for. Nothing is done if the module is ready. Call it with interrupts enabled before a masked section which may switch the mode (as nRF24_streamWrite() does), so the wait is not made with the delay clock stopped.
+	* \param dev - the module;
+	* \return \c CONFIG register value;
+	* \sa nRF24_standby(),nRF24_powerDown()
+	*/
+	uint8_t nRF24_powerUp(nrf24_dev* dev);
 		
 	/*! Switch to RX mode. 
+	* \detail The module is kept powered up; only \c PRIM_RX (if it differs) and the \c CE pin are changed. Nothing is done if the module already is in RX mode.
+	* \par The module starts listening \c nRF24_T_STBY2A_US after the function returns.
+	* \param dev - the module;
 	* \return \c CONFIG register value;
-	* \sa nRF24L01P.h,nRF24_modeTX(),nRF24_powerDown()
+	* \sa nRF24L01P.h,nRF24_modeTX(),nRF24_standby(),nRF24_powerDown()
 	*/
-	uint8_t nRF24_modeRX(void);
+	uint8_t nRF24_modeRX(nrf24_dev* dev);
 		
 	/*! Switch to TX mode. 
+	* \detail The module is kept powered up; only \c PRIM_RX (if it differs) and the \c CE pin are changed. With \c CE held high the module transmits every payload in TX FIFO and then waits in standby II for the next one, so nothing is done if the module is already in TX or standby II mode.
+	* \param dev - the module;
 	* \return \c CONFIG register value;
-	* \sa nRF24L01P.h,nRF24_modeRX(),nRF24_powerDown()
+	* \sa nRF24L01P.h,nRF24_modeRX(),nRF24_standby(),nRF24_powerDown()
+	*/
+	uint8_t nRF24_modeTX(nrf24_dev* dev);
+	
+	/*! Get the current operational mode of the module.
+	* \detail The mode is tracked in RAM. In TX mode the \c FIFO_STATUS register is read to tell TX from standby II (empty TX FIFO).
+	* \param dev - the module;
+	* \return current \c nRF24_State;
+	* \sa nRF24_State,nRF24_standby(),nRF24_modeRX(),nRF24_modeTX(),nRF24_powerDown()
 	*/
-	uint8_t nRF24_modeTX(void);
+	enum nRF24_State nRF24_getState(nrf24_dev* dev);
 
 	/*! Initialize the module with the default configuration. 
-	* \detail The function updates all module registers with the *DEFAULT CONFIGURATION* registers. You may modify them according to your needs.
+	* \detail The function updates all module registers with the *DEFAULT CONFIGURATION* registers. You may modify them according to your needs. The module is registered with the SPI bus manager (spiBus_init() must be called first).
+	* \param dev - the module;
 	* \return \c STATUS register value;
 	* \sa nRF24L01P.h
 	*/
-	uint8_t nRF24_init(void);
+	uint8_t nRF24_init(nrf24_dev* dev);
 
 	/*! Set TX Address.
 	* \warning The module must be in standby I mode and \c CE pin must be low. Rewriting the TX Address during a transmission is prohibited.
-	* \param txAddr - a pointer to the LSByte of the address. You may use the \c '_TX_ADDR' array to store your address;
+	* \param dev - the module;
+	* \param txAddr - a pointer to the LSByte of the address. \c nRF24_DEFAULT_TX_ADDR is written by nRF24_init();
 	* \return the LSByte of the address;
-	* \sa nRF24_setRXaddr(),_TX_ADDR
+	* \sa nRF24_setRXaddr()
 	*/
-	uint8_t nRF24_setTXaddr(uint8_t* txAddr);
+	uint8_t nRF24_setTXaddr(nrf24_dev* dev, uint8_t* txAddr);
 
 	/*! Set RX Address for specific data pipe.
 	* \warning The module must be in standby I mode and \c CE pin must be low. Rewriting the RX Address during a transmission is prohibited.
+	* \param dev - the module;
 	* \param dataPipe - number of data pipe for which the address will be set. The function knows how many bytes should be written depending on the data pipe number;
-	* \param rxAddr - a pointer to the LSByte of the address. You may use the \c '_RX_ADDR_P0-1' arrays or \c '_RX_ADDR_P2-5' variables to store your address.
+	* \param rxAddr - a pointer to the LSByte of the address. \c nRF24_DEFAULT_RX_ADDR_P0-5 are written by nRF24_init();
 	* \return the LSByte of the address;
-	* \sa nRF24_setTXaddr(),_RX_ADDR
+	* \sa nRF24_setTXaddr()
 	*/
-	uint8_t nRF24_setRXaddr(uint8_t dataPipe, uint8_t* rxAddr);
+	uint8_t nRF24_setRXaddr(nrf24_dev* dev, uint8_t dataPipe, uint8_t* rxAddr);
 	
 	/*! Interrupt settings.
 	* \note The IRQ pin must be connected to the MCU and the module should not be in any transmission mode during IRQ configuration.
 	* \par The interrupt flags in \c STATUS register should be cleared before enabling IRQ's.
+	* \param dev - the module;
 	* \param irqVal - pass the combination of interrupt mnemonics (TX_DS, RX_DR, MAX_RT) which will be enabled/disabled. You may enable/disable more than one IRQ at a time by summing mnemonics with the '|' operator;
 	* \param irqEn - \c '1': enable IRQ's with \c irqVal, \c '0': disable IRQ's with \c irqVal;
 	* \return \c CONFIG register value;
 	* \sa 
 	*/
-	uint8_t nRF24_enDisIRQ(uint8_t irqVal, _Bool irqEn);
+	uint8_t nRF24_enDisIRQ(nrf24_dev* dev, uint8_t irqVal, _Bool irqEn);
 	
 	/*! CRC settings.
 	* \note The module should not be in any transmission mode during CRC configuration.
+	* \param dev - the module;
 	* \param crc - \c '0': no CRC, \c '1': 1 byte CRC, \c default: 2 byte CRC;
 	* \return \c CONFIG register value;
 	* \sa 
 	*/
-	uint8_t nRF24_setCRC(uint8_t crc);
+	uint8_t nRF24_setCRC(nrf24_dev* dev, uint8_t crc);
 
 	/*! Auto ACK settings.
 	* \note The module should not be in any transmission mode during Auto ACK configuration.
+	* \param dev - the module;
 	* \param AAval - pass the combination of EN_AA mnemonics (ENAA_P0-5) which will be enabled/disabled. You may enable/disable Auto ACK on more than one data pipe at a time by summing mnemonics with the '|' operator;
 	* \param AAen - \c '1': enable Auto ACK with \c AAval, \c '0': disable Auto ACK with \c AAval;
 	* \return \c EN_AA register value;
 	* \sa nRF24_enDisDataPipe(),nRF24_enDisDynPayLen(),nRF24_enDisDynACK(),nRF24_enDisACKpayload()
 	*/
-	uint8_t nRF24_enDisAutoACK(uint8_t AAval, _Bool AAen);
+	uint8_t nRF24_enDisAutoACK(nrf24_dev* dev, uint8_t AAval, _Bool AAen);
 		
 	/*! Data pipes settings.
 	* \note The module should not be in any transmission mode during data pipe configuration.
+	* \param dev - the module;
 	* \param dataPipeVal - pass the combination of EN_RXADDR mnemonics (ERX_P0-5) which will be enabled/disabled. You may enable/disable more than one data pipe at a time by summing mnemonics with the '|' operator;
 	* \param dataPipeEn - \c '1': enable data pipes with \c dataPipeVal, \c '0': disable data pipes with \c dataPipeVal;
 	* \return \c EN_RXADDR register value;
 	* \sa nRF24_enDisAutoACK(),nRF24_enDisDynPayLen(),nRF24_enDisDynACK(),nRF24_enDisACKpayload()
 	*/
-	uint8_t nRF24_enDisDataPipe(uint8_t dataPipeVal, _Bool dataPipeEn);
+	uint8_t nRF24_enDisDataPipe(nrf24_dev* dev, uint8_t dataPipeVal, _Bool dataPipeEn);
 
 	/*! Set Address Width for data pipes.
 	* \note The module should not be in any transmission mode during Address Width configuration.
+	* \param dev - the module;
 	* \param addrW - \c '5': 5 bytes, \c '4': 4 bytes, \c '3': 3 bytes, \c default: 5 bytes;
 	* \return \c SETUP_AW register value;
 	* \sa 
 	*/
-	uint8_t nRF24_setAddresWidth(uint8_t addrW);
+	uint8_t nRF24_setAddresWidth(nrf24_dev* dev, uint8_t addrW);
 
 	/*! Set Automatic Retransmission Delay.
 	* \note The module should not be in any transmission mode during Automatic Retransmission Delay configuration.
+	* \param dev - the module;
 	* \param ard - \c '15': 4000 us, \c '14': 3750 us, ... , \c '1': 500 us, \c '0': 250 us, \c default: 4000 us;
 	* \return \c SETUP_RETR register value;
 	* \sa nRF24_setAutoRetranCount()
 	*/
-	uint8_t nRF24_setAutoRetranDelay(uint8_t ard);
+	uint8_t nRF24_setAutoRetranDelay(nrf24_dev* dev, uint8_t ard);
 
 	/*! Set Automatic Retransmission Count.
+	* \param dev - the module;
 	* \param ard - \c '15': up to 15 times, \c '14': up to 14 times, ... , \c '1': up to 1 time, \c '0': no auto retransmissions, \c default: up to 15 times;
 	* \return \c SETUP_RETR register value;
 	* \sa nRF24_setAutoRetranDelay()
 	*/
-	uint8_t nRF24_setAutoRetranCount(uint8_t arc);
+	uint8_t nRF24_setAutoRetranCount(nrf24_dev* dev, uint8_t arc);
 
 	/*! Set RF Channel.
+	* \note The Packet Loss Counter is reset only when \c RF_CH is actually written, i.e. when the channel changes.
+	* \param dev - the module;
 	* \param channel - number of RF Channel on which the module will operate;
 	* \return \c RF_CH register value;
 	* \sa nRF24_setRFdataRate(),nRF24_setRFoutputPower()
 	*/
-	uint8_t nRF24_setRFchannel(uint8_t channel);
+	uint8_t nRF24_setRFchannel(nrf24_dev* dev, uint8_t channel);
 
 	/*! Set RF Data Rate.
+	* \param dev - the module;
 	* \param dataRate - \c '1': 1 Mbps, \c '0': 250 Kbps, \c default: 2 Mbps;
 	* \return \c RF_SETUP register value;
 	* \sa nRF24_setRFchannel(),nRF24_setRFoutputPower()
 	*/
-	uint8_t nRF24_setRFdataRate(uint8_t dataRate);
+	uint8_t nRF24_setRFdataRate(nrf24_dev* dev, uint8_t dataRate);
 
 	/*! Set RF Output Power.
+	* \param dev - the module;
 	* \param power - \c '2': -6 dBm, \c '1': -12 dBm, \c '0': -18 dBm, \c default: 0 dBm;
 	* \return \c RF_SETUP register value;
 	* \sa nRF24_setRFdataRate(),nRF24_setRFchannel()
 	*/
-	uint8_t nRF24_setRFoutputPower(uint8_t power);
+	uint8_t nRF24_setRFoutputPower(nrf24_dev* dev, uint8_t power);
 
 	/*! Start PLL carrier test.
 	* \detail Not implemented yet.
+	* \param dev - the module;
 	*/
-	uint8_t nRF24_PLLcarrierTest(void);
+	uint8_t nRF24_PLLcarrierTest(nrf24_dev* dev);
 
 	/*! Get Packet Loss Counter.
+	* \param dev - the module;
 	* \return Packet Loss Counter value;
 	* \sa nRF24_getPacketRetranCount()
 	*/
-	uint8_t nRF24_getPacketLossCount(void);
+	uint8_t nRF24_getPacketLossCount(nrf24_dev* dev);
 
 	/*! Get Packet Retransmit Counter.
+	* \param dev - the module;
 	* \return Packet Retransmit Counter value;
 	* \sa nRF24_getPacketLossCount()
 	*/
-	uint8_t nRF24_getPacketRetranCount(void);
+	uint8_t nRF24_getPacketRetranCount(nrf24_dev* dev);
 
 	/*! Set payload width for specific data pipe.
+	* \param dev - the module;
 	* \param dataPipe - number of data pipe the payload width will be set (0-5);
 	* \param payWidth - amount of bytes in the payload for given data pipe (0-32);
 	* \return if payWidth and dataPipe values are in correct value range, the function returns payload width value. Otherwise, the \c '0xFF' is returned;
 	* \sa nRF24_getRXpayWidth()
 	*/
-	uint8_t nRF24_setRXpayloadWidth(uint8_t dataPipe, uint8_t payWidth);
+	uint8_t nRF24_setRXpayloadWidth(nrf24_dev* dev, uint8_t dataPipe, uint8_t payWidth);
 	
 	/*! Dynamic Payload Length settings.
 	* \note The module should not be in any transmission mode during Dynamic Payload Length configuration.
 	* \warning In order to enable DPL on data pipes, Auto ACK must be enabled for them (EN_AA configuration).
+	* \param dev - the module;
 	* \param dataPipeVal - pass the combination of DYN_PD mnemonics (DPL_P0-5) which will be enabled/disabled. You may enable/disable DPL on more than one data pipe at a time by summing mnemonics with the '|' operator;
 	* \param DPLenable - \c '1': enable DPL on data pipes with \c dataPipeVal, \c '0': disable DPL on data pipes with \c dataPipeVal;
 	* \return \c DYN_PD register value;
 	* \sa nRF24_enDisDataPipe(),nRF24_enDisAutoACK(),nRF24_enDisDynACK(),nRF24_enDisACKpayload()
 	*/
-	uint8_t nRF24_enDisDynPayLen(uint8_t dataPipeVal, _Bool DPLenable);
+	uint8_t nRF24_enDisDynPayLen(nrf24_dev* dev, uint8_t dataPipeVal, _Bool DPLenable);
 	
 	/*! ACK Payload settings.
 	* \note The module should not be in any transmission mode during ACK Payload configuration.
 	* \warning If ACK packet payload is activated, ACK packets have dynamic payload length and Dynamic Payload Length feature should be enabled for data pipe 0 on the PTX and PRX devices (EN_DPL,ENAA_P0,DPL_P0). This is to ensure that they receive ACK packets with payloads. Also set the correct ARD value..
+	* \param dev - the module;
 	* \param enDis - \c '1': enable ACK Payload, \c '0': disable ACK Payload;
 	* \return \c FEATURE register value;
 	* \sa nRF24_enDisDataPipe(),nRF24_enDisDynPayLen(),nRF24_enDisDynACK(),nRF24_enDisAutoACK()
 	*/
-	uint8_t nRF24_enDisACKpayload(_Bool enDis);
+	uint8_t nRF24_enDisACKpayload(nrf24_dev* dev, _Bool enDis);
 
 	/*! Dynamic ACK settings.
 	* \note The module should not be in any transmission mode during Dynamic ACK configuration.
+	* \param dev - the module;
 	* \param enDis - \c '1': enable Dynamic ACK, \c '0': disable Dynamic ACK;
 	* \return \c FEATURE register value;
 	* \sa nRF24_enDisDataPipe(),nRF24_enDisDynPayLen(),nRF24_enDisAutoACK(),nRF24_enDisACKpayload()
 	*/
-	uint8_t nRF24_enDisDynACK(_Bool enDis);
+	uint8_t nRF24_enDisDynACK(nrf24_dev* dev, _Bool enDis);
 
 	/*! Set TX Payload Reuse.
 	* \note The module should not be in any transmission mode during TX Payload Reuse configuration.
 	* \warning TX Payload Reuse may be set only if there was at least one packet successfully transmitted after powering up the module. 
+	* \param dev - the module;
 	* \param payloadReuse - \c '1': enable TX Payload Reuse, \c '0': disable TX Payload Reuse and flush TX FIFO;
 	* \return \c FIFO_STATUS register value;
 	* \sa nRF24_flushTX()
 	*/
-	uint8_t nRF24_setTXpayloadReuse(_Bool payloadReuse);
+	uint8_t nRF24_setTXpayloadReuse(nrf24_dev* dev, _Bool payloadReuse);
 
 	/*! Flush RX FIFO.
+	* \param dev - the module;
 	* \return \c FIFO_STATUS register value;
 	* \sa nRF24_flushTX()
 	*/
-	uint8_t nRF24_flushRX(void);
+	uint8_t nRF24_flushRX(nrf24_dev* dev);
 
 	/*! Flush TX FIFO.
+	* \param dev - the module;
 	* \return \c FIFO_STATUS register value;
 	* \sa nRF24_flushRX()
 	*/
-	uint8_t nRF24_flushTX(void);
+	uint8_t nRF24_flushTX(nrf24_dev* dev);
 
 	/*! Get payload width for the next RX Payload in RX FIFO.
+	* \param dev - the module;
 	* \return payload width for the next RX Payload in RX FIFO;
 	* \sa nRF24_setRXpayloadWidth()
 	*/
-	uint8_t nRF24_getRXpayWidth(void);
+	uint8_t nRF24_getRXpayWidth(nrf24_dev* dev);
 
 	/*! Send data to TX FIFO.
 	* \note The module should not be in any transmission mode during writing to TX FIFO.
+	* \param dev - the module;
 	* \param val - a pointer to data array;
 	* \param len - amount of bytes to send (0-32). If the \c len value is greater than 32, the function will write only first 32 bytes to TX FIFO;
 	* \return \c FIFO_STATUS register value;
 	* \sa nRF24_sendDataNOACK(),nRF24_receiveData()
 	*/
-	uint8_t nRF24_sendData(uint8_t* data, uint8_t len);
+	uint8_t nRF24_sendData(nrf24_dev* dev, uint8_t* data, uint8_t len);
 
 	/*! Send data to TX FIFO with NOACK flag set.
 	* \note The module should not be in any transmission mode during writing to TX FIFO.
 	* \par In order to use this function, the Dynamic ACK must be enabled (FEATURE).
+	* \param dev - the module;
 	* \param val - a pointer to data array;
 	* \param len - amount of bytes to send (0-32). If the \c len value is greater than 32, the function will write only first 32 bytes to TX FIFO;
 	* \return \c FIFO_STATUS register value;
 	* \sa nRF24_sendData(),nRF24_receiveData(),nRF24_enDisDynACK() 
 	*/
-	uint8_t nRF24_sendDataNOACK(uint8_t* data, uint8_t len);
+	uint8_t nRF24_sendDataNOACK(nrf24_dev* dev, uint8_t* data, uint8_t len);
+
+	/*! Load a payload to be sent with the next ACK packet on the given data pipe.
+	* \detail The payload goes out with the ACK of the next packet received on \c dataPipe (PRX only). ACK payloads share the 3-slot TX FIFO; Dynamic Payload Length and ACK Payload must be enabled (FEATURE).
+	* \param dev - the module;
+	* \param dataPipe - data pipe number (0-5);
+	* \param data - a pointer to the payload;
+	* \param len - payload length (1-32);
+	* \return \c FIFO_STATUS register value or \c 0xFF if the TX FIFO is full;
+	* \sa nRF24_enDisACKpayload(),nRF24_enDisDynPayLen()
+	*/
+	uint8_t nRF24_sendACKpayload(nrf24_dev* dev, uint8_t dataPipe, uint8_t* data, uint8_t len);
 
 	/*! Receive data from RX FIFO.
 	* \note Usage of nRF24_getRXpayWidth() function to specify the \c len value is recommended.
+	* \param dev - the module;
 	* \param dest - a pointer to the destination array, where the received data will be stored;
 	* \param len - amount of bytes to send (0-32). If the \c len value is greater than 32, the function will write only first 32 bytes to TX FIFO;
 	* \return if there is less bytes in RX FIFO then the \c len value, the function returns \c '0xFF'. Otherwise, \c FIFO_STATUS register value is returned;
 	* \sa nRF24_sendData(),nRF24_sendDataNOACK(),nRF24_getRXpayWidth()
 	*/
-	uint8_t nRF24_receiveData(uint8_t* dest, uint8_t len);
+	uint8_t nRF24_receiveData(nrf24_dev* dev, uint8_t* dest, uint8_t len);
+
+	/*! Read the top payload of RX FIFO together with its data pipe number and length.
+	* \detail The data pipe is taken from \c RX_P_NO of the \c STATUS register clocked out with the width query, so no separate \c FIFO_STATUS read is needed. The length is read with \c R_RX_PL_WID if Dynamic Payload Length is enabled for the pipe, otherwise it is the \c RX_PW_Px value.
+	* \param dev - the module;
+	* \param frame - a pointer to the destination frame;
+	* \return data pipe number or \c 0xFF if RX FIFO is empty (or a corrupted payload had to be flushed);
+	* \sa nRF24_receiveFrames()
+	*/
+	uint8_t nRF24_receiveFrame(nrf24_dev* dev, nRF24_frame* frame);
+
+	/*! Read every payload from RX FIFO.
+	* \detail The RX FIFO (up to 3 payloads) is emptied in one call, so it does not overflow between two \c RX_DR interrupts.
+	* \param dev - the module;
+	* \param frames - a pointer to the destination frames array;
+	* \param max - \c frames array length;
+	* \return number of frames read;
+	* \sa nRF24_receiveFrame()
+	*/
+	uint8_t nRF24_receiveFrames(nrf24_dev* dev, nRF24_frame* frames, uint8_t max);
+	//!@}
+
+	/*! \name TX STREAM
+	*  Back to back transmission of queued payloads.
+	*  @{
+	*/
+	/***********
+	* TX STREAM
+	***********/
+	/*! Queue a payload for streamed transmission.
+	* \detail The payload is copied to the software TX queue and the hardware TX FIFO is topped up at once. The module stays in TX mode (standby II between payloads, \c CE held high) until both queues are empty, so queued payloads go out back to back without a mode switch per payload. A powered down module is powered up first, with interrupts enabled (see nRF24_powerUp()).
+	* \warning Do not change the TX address while nRF24_streamBusy() - the payloads already queued would go to the new address.
+	* \param dev - the module;
+	* \param data - a pointer to the payload;
+	* \param len - payload length (1-32);
+	* \param noACK - \c '1' - send with \c W_TX_PAYLOAD_NOACK (Dynamic ACK must be enabled), \c '0' - send with Auto ACK;
+	* \return \c '1' - payload queued, \c '0' - queue full or wrong \c len;
+	* \sa nRF24_streamService(),nRF24_streamBusy()
+	*/
+	uint8_t nRF24_streamWrite(nrf24_dev* dev, uint8_t* data, uint8_t len, _Bool noACK);
+
+	/*! Top up the hardware TX FIFO from the software TX queue.
+	* \detail Call it from the module IRQ handler on \c TX_DS (after clearing the flag). Payloads are loaded while the TX FIFO has a free slot. When both queues are empty the module leaves TX mode: it goes back to RX if it was listening when the stream started, otherwise to standby I.
+	* \param dev - the module;
+	* \return number of payloads loaded;
+	* \sa nRF24_streamWrite()
+	*/
+	uint8_t nRF24_streamService(nrf24_dev* dev);
+
+	/*! Abort the TX stream.
+	* \detail The module leaves TX mode (\c CE low) first, then the TX FIFO and the software TX queue are emptied and the module goes back to RX if it was listening when the stream started, otherwise it stays in standby I. Call it from the module IRQ handler on \c MAX_RT before clearing the flag, so the failed payload is not sent again meanwhile.
+	* \param dev - the module;
+	* \return number of payloads dropped from the software TX queue;
+	* \sa nRF24_streamWrite(),nRF24_streamService()
+	*/
+	uint8_t nRF24_streamFlush(nrf24_dev* dev);
+
+	/*! Check if the TX stream is running.
+	* \param dev - the module;
+	* \return \c '1' - payloads are waiting in the software queue or in the TX FIFO, \c '0' - stream idle;
+	* \sa nRF24_streamWrite()
+	*/
+	_Bool nRF24_streamBusy(nrf24_dev* dev);
 	//!@}
 
 #endif
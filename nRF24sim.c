@@ -0,0 +1,961 @@
+/*! \brief The source file with the host-side nRF24L01+ behavioural simulator.
+*	\file nRF24sim.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the software model of the nRF24L01+ module, the SPI1 peripheral model and the host versions of the pin, delay and display functions the driver is built on. It is compiled only in the host build (\b NRF24_SIM defined).
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifdef NRF24_SIM
+
+#include <string.h>
+#include "nRF24sim.h"
+#include "nRF24L01P.h"
+#include "SPI.h"
+#include "pinManagement.h"
+#include "delay.h"
+#include "slcd.h"
+
+#define NRF24SIM_NEVER				UINT64_MAX	//!< Event time of a module with nothing scheduled.
+#define NRF24SIM_NS(us)				((uint64_t)(us)*1000)	//!< Microseconds to the simulation clock unit.
+#define NRF24SIM_FIFO_LEN			3						//!< Depth of the TX and RX FIFOs.
+#define NRF24SIM_REG_NR				0x1E				//!< Size of the register map (\c CONFIG to \c FEATURE).
+#define NRF24SIM_T_PD2STBY_US	1500				//!< Crystal start-up after \c PWR_UP.
+#define NRF24SIM_NO_PIPE			0xFF				//!< Pipe tag of TX FIFO entries that are not ACK payloads.
+#define NRF24SIM_SPI_FIFO_LEN	4						//!< Depth of the SPI1 RX FIFO (8 bit mode: one byte per entry).
+
+/*! A FIFO entry - payload with its tags. */
+typedef struct{
+	uint8_t pipe;			//!< data pipe (RX FIFO and ACK payloads)
+	uint8_t len;			//!< payload length
+	_Bool noACK;			//!< written with \c W_TX_PAYLOAD_NOACK
+	_Bool sent;				//!< already on air at least once (the PID is fixed)
+	uint8_t pid;			//!< packet identity of Enhanced ShockBurst
+	uint8_t data[32];	//!< payload
+}nRF24sim_payload;
+
+/*! State of the transmitter of a module. */
+typedef enum{
+	NRF24SIM_TX_IDLE,		//!< nothing to send
+	NRF24SIM_TX_SETTLE,	//!< PLL settling, the packet goes on air at \c eventAt
+	NRF24SIM_TX_AIR,		//!< packet on air until \c eventAt
+	NRF24SIM_TX_WAIT		//!< waiting for the ACK (or the retransmit delay) until \c eventAt
+}nRF24sim_txState;
+
+/*! A simulated module. */
+typedef struct{
+	uint8_t reg[NRF24SIM_REG_NR];				//!< register map (single byte registers)
+	uint8_t addr[3][5];									//!< \c RX_ADDR_P0, \c RX_ADDR_P1, \c TX_ADDR
+	nRF24sim_payload rx[NRF24SIM_FIFO_LEN];
+	uint8_t rxCount;
+	nRF24sim_payload tx[NRF24SIM_FIFO_LEN];
+	uint8_t txCount;
+	_Bool ce;
+	_Bool csn;
+	_Bool rxMode;												//!< \c PWR_UP, \c PRIM_RX and \c CE all set
+	uint64_t readyAt;										//!< end of the crystal start-up
+	uint64_t listenAt;									//!< end of the RX settling
+	nRF24sim_txState txState;
+	uint64_t eventAt;										//!< time of the next transmitter event
+	uint8_t pid;
+	uint8_t arc;												//!< retransmissions of the current packet
+	_Bool acked;												//!< the current packet gets its ACK at the end of \c NRF24SIM_TX_WAIT
+	_Bool ackWithPayload;
+	nRF24sim_payload ack;								//!< ACK payload of the current packet
+	uint8_t lastPid[6];									//!< duplicate detection per pipe
+	uint32_t lastSum[6];
+	_Bool irqLine;											//!< IRQ pin active (low)
+	_Bool irqPending;										//!< falling edge not handled yet
+	void (*irqHandler)(void);
+	uint8_t cmd;												//!< instruction of the current SPI transaction
+	uint8_t pos;												//!< bytes exchanged in the current SPI transaction
+	uint8_t out[32];										//!< data shifted out after \c STATUS
+	uint8_t in[32];											//!< data shifted in after the instruction
+	nRF24sim_stats stats;
+}nRF24sim_node;
+
+static nRF24sim_node nRF24sim_nodes[NRF24SIM_NODES_MAX];
+static uint8_t nRF24sim_nodeCount;
+static uint64_t nRF24sim_now;								//!< simulation clock in nanoseconds
+static uint32_t nRF24sim_primask;
+static _Bool nRF24sim_inIrq;
+static uint16_t nRF24sim_loss;
+static uint16_t nRF24sim_noise[128];
+static uint32_t nRF24sim_random=1;
+static uint16_t nRF24sim_lcdValue;
+nRF24sim_spiRegs nRF24sim_spi1Regs;
+static uint8_t nRF24sim_spiRx[NRF24SIM_SPI_FIFO_LEN];	//!< SPI1 RX FIFO
+static uint8_t nRF24sim_spiRxCount;
+static _Bool nRF24sim_spiInIrq;
+static nRF24sim_spiStats nRF24sim_spiStat;
+
+/*** INTERNAL ***/
+static void nRF24sim_runTo(uint64_t t);
+static void nRF24sim_spiIrq(void);
+
+/*! Get the next pseudo random number (xorshift).
+*/
+static uint32_t nRF24sim_rand(void){
+	nRF24sim_random^=nRF24sim_random<<13;
+	nRF24sim_random^=nRF24sim_random>>17;
+	nRF24sim_random^=nRF24sim_random<<5;
+	return nRF24sim_random;
+}
+
+/*! Draw the fate of a packet on a channel.
+* \return \c '1' - the packet is lost;
+*/
+static _Bool nRF24sim_lost(uint8_t channel){
+	uint32_t permille=nRF24sim_loss+nRF24sim_noise[channel&0x7F];
+
+	if(permille==0){
+		return 0;
+	}
+	return nRF24sim_rand()%1000<permille;
+}
+
+static uint8_t nRF24sim_addrWidth(const nRF24sim_node* n){
+	return (n->reg[SETUP_AW]&0x03)+2;
+}
+
+static uint32_t nRF24sim_bitrate(const nRF24sim_node* n){
+	if(n->reg[RF_SETUP] & RF_DR_LOW){
+		return 250000;
+	}
+	return (n->reg[RF_SETUP] & RF_DR_HIGH) ? 2000000 : 1000000;
+}
+
+/*! Get the time on air of a packet.
+* \detail Preamble, address, 9 bit packet control field, payload and CRC.
+*/
+static uint64_t nRF24sim_airtime(const nRF24sim_node* n, uint8_t len){
+	uint32_t bps=nRF24sim_bitrate(n);
+	uint32_t bytes=(bps==2000000 ? 2 : 1)+nRF24sim_addrWidth(n)+len;
+
+	if((n->reg[CONFIG] & EN_CRC) || n->reg[EN_AA]){ //CRC is forced by Enhanced ShockBurst
+		bytes+=(n->reg[CONFIG] & CRC0) ? 2 : 1;
+	}
+	return (uint64_t)(bytes*8+9)*1000000000ULL/bps;
+}
+
+static void nRF24sim_pipeAddr(const nRF24sim_node* n, uint8_t pipe, uint8_t* addr){
+	memcpy(addr,n->addr[pipe==0 ? 0 : 1],5);
+	if(pipe>1){
+		addr[0]=n->reg[RX_ADDR_P0+pipe];
+	}
+}
+
+static _Bool nRF24sim_dynamic(const nRF24sim_node* n, uint8_t pipe){
+	return (n->reg[FEATURE] & EN_DPL) && (n->reg[DYN_PD] & (1<<pipe));
+}
+
+static uint32_t nRF24sim_sum(const nRF24sim_payload* p){
+	uint32_t sum=2166136261u;
+	uint8_t i;
+
+	sum=(sum^p->len)*16777619u;
+	for(i=0;i<p->len;i++){
+		sum=(sum^p->data[i])*16777619u;
+	}
+	return sum;
+}
+
+static uint8_t nRF24sim_status(const nRF24sim_node* n){
+	return (n->reg[STATUS] & (RX_DR | TX_DS | MAX_RT)) | RX_P_NO(n->rxCount ? n->rx[0].pipe : 7) | (n->txCount==NRF24SIM_FIFO_LEN ? TX_FULL : 0);
+}
+
+/*! Follow the IRQ pin; a falling edge makes the handler pending.
+*/
+static void nRF24sim_irqUpdate(nRF24sim_node* n){
+	_Bool line=(n->reg[STATUS] & ~n->reg[CONFIG] & (RX_DR | TX_DS | MAX_RT))!=0;
+
+	if(line && !n->irqLine){
+		n->irqPending=1;
+	}
+	n->irqLine=line;
+}
+
+/*! Get the module whose \c CSN is low.
+* \return the module or \c 0 - no transaction is open;
+*/
+static nRF24sim_node* nRF24sim_framed(void){
+	uint8_t i;
+
+	for(i=0;i<nRF24sim_nodeCount;i++){
+		if(!nRF24sim_nodes[i].csn){
+			return nRF24sim_nodes+i;
+		}
+	}
+
+	return 0;
+}
+
+/*! Call the pending IRQ handlers if an interrupt could be taken now.
+*/
+static void nRF24sim_deliver(void){
+	uint8_t i;
+
+	if(nRF24sim_primask || nRF24sim_inIrq || nRF24sim_framed()){
+		return;
+	}
+	for(i=0;i<nRF24sim_nodeCount;i++){
+		if(nRF24sim_nodes[i].irqPending){
+			nRF24sim_nodes[i].irqPending=0;
+			if(nRF24sim_nodes[i].irqHandler){
+				nRF24sim_inIrq=1;
+				nRF24sim_nodes[i].irqHandler();
+				nRF24sim_inIrq=0;
+				i=0xFF; //the handler may have raised other edges, start over
+			}
+		}
+	}
+}
+
+static void nRF24sim_pop(nRF24sim_payload* fifo, uint8_t* count, uint8_t index){
+	(*count)--;
+	memmove(fifo+index,fifo+index+1,(*count-index)*sizeof(nRF24sim_payload));
+}
+
+static void nRF24sim_onAir(nRF24sim_node* n){
+	n->stats.airPackets++;
+	n->txState=NRF24SIM_TX_AIR;
+	n->eventAt=nRF24sim_now+nRF24sim_airtime(n,n->tx[0].len);
+}
+
+/*! Schedule the next packet if the module stays in TX mode.
+*/
+static void nRF24sim_txNext(nRF24sim_node* n){
+	if(n->ce && n->txCount && !(n->reg[STATUS] & MAX_RT) && (n->reg[CONFIG] & PWR_UP) && !(n->reg[CONFIG] & PRIM_RX)){
+		n->txState=NRF24SIM_TX_SETTLE;
+		n->eventAt=(nRF24sim_now>n->readyAt ? nRF24sim_now : n->readyAt)+NRF24SIM_NS(NRF24SIM_T_SETTLE_US);
+	}else{
+		n->txState=NRF24SIM_TX_IDLE;
+		n->eventAt=NRF24SIM_NEVER;
+	}
+}
+
+/*! Follow a change of \c CONFIG, \c CE or the TX FIFO.
+*/
+static void nRF24sim_modeUpdate(nRF24sim_node* n){
+	_Bool rxMode=(n->reg[CONFIG] & PWR_UP) && (n->reg[CONFIG] & PRIM_RX) && n->ce;
+
+	if(rxMode && !n->rxMode){
+		n->listenAt=(nRF24sim_now>n->readyAt ? nRF24sim_now : n->readyAt)+NRF24SIM_NS(NRF24SIM_T_SETTLE_US);
+	}
+	n->rxMode=rxMode;
+	if(!(n->reg[CONFIG] & PWR_UP)){
+		n->txState=NRF24SIM_TX_IDLE;
+		n->eventAt=NRF24SIM_NEVER;
+	}else if(n->txState==NRF24SIM_TX_IDLE){
+		nRF24sim_txNext(n);
+	}
+}
+
+/*! Find the module and pipe a packet of \c ptx is addressed to.
+* \return module or \c 0 if nobody listens;
+*/
+static nRF24sim_node* nRF24sim_receiver(nRF24sim_node* ptx, uint8_t* pipe){
+	uint8_t i,p,aw=nRF24sim_addrWidth(ptx),addr[5];
+	_Bool dynamic=nRF24sim_dynamic(ptx,0);
+	nRF24sim_node* n;
+
+	for(i=0;i<nRF24sim_nodeCount;i++){
+		n=nRF24sim_nodes+i;
+		if(n==ptx || !n->rxMode || nRF24sim_now<n->listenAt || n->reg[RF_CH]!=ptx->reg[RF_CH] || nRF24sim_bitrate(n)!=nRF24sim_bitrate(ptx) || nRF24sim_addrWidth(n)!=aw){
+			continue;
+		}
+		for(p=0;p<6;p++){
+			if(!(n->reg[EN_RXADDR] & (1<<p))){
+				continue;
+			}
+			nRF24sim_pipeAddr(n,p,addr);
+			if(memcmp(addr,ptx->addr[2],aw)){
+				continue;
+			}
+			if(nRF24sim_dynamic(n,p) ? !dynamic : (dynamic || ptx->tx[0].len!=n->reg[RX_PW_P0+p])){
+				continue; //payload length field mismatch, CRC fails
+			}
+			*pipe=p;
+			return n;
+		}
+	}
+	return 0;
+}
+
+/*! The packet of \c ptx has left the antenna: deliver it and decide about the ACK.
+*/
+static void nRF24sim_txEnd(nRF24sim_node* ptx){
+	nRF24sim_payload* packet=ptx->tx;
+	_Bool expectACK=!packet->noACK && (ptx->reg[EN_AA] & 0x01);
+	uint64_t ackTime=0;
+	uint8_t pipe,i;
+	uint32_t sum;
+	nRF24sim_node* prx=nRF24sim_receiver(ptx,&pipe);
+
+	ptx->acked=0;
+	ptx->ackWithPayload=0;
+	if(prx && !nRF24sim_lost(ptx->reg[RF_CH])){
+		sum=nRF24sim_sum(packet);
+		if(prx->lastPid[pipe]==packet->pid && prx->lastSum[pipe]==sum){
+			prx->stats.duplicates++; //ACK lost before, acknowledge again
+		}else if(prx->rxCount==NRF24SIM_FIFO_LEN){
+			prx->stats.rxOverflows++;
+			prx=0; //no ACK, the PTX retransmits
+		}else{
+			prx->rx[prx->rxCount]=*packet;
+			prx->rx[prx->rxCount].pipe=pipe;
+			prx->rxCount++;
+			prx->lastPid[pipe]=packet->pid;
+			prx->lastSum[pipe]=sum;
+			prx->reg[STATUS]|=RX_DR;
+			prx->stats.received++;
+			nRF24sim_irqUpdate(prx);
+		}
+		if(prx && expectACK && (prx->reg[EN_AA] & (1<<pipe))){
+			if((prx->reg[FEATURE] & EN_ACK_PAY) && nRF24sim_dynamic(prx,pipe)){
+				for(i=0;i<prx->txCount;i++){
+					if(prx->tx[i].pipe==pipe){
+						ptx->ack=prx->tx[i];
+						ptx->ack.pipe=0;
+						ptx->ackWithPayload=1;
+						nRF24sim_pop(prx->tx,&prx->txCount,i);
+						prx->reg[STATUS]|=TX_DS;
+						prx->stats.ackPayloads++;
+						nRF24sim_irqUpdate(prx);
+						break;
+					}
+				}
+			}
+			ackTime=NRF24SIM_NS(NRF24SIM_T_SETTLE_US)+nRF24sim_airtime(prx,ptx->ackWithPayload ? ptx->ack.len : 0);
+			ptx->acked=!nRF24sim_lost(ptx->reg[RF_CH]);
+		}
+	}
+	if(!expectACK){
+		nRF24sim_pop(ptx->tx,&ptx->txCount,0);
+		ptx->reg[STATUS]|=TX_DS;
+		ptx->stats.delivered++;
+		nRF24sim_irqUpdate(ptx);
+		nRF24sim_txNext(ptx);
+		return;
+	}
+	ptx->txState=NRF24SIM_TX_WAIT;
+	ptx->eventAt=nRF24sim_now+(ptx->acked ? ackTime : NRF24SIM_NS(((ptx->reg[SETUP_RETR]>>4)+1)*250));
+}
+
+/*! The ACK has come or the retransmit delay is over.
+*/
+static void nRF24sim_txWaitEnd(nRF24sim_node* ptx){
+	if(ptx->acked){
+		nRF24sim_pop(ptx->tx,&ptx->txCount,0);
+		ptx->reg[STATUS]|=TX_DS;
+		ptx->stats.delivered++;
+		if(ptx->ackWithPayload){
+			if(ptx->rxCount<NRF24SIM_FIFO_LEN){
+				ptx->rx[ptx->rxCount++]=ptx->ack;
+				ptx->reg[STATUS]|=RX_DR;
+				ptx->stats.ackPayloads++;
+			}else{
+				ptx->stats.rxOverflows++;
+			}
+		}
+		nRF24sim_irqUpdate(ptx);
+		nRF24sim_txNext(ptx);
+	}else if(ptx->arc<(ptx->reg[SETUP_RETR] & 0x0F)){
+		ptx->arc++;
+		ptx->reg[OBSERVE_TX]=(ptx->reg[OBSERVE_TX] & 0xF0) | ARC_CNT(ptx->arc);
+		ptx->stats.retransmits++;
+		nRF24sim_onAir(ptx);
+	}else{
+		if((ptx->reg[OBSERVE_TX]>>4)<15){
+			ptx->reg[OBSERVE_TX]+=PLOS_CNT(1);
+		}
+		ptx->reg[STATUS]|=MAX_RT; //the payload stays in TX FIFO
+		ptx->stats.lost++;
+		ptx->txState=NRF24SIM_TX_IDLE;
+		ptx->eventAt=NRF24SIM_NEVER;
+		nRF24sim_irqUpdate(ptx);
+	}
+}
+
+static void nRF24sim_event(nRF24sim_node* n){
+	switch(n->txState){
+		case NRF24SIM_TX_SETTLE:
+			if(!n->txCount || (n->reg[STATUS] & MAX_RT) || !(n->reg[CONFIG] & PWR_UP) || (n->reg[CONFIG] & PRIM_RX)){
+				n->txState=NRF24SIM_TX_IDLE;
+				n->eventAt=NRF24SIM_NEVER;
+				break;
+			}
+			if(!n->tx[0].sent){
+				n->tx[0].sent=1;
+				n->tx[0].pid=++n->pid & 0x03;
+				n->arc=0;
+				n->reg[OBSERVE_TX]&=0xF0;
+			}
+			nRF24sim_onAir(n);
+			break;
+		case NRF24SIM_TX_AIR:
+			nRF24sim_txEnd(n);
+			break;
+		case NRF24SIM_TX_WAIT:
+			nRF24sim_txWaitEnd(n);
+			break;
+		default:
+			n->eventAt=NRF24SIM_NEVER;
+			break;
+	}
+}
+
+/*! Run the radio events up to \c t and move the clock there.
+*/
+static void nRF24sim_runTo(uint64_t t){
+	uint8_t i,next;
+	uint64_t at;
+
+	for(;;){
+		next=0xFF;
+		at=t;
+		for(i=0;i<nRF24sim_nodeCount;i++){
+			if(nRF24sim_nodes[i].eventAt<at || (next==0xFF && nRF24sim_nodes[i].eventAt==at)){
+				at=nRF24sim_nodes[i].eventAt;
+				next=i;
+			}
+		}
+		if(next==0xFF){
+			break;
+		}
+		if(at>nRF24sim_now){
+			nRF24sim_now=at;
+		}
+		nRF24sim_event(nRF24sim_nodes+next);
+		nRF24sim_deliver();
+	}
+	if(t>nRF24sim_now){
+		nRF24sim_now=t;
+	}
+	nRF24sim_deliver();
+}
+
+/*! Fill the data shifted out after \c STATUS for the instruction just received.
+*/
+static void nRF24sim_prepare(nRF24sim_node* n){
+	uint8_t reg=n->cmd & 0x1F,i;
+	_Bool busy=0;
+
+	memset(n->out,0,sizeof(n->out));
+	if(n->cmd<=(R_REGISTER | 0x1F)){
+		if(reg==RX_ADDR_P0 || reg==RX_ADDR_P1 || reg==TX_ADDR){
+			memcpy(n->out,n->addr[reg==TX_ADDR ? 2 : reg-RX_ADDR_P0],5);
+		}else if(reg==STATUS){
+			n->out[0]=nRF24sim_status(n);
+		}else if(reg==FIFO_STATUS){
+			n->out[0]=(n->txCount==NRF24SIM_FIFO_LEN ? TX_FULL_FS : 0) | (n->txCount ? 0 : TX_EMPTY) | (n->rxCount==NRF24SIM_FIFO_LEN ? RX_FULL : 0) | (n->rxCount ? 0 : RX_EMPTY);
+		}else if(reg==RPD){
+			for(i=0;i<nRF24sim_nodeCount;i++){
+				if(nRF24sim_nodes[i].txState==NRF24SIM_TX_AIR && nRF24sim_nodes[i].reg[RF_CH]==n->reg[RF_CH]){
+					busy=1;
+				}
+			}
+			n->out[0]=(n->rxMode && (busy || nRF24sim_noise[n->reg[RF_CH]]>=NRF24SIM_RPD_PERMILLE)) ? RPD_MASK : 0;
+		}else if(reg<NRF24SIM_REG_NR){
+			n->out[0]=n->reg[reg];
+		}
+	}else if(n->cmd==R_RX_PAYLOAD && n->rxCount){
+		memcpy(n->out,n->rx[0].data,n->rx[0].len);
+	}else if(n->cmd==R_RX_PL_WID){
+		n->out[0]=n->rxCount ? n->rx[0].len : 0;
+	}
+}
+
+static void nRF24sim_writeRegister(nRF24sim_node* n, uint8_t reg, uint8_t len){
+	uint8_t old=n->reg[reg];
+
+	if(reg!=STATUS && n->ce && (n->reg[CONFIG] & PWR_UP)){
+		n->stats.illegalWrites++;
+	}
+	if(reg==RX_ADDR_P0 || reg==RX_ADDR_P1 || reg==TX_ADDR){
+		memcpy(n->addr[reg==TX_ADDR ? 2 : reg-RX_ADDR_P0],n->in,len>5 ? 5 : len);
+		return;
+	}
+	switch(reg){
+		case STATUS:
+			n->reg[STATUS]&=~(n->in[0] & (RX_DR | TX_DS | MAX_RT));
+			break;
+		case OBSERVE_TX:
+		case RPD:
+		case FIFO_STATUS:
+			break; //read only
+		case RF_CH:
+			n->reg[RF_CH]=n->in[0] & 0x7F;
+			n->reg[OBSERVE_TX]&=0x0F; //PLOS_CNT is reset by writing RF_CH
+			break;
+		case CONFIG:
+			n->reg[CONFIG]=n->in[0];
+			if(!(old & PWR_UP) && (n->in[0] & PWR_UP)){
+				n->readyAt=nRF24sim_now+NRF24SIM_NS(NRF24SIM_T_PD2STBY_US);
+			}
+			break;
+		default:
+			if(reg<NRF24SIM_REG_NR){
+				n->reg[reg]=n->in[0];
+			}
+			break;
+	}
+	nRF24sim_irqUpdate(n);
+}
+
+/*! Execute the instruction of the SPI transaction closed by \c CSN.
+*/
+static void nRF24sim_commit(nRF24sim_node* n){
+	uint8_t len=n->pos-1;
+	nRF24sim_payload* p;
+
+	if(len>32){
+		len=32;
+	}
+	if((n->cmd & 0xE0)==W_REGISTER){
+		if(len){
+			nRF24sim_writeRegister(n,n->cmd & 0x1F,len);
+		}
+	}else if(n->cmd==R_RX_PAYLOAD){
+		if(len && n->rxCount){
+			nRF24sim_pop(n->rx,&n->rxCount,0);
+		}
+	}else if(n->cmd==W_TX_PAYLOAD || n->cmd==W_TX_PAYLOAD_NOACK || (n->cmd & 0xF8)==W_ACK_PAYLOAD){
+		if(!len || n->txCount==NRF24SIM_FIFO_LEN){
+			return;
+		}
+		if(n->cmd==W_TX_PAYLOAD_NOACK && !(n->reg[FEATURE] & EN_DYN_ACK)){
+			return;
+		}
+		if((n->cmd & 0xF8)==W_ACK_PAYLOAD && !(n->reg[FEATURE] & EN_ACK_PAY)){
+			return;
+		}
+		p=n->tx+n->txCount++;
+		memset(p,0,sizeof(*p));
+		p->pipe=(n->cmd & 0xF8)==W_ACK_PAYLOAD ? (n->cmd & 0x07) : NRF24SIM_NO_PIPE;
+		p->noACK=n->cmd==W_TX_PAYLOAD_NOACK;
+		p->len=len;
+		memcpy(p->data,n->in,len);
+	}else if(n->cmd==FLUSH_TX){
+		n->txCount=0;
+		n->txState=NRF24SIM_TX_IDLE;
+		n->eventAt=NRF24SIM_NEVER;
+	}else if(n->cmd==FLUSH_RX){
+		n->rxCount=0;
+	}
+	nRF24sim_modeUpdate(n);
+}
+
+static void nRF24sim_csn(nRF24sim_node* n, _Bool level){
+	if(!level && n->csn){
+		n->csn=0;
+		n->pos=0;
+	}else if(level && !n->csn){
+		n->csn=1;
+		if(n->pos){
+			n->stats.spiTransactions++;
+			nRF24sim_commit(n);
+		}
+	}
+	if(level){
+		nRF24sim_deliver();
+	}
+}
+
+/*! Exchange one byte with a module; the SPI clock time passes first.
+* \param hz - SPI clock the byte is charged at;
+*/
+static uint8_t nRF24sim_exchange(nRF24sim_node* n, uint8_t byte, uint32_t hz){
+	uint8_t miso=0xFF;
+
+	nRF24sim_runTo(nRF24sim_now+8*1000000000ULL/hz);
+	if(n->csn){
+		return miso; //not selected, MISO floats high
+	}
+	n->stats.spiBytes++;
+	if(n->pos==0){
+		n->cmd=byte;
+		nRF24sim_prepare(n);
+		miso=nRF24sim_status(n);
+	}else if(n->pos<=32){
+		miso=n->out[n->pos-1];
+		n->in[n->pos-1]=byte;
+	}
+	if(n->pos<33){
+		n->pos++;
+	}
+	return miso;
+}
+
+static void nRF24sim_ce(nRF24sim_node* n, _Bool level){
+	n->ce=level;
+	nRF24sim_modeUpdate(n);
+}
+
+/*** SIMULATOR FUNCTIONS ***/
+/*! Add a module to the simulated air.
+* \detail The module starts in power down mode with the datasheet reset values. The first module added is selected.
+* \return module number or \c 0xFF if \c NRF24SIM_NODES_MAX modules already exist;
+*/
+uint8_t nRF24sim_addNode(void){
+	nRF24sim_node* n;
+
+	if(nRF24sim_nodeCount==NRF24SIM_NODES_MAX){
+		return 0xFF; //error avoidance
+	}
+	n=nRF24sim_nodes+nRF24sim_nodeCount;
+	memset(n,0,sizeof(*n));
+	n->reg[CONFIG]=EN_CRC;
+	n->reg[EN_AA]=0x3F;
+	n->reg[EN_RXADDR]=0x03;
+	n->reg[SETUP_AW]=AW(3);
+	n->reg[SETUP_RETR]=ARC(3);
+	n->reg[RF_CH]=2;
+	n->reg[RF_SETUP]=0x0E;
+	n->reg[RX_ADDR_P2]=0xC3;
+	n->reg[RX_ADDR_P3]=0xC4;
+	n->reg[RX_ADDR_P4]=0xC5;
+	n->reg[RX_ADDR_P5]=0xC6;
+	memset(n->addr[0],0xE7,5);
+	memset(n->addr[1],0xC2,5);
+	memset(n->addr[2],0xE7,5);
+	memset(n->lastPid,0xFF,sizeof(n->lastPid));
+	n->csn=1;
+	n->eventAt=NRF24SIM_NEVER;
+
+	return nRF24sim_nodeCount++;
+}
+
+/*! Remove every module, reset the statistics and the clock.
+* \detail The loss, the channel noise and the random generator are reset as well.
+*/
+void nRF24sim_reset(void){
+	nRF24sim_nodeCount=0;
+	nRF24sim_now=0;
+	nRF24sim_primask=0;
+	nRF24sim_inIrq=0;
+	nRF24sim_loss=0;
+	memset(nRF24sim_noise,0,sizeof(nRF24sim_noise));
+	nRF24sim_random=1;
+	nRF24sim_lcdValue=0;
+	memset(&nRF24sim_spi1Regs,0,sizeof(nRF24sim_spi1Regs));
+	nRF24sim_spiRxCount=0;
+	nRF24sim_spiInIrq=0;
+	memset(&nRF24sim_spiStat,0,sizeof(nRF24sim_spiStat));
+}
+
+/*! Attach the IRQ handler of a module.
+* \param node - module number;
+* \param irqHandler - the handler, \c 0 - none;
+*/
+void nRF24sim_attach(uint8_t node, void (*irqHandler)(void)){
+	if(node<nRF24sim_nodeCount){
+		nRF24sim_nodes[node].irqHandler=irqHandler;
+	}
+}
+
+/*! Set the packet loss of the air.
+* \param permille - probability (0-1000) that a packet or an ACK is lost on any channel;
+*/
+void nRF24sim_setLoss(uint16_t permille){
+	nRF24sim_loss=permille;
+}
+
+/*! Set the noise of a channel.
+* \param channel - RF channel (0-125);
+* \param permille - additional loss probability (0-1000);
+*/
+void nRF24sim_setNoise(uint8_t channel, uint16_t permille){
+	nRF24sim_noise[channel&0x7F]=permille;
+}
+
+/*! Seed the random generator of the air.
+* \param seed - any value; the same seed gives the same sequence of losses;
+*/
+void nRF24sim_seed(uint32_t seed){
+	nRF24sim_random=seed ? seed : 1; //xorshift is stuck at 0
+}
+
+/*! Get the simulated time.
+* \return microseconds since nRF24sim_reset();
+*/
+uint32_t nRF24sim_micros(void){
+	return (uint32_t)(nRF24sim_now/1000);
+}
+
+/*! Run the simulation until a point in time.
+* \param deadline - time stamp to run to (see nRF24sim_micros());
+*/
+void nRF24sim_runUntil(uint32_t deadline){
+	int32_t left=(int32_t)(deadline-nRF24sim_micros());
+
+	if(left>0){
+		nRF24sim_runTo(nRF24sim_now+NRF24SIM_NS(left));
+	}else{
+		nRF24sim_deliver();
+	}
+}
+
+/*! Let the simulated time pass while waiting for an event.
+*/
+void nRF24sim_yield(void){
+	uint64_t t=nRF24sim_now+NRF24SIM_NS(NRF24SIM_YIELD_US);
+	uint8_t i;
+
+	for(i=0;i<nRF24sim_nodeCount;i++){
+		if(nRF24sim_nodes[i].eventAt<t){
+			t=nRF24sim_nodes[i].eventAt;
+		}
+	}
+	nRF24sim_runTo(t);
+}
+
+/*! Get the statistics of a module.
+* \param node - module number;
+* \return a pointer to the statistics;
+*/
+const nRF24sim_stats* nRF24sim_getStats(uint8_t node){
+	return &nRF24sim_nodes[node<nRF24sim_nodeCount ? node : 0].stats;
+}
+
+/*! Copy the configuration of a module to another one.
+* \param dst - destination module number;
+* \param src - source module number;
+*/
+void nRF24sim_cloneConfig(uint8_t dst, uint8_t src){
+	nRF24sim_node* n=nRF24sim_nodes+dst;
+	uint8_t status;
+
+	if(dst>=nRF24sim_nodeCount || src>=nRF24sim_nodeCount){
+		return;
+	}
+	status=n->reg[STATUS];
+	if(!(n->reg[CONFIG] & PWR_UP) && (nRF24sim_nodes[src].reg[CONFIG] & PWR_UP)){
+		n->readyAt=nRF24sim_now+NRF24SIM_NS(NRF24SIM_T_PD2STBY_US);
+	}
+	memcpy(n->reg,nRF24sim_nodes[src].reg,sizeof(n->reg));
+	memcpy(n->addr,nRF24sim_nodes[src].addr,sizeof(n->addr));
+	n->reg[STATUS]=status;
+	n->reg[OBSERVE_TX]=0;
+	nRF24sim_irqUpdate(n);
+	nRF24sim_modeUpdate(n);
+}
+
+/*! Execute one CSN framed SPI transaction on any module.
+* \param node - module number;
+* \param tx - bytes to send (the instruction first);
+* \param rx - received bytes (\c STATUS first), may be \c 0;
+* \param len - transaction length including the instruction;
+* \return \c STATUS register value;
+*/
+uint8_t nRF24sim_spi(uint8_t node, const uint8_t* tx, uint8_t* rx, uint8_t len){
+	nRF24sim_node* n=nRF24sim_nodes+node;
+	uint8_t i,miso,status=0xFF;
+
+	if(node>=nRF24sim_nodeCount){
+		return 0xFF; //error avoidance
+	}
+	nRF24sim_csn(n,0);
+	for(i=0;i<len;i++){
+		miso=nRF24sim_exchange(n,tx[i],NRF24SIM_SPI_HZ);
+		if(i==0){
+			status=miso;
+		}
+		if(rx){
+			rx[i]=miso;
+		}
+	}
+	nRF24sim_csn(n,1);
+
+	return status;
+}
+
+/*! Drive the \c CE pin of any module.
+* \param node - module number;
+* \param level - pin level;
+*/
+void nRF24sim_setCE(uint8_t node, _Bool level){
+	if(node<nRF24sim_nodeCount){
+		nRF24sim_ce(nRF24sim_nodes+node,level);
+	}
+}
+
+/*! Get the \c PRIMASK emulation.
+* \return \c '1' - interrupts masked;
+*/
+uint32_t nRF24sim_getPRIMASK(void){
+	return nRF24sim_primask;
+}
+
+/*! Set the \c PRIMASK emulation.
+* \param masked - \c '1' - mask the interrupts;
+*/
+void nRF24sim_setPRIMASK(uint32_t masked){
+	nRF24sim_primask=masked;
+	if(!masked){
+		nRF24sim_spiIrq();
+		nRF24sim_deliver();
+	}
+}
+
+/*! Get the last value shown with slcdErr() or slcdDisplay().
+* \return the value;
+*/
+uint16_t nRF24sim_lcd(void){
+	return nRF24sim_lcdValue;
+}
+
+/*** SPI1 ***/
+/*! Compute the SPI1 status flags from the RX FIFO fill; the TX FIFO is always empty, bytes are shifted out as soon as they are written.
+*/
+static uint8_t nRF24sim_spiFlags(void){
+	uint8_t flags=SPI_S_SPTEF_MASK;
+
+	if(nRF24sim_spi1Regs.C3 & SPI_C3_FIFOMODE_MASK){
+		flags|=SPI_S_TNEAREF_MASK;
+		if(nRF24sim_spiRxCount==NRF24SIM_SPI_FIFO_LEN){
+			flags|=SPI_S_SPRF_MASK;
+		}
+		if(nRF24sim_spiRxCount>=((nRF24sim_spi1Regs.C3 & SPI_C3_RNFULLF_MARK_MASK) ? 2 : 3)){ //32 or 48 bits of 16 bit entries
+			flags|=SPI_S_RNFULLF_MASK;
+		}
+		if(!nRF24sim_spiRxCount){
+			flags|=SPI_S_RFIFOEF_MASK;
+		}
+	}else if(nRF24sim_spiRxCount){
+		flags|=SPI_S_SPRF_MASK;
+	}
+
+	return flags;
+}
+
+/*! Call SPI1_IRQHandler() while an enabled flag is raised, unless an interrupt could not be taken now.
+* \detail The SPI1 interrupt preempts the module IRQ handlers (it has the higher priority), so only \c PRIMASK and the handler itself hold it off.
+*/
+static void nRF24sim_spiIrq(void){
+	uint8_t flags;
+	uint32_t reads;
+
+	if(nRF24sim_primask || nRF24sim_spiInIrq || !(nRF24sim_spi1Regs.C1 & SPI_C1_SPE_MASK)){
+		return;
+	}
+	for(;;){
+		flags=nRF24sim_spiFlags();
+		if(!((nRF24sim_spi1Regs.C1 & SPI_C1_SPIE_MASK) && (flags & SPI_S_SPRF_MASK)) &&
+			 !((nRF24sim_spi1Regs.C3 & SPI_C3_RNFULLIEN_MASK) && (flags & SPI_S_RNFULLF_MASK))){
+			return;
+		}
+		nRF24sim_spiStat.irqs++;
+		reads=nRF24sim_spiStat.reads;
+		nRF24sim_spiInIrq=1;
+		SPI1_IRQHandler();
+		nRF24sim_spiInIrq=0;
+		if(nRF24sim_spiStat.reads==reads){
+			return; //the handler has not served the flag, do not spin
+		}
+	}
+}
+
+/*! Read the SPI1 status register.
+* \return \c SPI_S flags;
+*/
+uint8_t nRF24sim_spi1Status(void){
+	nRF24sim_spiStat.statusReads++;
+	return nRF24sim_spiFlags();
+}
+
+/*! Read the SPI1 data register - the oldest byte of the RX FIFO.
+* \return the byte, \c 0 if the RX FIFO is empty (an underflow);
+*/
+uint8_t nRF24sim_spi1Read(void){
+	uint8_t byte;
+
+	if(!nRF24sim_spiRxCount){
+		nRF24sim_spiStat.underflows++;
+		return 0;
+	}
+	nRF24sim_spiStat.reads++;
+	byte=nRF24sim_spiRx[0];
+	nRF24sim_spiRxCount--;
+	memmove(nRF24sim_spiRx,nRF24sim_spiRx+1,nRF24sim_spiRxCount);
+
+	return byte;
+}
+
+/*! Write the SPI1 data register.
+* \detail The byte is exchanged at once with the module whose \c CSN is low (\c 0xFF is clocked in if there is none, as with MISO pulled up) and the byte clocked in is put to the RX FIFO. \c SPI1_IRQHandler() is called if an enabled flag is raised, unless \c PRIMASK is set or the handler is running.
+* \param data - byte to send;
+*/
+void nRF24sim_spi1Write(uint8_t data){
+	uint8_t miso=0xFF,depth=(nRF24sim_spi1Regs.C3 & SPI_C3_FIFOMODE_MASK) ? NRF24SIM_SPI_FIFO_LEN : 1;
+	uint32_t divisor=((nRF24sim_spi1Regs.BR>>4 & 0x07)+1)<<((nRF24sim_spi1Regs.BR & 0x0F)+1);
+	nRF24sim_node* n=nRF24sim_framed();
+
+	nRF24sim_spiStat.writes++;
+	if(n){
+		miso=nRF24sim_exchange(n,data,F_CPU_DEF/divisor); //the rate set in BR from the system clock
+	}
+	if(nRF24sim_spiRxCount==depth){
+		nRF24sim_spiStat.overflows++; //the byte is lost, as on the device
+	}else{
+		nRF24sim_spiRx[nRF24sim_spiRxCount++]=miso;
+		if(nRF24sim_spiRxCount>nRF24sim_spiStat.maxFill){
+			nRF24sim_spiStat.maxFill=nRF24sim_spiRxCount;
+		}
+	}
+	nRF24sim_spiIrq();
+}
+
+/*! Get the statistics of the SPI1 model.
+* \return a pointer to the statistics, cleared by nRF24sim_reset();
+*/
+const nRF24sim_spiStats* nRF24sim_getSpiStats(void){
+	return &nRF24sim_spiStat;
+}
+
+/*** PINS ***/
+void pin_CE(const pin_radio* pins, _Bool setClear){
+	nRF24sim_ce(nRF24sim_nodes+pins->node,setClear);
+}
+
+void pin_CSN(const pin_radio* pins, _Bool setClear){
+	SPI_TRACE_CSN(setClear);
+	nRF24sim_csn(nRF24sim_nodes+pins->node,setClear);
+}
+
+_Bool pin_IRQ(const pin_radio* pins){
+	(void)pins;
+	return 0; //the handlers are called by the model (see nRF24sim_attach())
+}
+
+void pin_Init(const pin_radio* pins){
+	(void)pins;
+}
+
+/*** DISPLAY ***/
+void slcdInitialize(void){
+}
+
+void slcdErr(uint8_t number){
+	nRF24sim_lcdValue=number;
+}
+
+void slcdSet(uint8_t value,uint8_t digit){
+	(void)value;
+	(void)digit;
+}
+
+void slcdDisplay(uint16_t value,uint16_t format){
+	(void)format;
+	nRF24sim_lcdValue=value;
+}
+
+void slcdClear(void){
+	nRF24sim_lcdValue=0;
+}
+
+void slcdDemo(void){
+}
+
+#endif
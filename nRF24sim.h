@@ -0,0 +1,244 @@
+/*! \brief The header file with the host-side nRF24L01+ behavioural simulator.
+*	\file nRF24sim.h
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file replaces the device header in the host (Linux) build, selected with the \b NRF24_SIM define. \c nRF24.c, \c lang4robots.c, \c SPI.c, \c spiBus.c and the headers they use are compiled unchanged; the SPI1 peripheral, \c pin_CE()/pin_CSN(), the delay clock and the module IRQ line are routed to a software model of the nRF24L01+.
+* \par The model keeps the register map, 3-deep TX/RX FIFOs, Enhanced ShockBurst auto ACK (with ACK payloads), auto retransmission and duplicate suppression. Any number of simulated modules (up to \c NRF24SIM_NODES_MAX) share one simulated air with a configurable packet loss. Time is simulated too: it advances with SPI traffic, delays and waits, so results do not depend on the host speed.
+* \par The SPI1 model has the registers used by \c SPI.c and the 4-deep RX FIFO with its watermark flags (\c SPRF, \c RNFULLF, \c RFIFOEF). Every byte written to the data register is exchanged at once with the module whose \c CSN is low, so the chunking and the byte order of the SPI1 transfer engine are checked against the module; \c SPI1_IRQHandler() is called when an enabled flag is raised (see nRF24sim_getSpiStats()). \c spiHost.c runs the checks of the transfer engine, the baud rate computation and the bus manager.
+* \par Host build: compile \c nRF24sim.c, \c nRF24.c, \c lang4robots.c, \c SPI.c and \c spiBus.c (and optionally \c pinManagement.c and \c delay.c, which are empty then) with \c -DNRF24_SIM, together with a program providing the module IRQ handler (see nRF24sim_attach()).
+* \note The driver reaches a module through the \c pin_radio of its \c nrf24_dev handle (\c PIN_RADIO_SIM(node)), so several driver instances may run side by side. Modules without a driver instance are driven through the raw model interface (nRF24sim_spi(), nRF24sim_setCE()), e.g. as peers configured with nRF24sim_cloneConfig().
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifndef NRF24SIM_H
+	#define NRF24SIM_H
+
+	#include <stdint.h>
+
+	/*! \name SIMULATOR SETTINGS
+	* Model parameters.
+	* @{
+	*/
+	/********************
+	* SIMULATOR SETTINGS
+	********************/
+	#define NRF24SIM_NODES_MAX		8				//!< Maximum number of simulated modules
+	#define NRF24SIM_SPI_HZ				6000000	//!< SPI clock charged for every byte exchanged through nRF24sim_spi(); the driver bytes are charged at the SPI1 rate set in \c BR
+	#define NRF24SIM_T_SETTLE_US	130			//!< PLL settling before every transmission and before listening (Tstby2a)
+	#define NRF24SIM_YIELD_US			10			//!< Time step of nRF24sim_yield() when no radio event is due
+	#define NRF24SIM_RPD_PERMILLE	100			//!< Channel noise (loss permille) from which \c RPD reads \c '1'
+	//!@}
+
+	/*! \name DEVICE HEADER REPLACEMENTS
+	* Core intrinsics used by the driver, mapped to the model.
+	* @{
+	*/
+	/****************************
+	* DEVICE HEADER REPLACEMENTS
+	****************************/
+	#define __DMB()							__sync_synchronize()
+	#define __WFI()							nRF24sim_yield()
+	#define __disable_irq()			nRF24sim_setPRIMASK(1)
+	#define __enable_irq()			nRF24sim_setPRIMASK(0)
+	#define __get_PRIMASK()			nRF24sim_getPRIMASK()
+	#define __set_PRIMASK(x)		nRF24sim_setPRIMASK(x)
+	#define NVIC_EnableIRQ(x)					((void)0)
+	#define NVIC_DisableIRQ(x)				((void)0)
+	#define NVIC_ClearPendingIRQ(x)		((void)0)
+	#define NVIC_SetPriority(x,y)			((void)0)
+
+	/*! SPI1 registers written by \c SPI.c; the status and data registers are reached through nRF24sim_spi1Status(), nRF24sim_spi1Read() and nRF24sim_spi1Write(). */
+	typedef struct{
+		uint8_t BR;
+		uint8_t C1;
+		uint8_t C2;
+		uint8_t C3;
+		uint8_t ML;
+		uint8_t MH;
+	}nRF24sim_spiRegs;
+	extern nRF24sim_spiRegs nRF24sim_spi1Regs;
+	#define SPI1									(&nRF24sim_spi1Regs)
+	#define SPI_BR_SPPR(x)				((uint8_t)(((x)<<4) & 0x70))
+	#define SPI_BR_SPR(x)					((uint8_t)((x) & 0x0F))
+	#define SPI_C1_SPIE_MASK			0x80
+	#define SPI_C1_SPE_MASK				0x40
+	#define SPI_C1_SPTIE_MASK			0x20
+	#define SPI_C1_MSTR_SHIFT			4
+	#define SPI_C1_CPOL_SHIFT			3
+	#define SPI_C1_CPHA_SHIFT			2
+	#define SPI_C1_LSBFE_SHIFT		0
+	#define SPI_C2_SPIMODE_SHIFT	6
+	#define SPI_C2_TXDMAE_MASK		0x20
+	#define SPI_C2_BIDIROE_SHIFT	3
+	#define SPI_C2_RXDMAE_MASK		0x04
+	#define SPI_C3_TNEAREF_MARK_MASK	0x20
+	#define SPI_C3_RNFULLF_MARK_MASK	0x10
+	#define SPI_C3_TNEARIEN_MASK	0x04
+	#define SPI_C3_RNFULLIEN_MASK	0x02
+	#define SPI_C3_FIFOMODE_MASK	0x01
+	#define SPI_S_SPRF_MASK				0x80
+	#define SPI_S_SPTEF_MASK			0x20
+	#define SPI_S_RNFULLF_MASK		0x08
+	#define SPI_S_TNEAREF_MASK		0x04
+	#define SPI_S_TXFULLF_MASK		0x02
+	#define SPI_S_RFIFOEF_MASK		0x01
+	//!@}
+
+	/*! \name SIMULATOR TYPES
+	* @{
+	*/
+	/*****************
+	* SIMULATOR TYPES
+	*****************/
+	/*! Per module statistics collected by the model. */
+	typedef struct{
+		uint32_t spiTransactions;		//!< CSN framed SPI transactions
+		uint32_t spiBytes;					//!< bytes exchanged over SPI (instruction bytes included)
+		uint32_t airPackets;				//!< packets put on air (retransmissions included)
+		uint32_t retransmits;				//!< automatic retransmissions
+		uint32_t delivered;					//!< packets completed with \c TX_DS
+		uint32_t lost;							//!< packets given up with \c MAX_RT
+		uint32_t received;					//!< packets stored in RX FIFO
+		uint32_t duplicates;				//!< retransmitted packets recognised and dropped by the receiver
+		uint32_t rxOverflows;				//!< packets dropped because RX FIFO was full
+		uint32_t ackPayloads;				//!< ACK payloads sent (PRX) or received (PTX)
+		uint32_t illegalWrites;			//!< \c W_REGISTER (except \c STATUS) outside power down and standby modes
+	}nRF24sim_stats;
+
+	/*! Statistics of the SPI1 model. */
+	typedef struct{
+		uint32_t statusReads;		//!< reads of the status register (polls included)
+		uint32_t writes;				//!< bytes written to the data register
+		uint32_t reads;					//!< bytes read from the data register
+		uint32_t irqs;					//!< \c SPI1_IRQHandler() calls
+		uint32_t overflows;			//!< bytes received with the RX FIFO full (lost)
+		uint32_t underflows;		//!< data register reads with the RX FIFO empty
+		uint8_t maxFill;				//!< highest RX FIFO fill seen
+	}nRF24sim_spiStats;
+	//!@}
+
+	/*! \name SIMULATOR FUNCTIONS
+	* @{
+	*/
+	/*********************
+	* SIMULATOR FUNCTIONS
+	*********************/
+	/*! Add a module to the simulated air.
+	* \detail The module starts in power down mode with the datasheet reset values. The first module added is selected.
+	* \return module number or \c 0xFF if \c NRF24SIM_NODES_MAX modules already exist;
+	*/
+	uint8_t nRF24sim_addNode(void);
+
+	/*! Remove every module, reset the statistics and the clock.
+	*/
+	void nRF24sim_reset(void);
+
+	/*! Attach the IRQ handler of a module.
+	* \detail The handler is called on the falling edge of the module IRQ line, at the next point an interrupt could be taken: after a CSN framed transaction, in a delay or in nRF24sim_yield(), never with \c PRIMASK set.
+	* \param node - module number;
+	* \param irqHandler - the handler, \c 0 - none;
+	*/
+	void nRF24sim_attach(uint8_t node, void (*irqHandler)(void));
+
+	/*! Set the packet loss of the air.
+	* \param permille - probability (0-1000) that a packet or an ACK is lost on any channel;
+	*/
+	void nRF24sim_setLoss(uint16_t permille);
+
+	/*! Set the noise of a channel.
+	* \detail The noise adds to the loss of the air on the channel; \c RPD reads \c '1' from \c NRF24SIM_RPD_PERMILLE.
+	* \param channel - RF channel (0-125);
+	* \param permille - additional loss probability (0-1000);
+	*/
+	void nRF24sim_setNoise(uint8_t channel, uint16_t permille);
+
+	/*! Seed the random generator of the air.
+	* \param seed - any value; the same seed gives the same sequence of losses;
+	*/
+	void nRF24sim_seed(uint32_t seed);
+
+	/*! Get the simulated time.
+	* \return microseconds since nRF24sim_reset();
+	*/
+	uint32_t nRF24sim_micros(void);
+
+	/*! Run the simulation until a point in time.
+	* \detail Radio events are processed and IRQ handlers called in time order.
+	* \param deadline - time stamp to run to (see nRF24sim_micros());
+	*/
+	void nRF24sim_runUntil(uint32_t deadline);
+
+	/*! Let the simulated time pass while waiting for an event.
+	* \detail Runs to the next radio event, or \c NRF24SIM_YIELD_US if none is due. Used for \c WFI and delay_yield().
+	*/
+	void nRF24sim_yield(void);
+
+	/*! Get the statistics of a module.
+	* \param node - module number;
+	* \return a pointer to the statistics;
+	*/
+	const nRF24sim_stats* nRF24sim_getStats(uint8_t node);
+
+	/*! Copy the configuration of a module to another one.
+	* \detail All registers and addresses are copied, the FIFOs and the \c CE pin are left as they are.
+	* \param dst - destination module number;
+	* \param src - source module number;
+	*/
+	void nRF24sim_cloneConfig(uint8_t dst, uint8_t src);
+
+	/*! Execute one CSN framed SPI transaction on any module.
+	* \param node - module number;
+	* \param tx - bytes to send (the instruction first);
+	* \param rx - received bytes (\c STATUS first), may be \c 0;
+	* \param len - transaction length including the instruction;
+	* \return \c STATUS register value;
+	*/
+	uint8_t nRF24sim_spi(uint8_t node, const uint8_t* tx, uint8_t* rx, uint8_t len);
+
+	/*! Drive the \c CE pin of any module.
+	* \param node - module number;
+	* \param level - pin level;
+	*/
+	void nRF24sim_setCE(uint8_t node, _Bool level);
+
+	/*! Get the \c PRIMASK emulation.
+	* \return \c '1' - interrupts masked;
+	*/
+	uint32_t nRF24sim_getPRIMASK(void);
+
+	/*! Set the \c PRIMASK emulation.
+	* \detail A pending IRQ handler is called when the interrupts are unmasked.
+	* \param masked - \c '1' - mask the interrupts;
+	*/
+	void nRF24sim_setPRIMASK(uint32_t masked);
+
+	/*! Read the SPI1 status register.
+	* \return \c SPI_S flags;
+	*/
+	uint8_t nRF24sim_spi1Status(void);
+
+	/*! Read the SPI1 data register - the oldest byte of the RX FIFO.
+	* \return the byte, \c 0 if the RX FIFO is empty (an underflow);
+	*/
+	uint8_t nRF24sim_spi1Read(void);
+
+	/*! Write the SPI1 data register.
+	* \detail The byte is exchanged with the selected module at once and the byte clocked in is put to the RX FIFO. \c SPI1_IRQHandler() is called if an enabled flag is raised, unless \c PRIMASK is set or the handler is running.
+	* \param data - byte to send;
+	*/
+	void nRF24sim_spi1Write(uint8_t data);
+
+	/*! Get the statistics of the SPI1 model.
+	* \return a pointer to the statistics, cleared by nRF24sim_reset();
+	*/
+	const nRF24sim_spiStats* nRF24sim_getSpiStats(void);
+
+	/*! Get the last value shown with slcdErr() or slcdDisplay().
+	* \detail The host build has no display; command handlers writing to it may be checked with this function.
+	* \return the value;
+	*/
+	uint16_t nRF24sim_lcd(void);
+	//!@}
+
+#endif
@@ -8,56 +8,79 @@
 */
 
 #include "pinManagement.h"
+#include "spiTrace.h"
+
+#ifndef NRF24_SIM //the host build takes the pins from nRF24sim.c
 
 /*! Set or clear the \c CE pin. 
+* \param pins - pins of the module;
 * \param setClear - \c '1': set the \c CE pin, \c '0': clear the \c CE pin;
 * \sa pin_CSN()
 */
-void pin_CE(_Bool setClear){
+void pin_CE(const pin_radio* pins, _Bool setClear){
 	if(setClear){
-		FPT_SET(PORT_CE, PIN_CE);
-		CE_state=1;
+		pins->ce.fpt -> PSOR = (1UL<<pins->ce.pin);
 	}else {
-		FPT_CLEAR(PORT_CE, PIN_CE);
-		CE_state=0;
+		pins->ce.fpt -> PCOR = (1UL<<pins->ce.pin);
 	}
 }
 
 /*! Set or clear the \c CSN pin. 
+* \param pins - pins of the module;
 * \param setClear - \c '1': set the \c CSN pin, \c '0': clear the \c CSN pin;
 * \sa pin_CE()
 */
-void pin_CSN(_Bool setClear){
+void pin_CSN(const pin_radio* pins, _Bool setClear){
+	SPI_TRACE_CSN(setClear);
 	if(setClear){
-		FPT_SET(PORT_CSN, PIN_CSN);
-		CSN_state=1;
+		pins->csn.fpt -> PSOR = (1UL<<pins->csn.pin);
 	}else {
-		FPT_CLEAR(PORT_CSN, PIN_CSN);
-		CSN_state=0;
+		pins->csn.fpt -> PCOR = (1UL<<pins->csn.pin);
 	}
 }
 
-/*! Initialize the pins. 
-* \detail The function initializes the pins according to *PIN SETTINGS* in \c 'pinManagement.h'.
-* \sa pinManagement.h
+/*! Check and clear the interrupt flag of the \c IRQ pin.
+* \param pins - pins of the module;
+* \return \c '1' - the interrupt came from the module (the flag has been cleared), \c '0' - not from this module;
 */
-void pin_Init(void){
-	SIM_SCGC5_SET(PORT_CE);
-	SIM_SCGC5_SET(PORT_CSN);
-	SIM_SCGC5_SET(PORT_IRQ);
+_Bool pin_IRQ(const pin_radio* pins){
+	if(!(pins->irq.port -> PCR[pins->irq.pin] & PORT_PCR_ISF_MASK)){
+		return 0;
+	}
+	pins->irq.port -> PCR[pins->irq.pin] |= PORT_PCR_ISF_MASK;
 	
-	PORT_PCR_MUX_GPIO(PORT_CE, PIN_CE);
-	PORT_PCR_MUX_GPIO(PORT_CSN, PIN_CSN);
-	PORT_PCR_MUX_GPIO(PORT_IRQ, PIN_IRQ);
+	return 1;
+}
+
+/*! Set a pin as a GPIO pin.
+* \param p - the pin;
+*/
+static void pin_gpio(const pin_def* p){
+	SIM->SCGC5 |= p->scgc5;
+	p->port -> PCR[p->pin] &= ~PORT_PCR_MUX_MASK;
+	p->port -> PCR[p->pin] |= PORT_PCR_MUX(1);
+}
+
+/*! Initialize the pins of a module. 
+* \detail \c CE is cleared, \c CSN is set and the \c IRQ pin interrupt is enabled on the falling edge, with a pull up.
+* \param pins - pins of the module;
+* \sa pinManagement.h
+*/
+void pin_Init(const pin_radio* pins){
+	pin_gpio(&pins->ce);
+	pin_gpio(&pins->csn);
+	pin_gpio(&pins->irq);
 	
-	PIN_OUTPUT(PORT_CE, PIN_CE);
-	PIN_OUTPUT(PORT_CSN, PIN_CSN);
-	PIN_INPUT(PORT_IRQ, PIN_IRQ);
-	PIN_PULL_ENABLE(PORT_IRQ, PIN_IRQ);
-	PIN_PULL_UP(PORT_IRQ, PIN_IRQ);
+	pin_CE(pins, LOW);
+	pin_CSN(pins, HIGH);
+	pins->ce.fpt -> PDDR |= (1UL<<pins->ce.pin);
+	pins->csn.fpt -> PDDR |= (1UL<<pins->csn.pin);
+	pins->irq.fpt -> PDDR &= ~(1UL<<pins->irq.pin);
+	pins->irq.port -> PCR[pins->irq.pin] |= PORT_PCR_PE_MASK | PORT_PCR_PS_MASK;
 	
-	PIN_IRQ_ENABLE(PORT_IRQ, PIN_IRQ, FALLING_EDGE);
-	NVIC_ClearPendingIRQ(PIN_IRQ_IRQn);
-	NVIC_EnableIRQ(PIN_IRQ_IRQn);
+	pins->irq.port -> PCR[pins->irq.pin] |= PORT_PCR_IRQC(FALLING_EDGE);
+	NVIC_ClearPendingIRQ(pins->irqn);
+	NVIC_EnableIRQ(pins->irqn);
 }
 
+#endif
@@ -3,7 +3,7 @@
 *	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
 *	
 * This file contains useful functions, macros and defines ready for use.
-* \par Just modify the pins locations in *PINS DEFINES* section and optionally a \c 'pin_Init()' function and IRQ handler.
+* \par Every radio module has its own \c CE, \c CSN and \c IRQ pins, described by a \c pin_radio structure kept in its \c nrf24_dev handle; the modules share the SPI bus. Just modify the pins locations in *PINS DEFINES* section and optionally a \c 'pin_Init()' function and IRQ handler.
 * \note In order to use \c IRQ pin to handle interrupts coming from \b nRF24L01+ module, you have to locate the \c IRQ pin on PORTA, PORTC or PORTD. The \c IRQ pin initialization in \c 'pin_Init()' function must have pull up resistor enabled and an IRQ has to be trigerred on falling edge.
 *
 * \b Copyright: Sebastian Pisklak & Jakub Olak
@@ -12,7 +12,11 @@
 #ifndef PINMANAGEMENT_H
 	#define PINMANAGEMENT_H
 	
-	#include "MKL46Z4.h"
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
 	
 	/*! \name VALUE MNEMONICS
 	* Useful value mnemonics.
@@ -67,6 +71,76 @@
 	#define PORT_CSN			D
 	/*! The number of pin for \c CSN pin. */
 	#define PIN_CSN				6
+	
+	/*! The port for \c IRQ pin of the second module (same rules as for \c PORT_IRQ). */
+	#define PORT_IRQ_B		C
+	/*! The number of pin for \c IRQ pin of the second module. */
+	#define PIN_IRQ_B			7
+	/*! The \c IRQn enumerator for \c IRQ pin of the second module. */
+	#define PIN_IRQ_B_IRQn	PORTC_PORTD_IRQn
+	/*! The port for \c CE pin of the second module. */
+	#define PORT_CE_B			C
+	/*! The number of pin for \c CE pin of the second module. */
+	#define PIN_CE_B			5
+	/*! The port for \c CSN pin of the second module. */
+	#define PORT_CSN_B		C
+	/*! The number of pin for \c CSN pin of the second module. */
+	#define PIN_CSN_B			6
+	//!@}
+	
+	/*! \name PIN TYPES
+	* Run time pin descriptions, so the same functions drive the pins of any module.
+	* @{
+	*/
+	/***********
+	* PIN TYPES
+	***********/
+	#ifdef NRF24_SIM
+		/*! Pins of a module in the host build - the simulated module they are wired to. */
+		typedef struct{
+			uint8_t node;	//!< nRF24sim_addNode() module number
+		}pin_radio;
+		
+		/*! \c pin_radio initializer of a simulated module. */
+		#define PIN_RADIO_SIM(node)	{node}
+	#else
+		/*! One pin. */
+		typedef struct{
+			PORT_Type* port;		//!< pin control registers
+			FGPIO_Type* fpt;		//!< fast GPIO registers
+			uint32_t scgc5;			//!< clock gate mask of the port in \c SIM->SCGC5
+			uint8_t pin;				//!< pin number
+		}pin_def;
+		
+		/*! Pins of a module. */
+		typedef struct{
+			pin_def ce;
+			pin_def csn;
+			pin_def irq;
+			IRQn_Type irqn;			//!< interrupt of the \c IRQ pin port
+		}pin_radio;
+		
+		/*! \c pin_def initializer.
+		* \detail PIN_DEF(port, pin) => {PORTport, FPTport, SIM_SCGC5_PORTport_MASK, pin}
+		*/
+		#define PIN_DEF(port, pin)		{GLUE(PORT, port), GLUE(FPT, port), SIM_SCGC5_GLUE(SIM_SCGC5_PORT, port, _MASK), pin}
+		
+		/*! \c pin_radio initializer. */
+		#define PIN_RADIO(cePort, cePin, csnPort, csnPin, irqPort, irqPin, irqn)	{PIN_DEF(cePort, cePin), PIN_DEF(csnPort, csnPin), PIN_DEF(irqPort, irqPin), irqn}
+	#endif
+	
+	/*! \c pin_radio initializer of the first module - \c PORT_CE, \c PORT_CSN and \c PORT_IRQ pins (module 0 in the host build). */
+	#ifdef NRF24_SIM
+		#define PIN_RADIO_A		PIN_RADIO_SIM(0)
+	#else
+		#define PIN_RADIO_A		PIN_RADIO(PORT_CE, PIN_CE, PORT_CSN, PIN_CSN, PORT_IRQ, PIN_IRQ, PIN_IRQ_IRQn)
+	#endif
+	/*! \c pin_radio initializer of the second module - \c PORT_CE_B, \c PORT_CSN_B and \c PORT_IRQ_B pins (module 1 in the host build). */
+	#ifdef NRF24_SIM
+		#define PIN_RADIO_B		PIN_RADIO_SIM(1)
+	#else
+		#define PIN_RADIO_B		PIN_RADIO(PORT_CE_B, PIN_CE_B, PORT_CSN_B, PIN_CSN_B, PORT_IRQ_B, PIN_IRQ_B, PIN_IRQ_B_IRQn)
+	#endif
 	//!@}
 	
 	/*! \name MACROOPERATIONS
@@ -164,27 +238,32 @@
 	#define PIN_IRQ_CLEAR_FLAG(port, pin)			GLUE(PORT, port) -> PCR[pin] |= PORT_PCR_ISF_MASK	
 	//!@}
 	
-	/*! \c CE pin state flag. */
-	static _Bool CE_state;
-	/*! \c CSN pin state flag. The initial value is \c '1' */
-	static _Bool CSN_state=1;
-	
 	/*! Set or clear the \c CE pin. 
+	* \param pins - pins of the module;
 	* \param setClear - \c '1': set the \c CE pin, \c '0': clear the \c CE pin;
 	* \sa pin_CSN()
 	*/
-	void pin_CE(_Bool setClear);
+	void pin_CE(const pin_radio* pins, _Bool setClear);
 	
 	/*! Set or clear the \c CSN pin. 
+	* \param pins - pins of the module;
 	* \param setClear - \c '1': set the \c CSN pin, \c '0': clear the \c CSN pin;
 	* \sa pin_CE()
 	*/
-	void pin_CSN(_Bool setClear);
+	void pin_CSN(const pin_radio* pins, _Bool setClear);
+	
+	/*! Check and clear the interrupt flag of the \c IRQ pin.
+	* \detail Call it from the port IRQ handler for every module with the \c IRQ pin on that port.
+	* \param pins - pins of the module;
+	* \return \c '1' - the interrupt came from the module (the flag has been cleared), \c '0' - not from this module;
+	*/
+	_Bool pin_IRQ(const pin_radio* pins);
 	
-	/*! Initialize the pins. 
-	* \detail The function initializes the pins according to *PIN SETTINGS* in \c 'pinManagement.h'.
+	/*! Initialize the pins of a module. 
+	* \detail \c CE is cleared, \c CSN is set and the \c IRQ pin interrupt is enabled on the falling edge, with a pull up.
+	* \param pins - pins of the module;
 	* \sa pinManagement.h
 	*/
-	void pin_Init(void);
+	void pin_Init(const pin_radio* pins);
 
 #endif
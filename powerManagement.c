@@ -0,0 +1,133 @@
+/*! \brief The source file with the idle and low-power manager.
+*	\file powerManagement.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*	
+* This file contains the idle manager: the main loop calls power_idle() when there is no work and the core sleeps until the next interrupt (module IRQ pin, SysTick or LPTMR).
+* \par The radio is powered down during long idle periods by a replaceable policy hook (see power_setPolicy()).
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#include "powerManagement.h"
+
+static uint32_t power_lastActivity; //!< delay_micros() time stamp of the last power_activity().
+static power_policy power_radioPolicy=power_defaultPolicy; //!< Radio power policy hook.
+static nrf24_dev* power_radio; //!< The module handled by the radio power policy, \c 0 - none.
+
+/*! Switch the system clock back to the PLL after a stop mode.
+* \detail Leaving VLPS from PEE mode, the MCG is in PBE mode until the PLL locks again.
+*/
+static void power_restoreClock(void){
+	if((MCG->C6 & MCG_C6_PLLS_MASK) && (MCG->S & MCG_S_CLKST_MASK)!=MCG_S_CLKST(3)){
+		while(!(MCG->S & MCG_S_LOCK0_MASK)){;}
+		MCG->C1 &= ~MCG_C1_CLKS_MASK; //PLL output
+		while((MCG->S & MCG_S_CLKST_MASK)!=MCG_S_CLKST(3)){;}
+	}
+}
+
+/*! Enter Very Low Power Stop mode and return after the wake up.
+* \detail Called with interrupts masked; the wake up interrupt stays pending until they are unmasked.
+*/
+static void power_enterVLPS(void){
+	uint32_t elapsed;
+	
+	LPTMR0->CSR=0;
+	LPTMR0->CMR=LPTMR_CMR_COMPARE(POWER_WAKEUP_MS-1);
+	LPTMR0->CSR=LPTMR_CSR_TIE_MASK | LPTMR_CSR_TEN_MASK;
+	
+	SMC->PMCTRL=(SMC->PMCTRL & ~SMC_PMCTRL_STOPM_MASK) | SMC_PMCTRL_STOPM(2);
+	(void)SMC->PMCTRL; //the mode is set before WFI
+	SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+	__WFI();
+	SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+	power_restoreClock();
+	
+	if(LPTMR0->CSR & LPTMR_CSR_TCF_MASK){
+		elapsed=POWER_WAKEUP_MS;
+	}else{
+		LPTMR0->CNR=0; //a write latches the counter for reading
+		elapsed=LPTMR0->CNR;
+	}
+	LPTMR0->CSR=0; //stop the timer, the counter and the flag are cleared
+	delay_advance(elapsed);
+}
+
+/*! LPTMR interrupt handler - only wakes the core up from VLPS.
+*/
+void LPTMR0_IRQHandler(void){
+	LPTMR0->CSR=0;
+}
+
+/*! Initialize the power management.
+* \detail Very Low Power Stop mode is allowed (\c SMC_PMPROT is write-once after reset) and the LPTMR used to wake up from it is clocked from the 1 kHz LPO.
+* \param radio	- the module handled by the radio power policy, \c 0 - none;
+* \sa power_idle()
+*/
+void power_init(nrf24_dev* radio){
+	power_radio=radio;
+	SMC->PMPROT=SMC_PMPROT_AVLP_MASK;
+	
+	SIM->SCGC5 |= SIM_SCGC5_LPTMR_MASK;
+	LPTMR0->CSR=0;
+	LPTMR0->PSR=LPTMR_PSR_PCS(1) | LPTMR_PSR_PBYP_MASK; //LPO 1 kHz, no prescaler - 1 count per millisecond
+	NVIC_ClearPendingIRQ(LPTMR0_IRQn);
+	NVIC_SetPriority(LPTMR0_IRQn,POWER_LPTMR_IRQ_PRIORITY);
+	NVIC_EnableIRQ(LPTMR0_IRQn);
+	
+	power_lastActivity=delay_micros();
+}
+
+/*! Set the radio power policy hook.
+* \param policy	- the hook called with the idle time before every sleep; \c 0 - the radio is never powered down by the idle manager;
+* \sa power_defaultPolicy()
+*/
+void power_setPolicy(power_policy policy){
+	power_radioPolicy=policy;
+}
+
+/*! Default radio power policy.
+* \detail The radio is powered down after \c POWER_RADIO_DOWN_AFTER_MS of idle time, unless it is listening (RX mode). It is powered up again by the next transmission, before its masked section (see nRF24_powerUp()); a module driven by other code must be woken up the same way, outside of any critical section.
+* \param idleMs	- milliseconds since the last power_activity();
+* \return \c '1' - power the radio down, \c '0' - leave it as it is;
+*/
+_Bool power_defaultPolicy(uint32_t idleMs){
+	return idleMs>=POWER_RADIO_DOWN_AFTER_MS && nRF24_getState(power_radio)!=STATE_RX;
+}
+
+/*! Mark activity.
+* \detail Call it whenever the main loop has done some work; the idle time is counted from the last call.
+* \sa power_idle()
+*/
+void power_activity(void){
+	power_lastActivity=delay_micros();
+}
+
+/*! Sleep until the next interrupt if there is no work.
+* \detail The check for work is repeated with interrupts masked, so an interrupt arriving just before the sleep is not slept through; the pending handler runs right after the wake up. The core waits in Sleep (\c WFI) mode, where SysTick keeps the clock running, or - after \c POWER_VLPS_AFTER_MS of idle time with no SPI transfer running - in Very Low Power Stop mode. VLPS is left on the module IRQ pin interrupt or on the LPTMR after \c POWER_WAKEUP_MS; the PLL clock is restored and the time spent is added to the delay clock.
+* \param workPending	- a function telling if there is any work queued (e.g. lang4robots_busy());
+* \return \c '0' - not slept (work pending), \c '1' - slept in WFI mode, \c '2' - slept in VLPS mode;
+* \sa power_activity(),power_setPolicy()
+*/
+uint8_t power_idle(_Bool (*workPending)(void)){
+	uint32_t idleMs;
+	uint8_t mode=0;
+	
+	idleMs=(delay_micros()-power_lastActivity)/1000;
+	if(power_radio && power_radioPolicy && nRF24_getState(power_radio)!=STATE_POWER_DOWN && !workPending() && power_radioPolicy(idleMs)){
+		nRF24_powerDown(power_radio);
+	}
+	
+	__disable_irq();
+	if(!workPending()){
+		if(idleMs>=POWER_VLPS_AFTER_MS && !spi1_transfer_busy()){
+			power_enterVLPS();
+			mode=2;
+		}else{
+			__WFI(); //woken up by the SysTick interrupt at the latest
+			mode=1;
+		}
+	}
+	__enable_irq(); //the handler of the wake up interrupt runs here
+	
+	return mode;
+}
@@ -0,0 +1,84 @@
+/*! \brief The header file with the idle and low-power manager.
+*	\file powerManagement.h
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*	
+* This file contains the idle manager: the main loop calls power_idle() when there is no work and the core sleeps until the next interrupt (module IRQ pin, SysTick or LPTMR).
+* \par The radio is powered down during long idle periods by a replaceable policy hook (see power_setPolicy()).
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifndef POWERMANAGEMENT_H
+	#define POWERMANAGEMENT_H
+	
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
+	#include "delay.h"
+	#include "SPI.h"
+	#include "nRF24.h"
+	
+	/*! \name POWER SETTINGS
+	* Idle manager settings.
+	* @{
+	*/
+	/****************
+	* POWER SETTINGS
+	****************/
+	#define POWER_VLPS_AFTER_MS					50		//!< Idle time after which VLPS is used instead of WFI; SysTick stops in VLPS
+	#define POWER_WAKEUP_MS							1000	//!< Longest VLPS period - the LPTMR wakes the main loop up after it (1-65535)
+	#define POWER_RADIO_DOWN_AFTER_MS		1000	//!< Idle time after which power_defaultPolicy() powers the radio down
+	#define POWER_LPTMR_IRQ_PRIORITY		3			//!< LPTMR interrupt priority
+	
+	/*! Radio power policy hook type.
+	* \detail The hook gets the idle time in milliseconds and returns \c '1' if the radio should be powered down (nRF24_powerDown()).
+	* \sa power_setPolicy(),power_defaultPolicy()
+	*/
+	typedef _Bool (*power_policy)(uint32_t idleMs);
+	//!@}
+	
+	/*! \name POWER FUNCTIONS
+	* Idle manager functions.
+	* @{
+	*/
+	/*****************
+	* POWER FUNCTIONS
+	*****************/
+	/*! Initialize the power management.
+	* \detail Very Low Power Stop mode is allowed (\c SMC_PMPROT is write-once after reset) and the LPTMR used to wake up from it is clocked from the 1 kHz LPO.
+	* \param radio	- the module handled by the radio power policy, \c 0 - none;
+	* \sa power_idle()
+	*/
+	void power_init(nrf24_dev* radio);
+	
+	/*! Set the radio power policy hook.
+	* \param policy	- the hook called with the idle time before every sleep; \c 0 - the radio is never powered down by the idle manager;
+	* \sa power_defaultPolicy()
+	*/
+	void power_setPolicy(power_policy policy);
+	
+	/*! Default radio power policy.
+	* \detail The radio is powered down after \c POWER_RADIO_DOWN_AFTER_MS of idle time, unless it is listening (RX mode). It is powered up again by the next transmission, before its masked section (see nRF24_powerUp()); a module driven by other code must be woken up the same way, outside of any critical section.
+	* \param idleMs	- milliseconds since the last power_activity();
+	* \return \c '1' - power the radio down, \c '0' - leave it as it is;
+	*/
+	_Bool power_defaultPolicy(uint32_t idleMs);
+	
+	/*! Mark activity.
+	* \detail Call it whenever the main loop has done some work; the idle time is counted from the last call.
+	* \sa power_idle()
+	*/
+	void power_activity(void);
+	
+	/*! Sleep until the next interrupt if there is no work.
+	* \detail The check for work is repeated with interrupts masked, so an interrupt arriving just before the sleep is not slept through; the pending handler runs right after the wake up. The core waits in Sleep (\c WFI) mode, where SysTick keeps the clock running, or - after \c POWER_VLPS_AFTER_MS of idle time with no SPI transfer running - in Very Low Power Stop mode. VLPS is left on the module IRQ pin interrupt or on the LPTMR after \c POWER_WAKEUP_MS; the PLL clock is restored and the time spent is added to the delay clock.
+	* \param workPending	- a function telling if there is any work queued (e.g. lang4robots_busy());
+	* \return \c '0' - not slept (work pending), \c '1' - slept in WFI mode, \c '2' - slept in VLPS mode;
+	* \sa power_activity(),power_setPolicy()
+	*/
+	uint8_t power_idle(_Bool (*workPending)(void));
+	//!@}
+	
+#endif
@@ -9,6 +9,8 @@
 
 #include "slcd.h"												//Declarations
 
+#ifndef NRF24_SIM //the host build takes the display from nRF24sim.c
+
 /*----------------------------------------------------------------------------
   Function that initializes sLCD
  *----------------------------------------------------------------------------*/
@@ -277,3 +279,5 @@ void slcdDemo(void){
 		slcdClear();
 	}
 }
+
+#endif
@@ -10,7 +10,11 @@
 #ifndef slcd_h
 #define slcd_h
 
-#include "MKL46Z4.h"   /* Device header */
+#ifdef NRF24_SIM
+	#include "nRF24sim.h"
+#else
+	#include "MKL46Z4.h"   /* Device header */
+#endif
 #include "delay.h"
 
 #define LCD_N_FRONT 8
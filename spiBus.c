@@ -0,0 +1,247 @@
+/*! \brief The source file with the SPI bus manager.
+*	\file spiBus.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the definition of the device registration, the priority queues and the completion chain of the SPI1 bus manager.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#include "spiBus.h"
+
+static spiBus_xfer* spiBus_head[SPIBUS_PRIORITY_NR];	//!< First transaction of every priority queue.
+static spiBus_xfer* spiBus_tail[SPIBUS_PRIORITY_NR];	//!< Last transaction of every priority queue.
+static spiBus_xfer* volatile spiBus_active;						//!< Transaction being clocked, \c 0 - the bus is free.
+static spiBus_device* spiBus_configured;							//!< Device the peripheral is configured for, \c 0 - none.
+static int spiBus_part;																//!< Bytes of the part of \c spiBus_active being clocked.
+static spiBus_stats spiBus_stat;											//!< Statistics since spiBus_init().
+
+static void spiBus_done(void);
+
+/*! Get the highest priority queue with a transaction waiting.
+* \return \c spiBus_Priority of the queue, \c SPIBUS_PRIORITY_NR - all queues are empty;
+*/
+static uint8_t spiBus_first(void){
+	uint8_t priority;
+
+	for(priority=0; priority<SPIBUS_PRIORITY_NR; priority++){
+		if(spiBus_head[priority]){
+			break;
+		}
+	}
+
+	return priority;
+}
+
+/*! Put a transaction into the queue of its device priority.
+* \param xfer	- the transaction;
+* \param front	- \c '1' - as the first one (a suspended transaction), \c '0' - as the last one;
+*/
+static void spiBus_push(spiBus_xfer* xfer, _Bool front){
+	uint8_t priority=xfer->device->priority;
+
+	if(priority>=SPIBUS_PRIORITY_NR){
+		priority=SPIBUS_PRIORITY_NR-1;
+	}
+	if(front){
+		xfer->next=spiBus_head[priority];
+		spiBus_head[priority]=xfer;
+		if(!spiBus_tail[priority]){
+			spiBus_tail[priority]=xfer;
+		}
+		return;
+	}
+	xfer->next=0;
+	if(spiBus_tail[priority]){
+		spiBus_tail[priority]->next=xfer;
+	}else{
+		spiBus_head[priority]=xfer;
+	}
+	spiBus_tail[priority]=xfer;
+}
+
+/*! Clock the next part of the active transaction (the whole rest unless the device has a \c segment length).
+* \detail Called with the interrupts masked or from the interrupt context, with the transfer engine idle.
+*/
+static void spiBus_clock(void){
+	spiBus_xfer* xfer=spiBus_active;
+	int left=xfer->size-xfer->pos;
+
+	spiBus_part=(xfer->device->segment && left>xfer->device->segment) ? xfer->device->segment : left;
+	spi1_transfer_async(xfer->tx ? xfer->tx+xfer->pos : 0, xfer->rx ? xfer->rx+xfer->pos : 0, spiBus_part, spiBus_done); //the last call, it may complete at once
+}
+
+/*! Start the first waiting transaction, if any.
+* \detail SPI1 is reconfigured only if the device differs from the last one and has other settings.
+*/
+static void spiBus_next(void){
+	uint8_t priority=spiBus_first();
+	spiBus_xfer* xfer;
+	spiBus_device* device;
+
+	if(priority==SPIBUS_PRIORITY_NR){
+		spiBus_active=0;
+		return;
+	}
+	xfer=spiBus_head[priority];
+	spiBus_head[priority]=xfer->next;
+	if(!spiBus_head[priority]){
+		spiBus_tail[priority]=0;
+	}
+	device=xfer->device;
+	if(device!=spiBus_configured){
+		if(!spiBus_configured || device->br!=spiBus_configured->br || device->mode!=spiBus_configured->mode){
+			spi1_configure(device->br, device->mode, device->rate);
+			spiBus_stat.reconfigs++;
+		}
+		spiBus_configured=device;
+	}
+	spiBus_active=xfer;
+	xfer->state=SPIBUS_ACTIVE;
+	device->select(device,0);
+	spiBus_clock();
+}
+
+/*! Transfer engine completion hook: a part of the active transaction is in.
+* \detail The transaction goes on with its next part unless a higher priority one waits; then it is suspended (chip select released) at the front of its queue. A completed transaction is handed back and the next one is started.
+*/
+static void spiBus_done(void){
+	spiBus_xfer* xfer=spiBus_active;
+	spiBus_callback done=xfer->done;
+
+	xfer->pos+=spiBus_part;
+	spiBus_stat.bytes+=spiBus_part;
+	if(xfer->pos<xfer->size){
+		if(spiBus_first()>=xfer->device->priority){
+			spiBus_clock(); //nothing more urgent - chip select kept
+			return;
+		}
+		xfer->device->select(xfer->device,1);
+		xfer->state=SPIBUS_QUEUED;
+		spiBus_push(xfer,1);
+		spiBus_stat.preemptions++;
+	}else{
+		xfer->device->select(xfer->device,1);
+		spiBus_stat.transactions++;
+		xfer->state=SPIBUS_IDLE;
+		if(done){
+			done(xfer);
+		}
+	}
+	spiBus_next();
+}
+
+/*! Initialize SPI1 and the bus manager.
+* \detail The queues are emptied; the devices must be registered again.
+* \sa spi1init(),spiBus_register()
+*/
+void spiBus_init(void){
+	uint8_t priority;
+
+	spi1init();
+	for(priority=0; priority<SPIBUS_PRIORITY_NR; priority++){
+		spiBus_head[priority]=0;
+		spiBus_tail[priority]=0;
+	}
+	spiBus_active=0;
+	spiBus_configured=0;
+	spiBus_stat.transactions=0;
+	spiBus_stat.bytes=0;
+	spiBus_stat.reconfigs=0;
+	spiBus_stat.preemptions=0;
+}
+
+/*! Register a device.
+* \detail The \c SPI1->BR value giving the highest rate not above \c device->baud and the \c CPOL/CPHA bits are computed once; the peripheral is reconfigured the next time the bus moves to the device. Register a device again after its settings are changed.
+* \param device - the device;
+* \return the \c SCK rate achieved;
+*/
+uint32_t spiBus_register(spiBus_device* device){
+	uint32_t primask;
+
+	primask=__get_PRIMASK();
+	__disable_irq();
+	device->rate=spi_baud_compute(device->baud, SPI1_CLOCK_HZ, &device->br);
+	device->mode=(uint8_t)(((device->cpol ? 1 : 0)<<SPI_C1_CPOL_SHIFT) | ((device->cpha ? 1 : 0)<<SPI_C1_CPHA_SHIFT));
+	if(spiBus_configured==device){
+		spiBus_configured=0; //the new settings are written before the next transaction
+	}
+	__set_PRIMASK(primask);
+
+	return device->rate;
+}
+
+/*! Queue a transaction.
+* \detail The transaction is started at once if the bus is free, otherwise it waits behind the transactions of its priority queue and of the higher priority queues. Callable from the main loop and from interrupt handlers.
+* \param xfer - the transaction;
+* \return \c '0' - queued, \c '-1' - the transaction is still queued or active (error avoidance);
+* \sa spiBus_wait()
+*/
+int spiBus_submit(spiBus_xfer* xfer){
+	uint32_t primask;
+
+	primask=__get_PRIMASK();
+	__disable_irq();
+	if(xfer->state!=SPIBUS_IDLE){
+		__set_PRIMASK(primask);
+		return -1; //error avoidance
+	}
+	xfer->pos=0;
+	xfer->state=SPIBUS_QUEUED;
+	spiBus_push(xfer,0);
+	if(!spiBus_active){
+		spiBus_next();
+	}
+	__set_PRIMASK(primask);
+
+	return 0;
+}
+
+/*! Wait until a transaction is completed.
+* \detail The transfer engine is driven from here as well, so the wait ends even if the SPI1 interrupt cannot be taken (masked, or the caller is an interrupt handler of the same or a higher priority).
+* \param xfer - the transaction;
+*/
+void spiBus_wait(spiBus_xfer* xfer){
+	while(xfer->state!=SPIBUS_IDLE){
+		spi1_transfer_poll();
+	}
+}
+
+/*! Queue a transaction and wait until it is completed.
+* \param device - the device;
+* \param tx - bytes to clock out, \c 0 - NOP bytes;
+* \param rx - destination of the bytes clocked in, \c 0 - dropped;
+* \param size - amount of bytes;
+* \sa spiBus_submit(),spiBus_wait()
+*/
+void spiBus_transfer(spiBus_device* device, uint8_t* tx, uint8_t* rx, int size){
+	spiBus_xfer xfer;
+
+	xfer.device=device;
+	xfer.tx=tx;
+	xfer.rx=rx;
+	xfer.size=size;
+	xfer.done=0;
+	xfer.state=SPIBUS_IDLE;
+	spiBus_submit(&xfer);
+	spiBus_wait(&xfer);
+}
+
+/*! Check if the bus is clocking a transaction.
+* \return \c '1' - a transaction is active, \c '0' - the bus is free;
+*/
+_Bool spiBus_busy(void){
+	return spiBus_active!=0;
+}
+
+/*! Get the bus statistics.
+* \param stats - the statistics;
+*/
+void spiBus_getStats(spiBus_stats* stats){
+	uint32_t primask;
+
+	primask=__get_PRIMASK();
+	__disable_irq();
+	*stats=spiBus_stat;
+	__set_PRIMASK(primask);
+}
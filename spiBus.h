@@ -0,0 +1,159 @@
+/*! \brief The header file with the SPI bus manager.
+*	\file spiBus.h
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the SPI1 bus manager: several chip-selected devices (the radio modules, an IMU, an SD card, ...) share the bus, every one with its own clock polarity, clock phase and rate, described by a \c spiBus_device.
+* \par Transactions are described by \c spiBus_xfer and queued by spiBus_submit() from the main loop or from interrupt handlers; they are moved by the SPI1 transfer engine (\c SPI.c) one after another, and the peripheral is reconfigured only when the next transaction is for another device than the last one. Every device has a priority: a transaction waiting in a higher priority queue goes first, and a long transaction of a device with a \c segment length gives way to it between two segments, so radio frames do not stall behind long sensor reads.
+* \par spiBus_transfer() is the blocking form used by the drivers (e.g. nRF24_transaction()); it drives the transfer engine itself while it waits, so it may be called with interrupts masked and from interrupt handlers of any priority.
+* \note Once the bus manager is used, SPI1 must be reached only through it.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifndef SPIBUS_H
+	#define SPIBUS_H
+
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
+	#include "SPI.h"
+
+	/*! \name BUS TYPES
+	* @{
+	*/
+	/***********
+	* BUS TYPES
+	***********/
+	/*! Device priorities, the highest first. */
+	enum spiBus_Priority{
+		SPIBUS_PRIORITY_HIGH,		//!< latency bound traffic, e.g. radio frames
+		SPIBUS_PRIORITY_LOW,		//!< bulk traffic, e.g. sensor reads and storage
+		SPIBUS_PRIORITY_NR
+	};
+
+	/*! Transaction states. */
+	enum spiBus_State{
+		SPIBUS_IDLE,						//!< not queued (never submitted or completed)
+		SPIBUS_QUEUED,					//!< waiting for the bus
+		SPIBUS_ACTIVE						//!< being clocked
+	};
+
+	typedef struct spiBus_device spiBus_device;
+	typedef struct spiBus_xfer spiBus_xfer;
+
+	/*! Chip select hook type.
+	* \detail Called with \c '0' (\c LOW) before the first byte of a transaction and with \c '1' (\c HIGH) after the last one; from the interrupt context as well.
+	*/
+	typedef void (*spiBus_select)(spiBus_device* device, _Bool level);
+
+	/*! Completion hook type - called from the interrupt context (or from the context waiting for the bus) when the last byte of the transaction is in.
+	*/
+	typedef void (*spiBus_callback)(spiBus_xfer* xfer);
+
+	/*! Device on the bus.
+	* \detail Fill the settings with SPIBUS_DEVICE(); the clock configuration is computed by spiBus_register().
+	* \sa SPIBUS_DEVICE(),spiBus_register()
+	*/
+	struct spiBus_device{
+		spiBus_select select;		//!< drives the chip select pin of the device
+		uint32_t baud;					//!< highest \c SCK rate taken by the device
+		uint8_t cpol;						//!< clock polarity: \c 0 - \c SCK idles low, \c 1 - idles high
+		uint8_t cpha;						//!< clock phase: \c 0 - data sampled on the first \c SCK edge, \c 1 - on the second (SPI mode = cpol*2+cpha)
+		uint8_t priority;				//!< \c spiBus_Priority
+		uint16_t segment;				//!< longest part of a transaction clocked before waiting higher priority transactions are let in, \c 0 - never split
+														/*!< \note The chip select is released between the parts, so set it only for devices which keep their state across a chip select pulse. */
+		uint8_t br;							//!< \c SPI1->BR value, set by spiBus_register()
+		uint8_t mode;						//!< \c SPI1->C1 \c CPOL and \c CPHA bits, set by spiBus_register()
+		uint32_t rate;					//!< \c SCK rate achieved, set by spiBus_register()
+	};
+
+	/*! Static initializer of a device.
+	* \detail The settings are given by name; the fields set by spiBus_register() start zeroed.
+	* \param selectHook - chip select hook;
+	* \param maxBaud - highest \c SCK rate of the device;
+	* \param polarity - clock polarity;
+	* \param phase - clock phase;
+	* \param prio - \c spiBus_Priority;
+	* \param segmentLen - longest part of a transaction, \c 0 - never split;
+	*/
+	#define SPIBUS_DEVICE(selectHook,maxBaud,polarity,phase,prio,segmentLen)	{.select=(selectHook),.baud=(maxBaud),.cpol=(polarity),.cpha=(phase),.priority=(prio),.segment=(segmentLen)}
+
+	/*! Transaction.
+	* \detail Set \c device, \c tx, \c rx, \c size and \c done, and \c state to \c SPIBUS_IDLE before the first submit (a static or zeroed structure is); the rest belongs to the bus manager until the transaction is completed (\c state back to \c SPIBUS_IDLE). The structure and the buffers must stay valid until then.
+	*/
+	struct spiBus_xfer{
+		spiBus_device* device;		//!< the device
+		uint8_t* tx;							//!< bytes to clock out, \c 0 - NOP bytes (\c SPI1_DUMMY_BYTE)
+		uint8_t* rx;							//!< destination of the bytes clocked in, \c 0 - dropped
+		int size;									//!< amount of bytes
+		spiBus_callback done;			//!< completion hook, \c 0 - none
+		volatile uint8_t state;		//!< \c spiBus_State
+		int pos;									//!< bytes already clocked
+		spiBus_xfer* next;				//!< next transaction of the same priority queue
+	};
+
+	/*! Bus statistics since spiBus_init(). */
+	typedef struct{
+		uint32_t transactions;		//!< transactions completed
+		uint32_t bytes;						//!< bytes clocked
+		uint32_t reconfigs;				//!< peripheral reconfigurations (device changes with other settings)
+		uint32_t preemptions;			//!< segmented transactions suspended for a higher priority one
+	}spiBus_stats;
+	//!@}
+
+	/*! \name BUS FUNCTIONS
+	* @{
+	*/
+	/***************
+	* BUS FUNCTIONS
+	***************/
+	/*! Initialize SPI1 and the bus manager.
+	* \detail The queues are emptied; the devices must be registered again.
+	* \sa spi1init(),spiBus_register()
+	*/
+	void spiBus_init(void);
+
+	/*! Register a device.
+	* \detail The \c SPI1->BR value giving the highest rate not above \c device->baud and the \c CPOL/CPHA bits are computed once; the peripheral is reconfigured the next time the bus moves to the device. Register a device again after its settings are changed.
+	* \param device - the device;
+	* \return the \c SCK rate achieved;
+	*/
+	uint32_t spiBus_register(spiBus_device* device);
+
+	/*! Queue a transaction.
+	* \detail The transaction is started at once if the bus is free, otherwise it waits behind the transactions of its priority queue and of the higher priority queues. Callable from the main loop and from interrupt handlers.
+	* \param xfer - the transaction;
+	* \return \c '0' - queued, \c '-1' - the transaction is still queued or active (error avoidance);
+	* \sa spiBus_wait()
+	*/
+	int spiBus_submit(spiBus_xfer* xfer);
+
+	/*! Wait until a transaction is completed.
+	* \detail The transfer engine is driven from here as well, so the wait ends even if the SPI1 interrupt cannot be taken (masked, or the caller is an interrupt handler of the same or a higher priority).
+	* \param xfer - the transaction;
+	*/
+	void spiBus_wait(spiBus_xfer* xfer);
+
+	/*! Queue a transaction and wait until it is completed.
+	* \param device - the device;
+	* \param tx - bytes to clock out, \c 0 - NOP bytes;
+	* \param rx - destination of the bytes clocked in, \c 0 - dropped;
+	* \param size - amount of bytes;
+	* \sa spiBus_submit(),spiBus_wait()
+	*/
+	void spiBus_transfer(spiBus_device* device, uint8_t* tx, uint8_t* rx, int size);
+
+	/*! Check if the bus is clocking a transaction.
+	* \return \c '1' - a transaction is active, \c '0' - the bus is free;
+	*/
+	_Bool spiBus_busy(void);
+
+	/*! Get the bus statistics.
+	* \param stats - the statistics;
+	*/
+	void spiBus_getStats(spiBus_stats* stats);
+	//!@}
+
+#endif
@@ -0,0 +1,223 @@
+/*! \brief The source file with the host SPI test program.
+*	\file spiHost.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the host program checking the SPI1 layer against the SPI1 model of the simulator: the transfer engine (spi1_transfer_async(), spi1_transfer_poll()) with the interrupt taken and with \c PRIMASK set, the baud rate computation (spi_baud_compute()) and the bus manager (spiBus_submit(), priorities, segments and device reconfiguration). Module 0 is the only device with a radio behind it.
+* \par Build (Linux): <tt>cc -DNRF24_SIM -o spitest spiHost.c nRF24.c nRF24sim.c delay.c spiTrace.c SPI.c spiBus.c pinManagement.c</tt>
+* \par Run: <tt>./spitest</tt> - one line per failed check, the amount of failed checks is printed last and returned as the exit code.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifdef NRF24_SIM
+
+#include <stdio.h>
+#include <string.h>
+#include "nRF24.h"
+
+#define SPIHOST_STATUS_RESET	0x0E		//!< \c STATUS reset value of the module
+#define SPIHOST_LONG_LEN			33			//!< bytes of the long transfer (\c R_RX_PAYLOAD with a full payload)
+#define SPIHOST_SENSOR_LEN		64			//!< bytes of the segmented transaction
+#define SPIHOST_LOG_LEN				32			//!< chip select events recorded
+#define SPIHOST_MODE_MASK			((1 << SPI_C1_CPOL_SHIFT) | (1 << SPI_C1_CPHA_SHIFT))	//!< \c SPI1->C1 bits of the SPI mode
+
+static int spiHost_failed;				//!< failed checks
+static int spiHost_done;					//!< completion hook calls
+static nrf24_dev spiHost_radio=nRF24_DEV(PIN_RADIO_A);	//!< driver instance of module 0
+static char spiHost_log[SPIHOST_LOG_LEN+1];	//!< chip select events: \c 'R'/'r' - radio low/high, \c 'S'/'s' - sensor low/high, \c 'D' - sensor done
+static uint8_t spiHost_logLen;		//!< events in \c spiHost_log
+static _Bool spiHost_radioLow;			//!< radio chip select is low
+static _Bool spiHost_sensorLow;		//!< sensor chip select is low
+static _Bool spiHost_overlap;			//!< both chip selects were low at once
+static _Bool spiHost_sensorConfig;	//!< \c SPI1->BR and \c SPI1->C1 held the sensor settings whenever it was selected
+
+static void spiHost_sensorSelect(spiBus_device* device, _Bool level);
+static spiBus_device spiHost_sensor=SPIBUS_DEVICE(spiHost_sensorSelect,1000000,1,1,SPIBUS_PRIORITY_LOW,16);	//!< device without a module: mode 3, 1 MHz, split every 16 bytes
+
+/*! Record a check.
+* \param ok - result of the check;
+* \param what - description printed when the check failed;
+*/
+static void spiHost_check(_Bool ok, const char* what){
+	if(!ok){
+		printf("FAIL: %s\n",what);
+		spiHost_failed++;
+	}
+}
+
+/*! Add a chip select event to the log.
+*/
+static void spiHost_event(char event){
+	if(spiHost_logLen<SPIHOST_LOG_LEN){
+		spiHost_log[spiHost_logLen++]=event;
+	}
+}
+
+/*! Completion hook of the transfer engine.
+*/
+static void spiHost_engineDone(void){
+	spiHost_done++;
+}
+
+/*! Chip select hook of the radio - logs the edge and frames the module transaction.
+*/
+static void spiHost_radioSelect(spiBus_device* device, _Bool level){
+	spiHost_event(level ? 'r' : 'R');
+	spiHost_radioLow=!level;
+	spiHost_overlap|=spiHost_radioLow && spiHost_sensorLow;
+	nRF24_select(device,level);
+}
+
+/*! Chip select hook of the sensor.
+*/
+static void spiHost_sensorSelect(spiBus_device* device, _Bool level){
+	spiHost_event(level ? 's' : 'S');
+	spiHost_sensorLow=!level;
+	spiHost_overlap|=spiHost_radioLow && spiHost_sensorLow;
+	if(!level && (SPI1->BR!=device->br || (SPI1->C1 & SPIHOST_MODE_MASK)!=device->mode)){
+		spiHost_sensorConfig=0;
+	}
+}
+
+/*! Completion hook of the sensor transaction.
+*/
+static void spiHost_sensorDone(spiBus_xfer* xfer){
+	(void)xfer;
+	spiHost_event('D');
+}
+
+/*! Transfer engine: interrupt driven and driven by spi1_transfer_poll() with \c PRIMASK set.
+*/
+static void spiHost_engine(void){
+	uint8_t tx[SPIHOST_LONG_LEN],rx[SPIHOST_LONG_LEN],i;
+	const nRF24sim_spiStats* stats=nRF24sim_getSpiStats();
+	uint32_t irqs;
+
+	pin_CSN(&spiHost_radio.pins,0);
+	tx[0]=W_REGISTER | TX_ADDR;
+	for(i=1;i<=5;i++){
+		tx[i]=0xA0+i;
+	}
+	memset(rx,0,sizeof(rx));
+	spiHost_done=0;
+	irqs=stats->irqs;
+	spiHost_check(spi1_transfer_async(tx,rx,6,spiHost_engineDone)==0,"engine: start");
+	spiHost_check(!spi1_transfer_busy() && spiHost_done==1,"engine: interrupt driven transfer completed once");
+	spiHost_check(stats->irqs-irqs==2,"engine: one interrupt per FIFO chunk");
+	spiHost_check(rx[0]==SPIHOST_STATUS_RESET,"engine: STATUS clocked in first");
+	pin_CSN(&spiHost_radio.pins,1);
+
+	pin_CSN(&spiHost_radio.pins,0);
+	memset(tx,NOP,sizeof(tx));
+	tx[0]=R_REGISTER | TX_ADDR;
+	memset(rx,0,sizeof(rx));
+	__disable_irq();
+	spiHost_check(spi1_transfer_async(tx,rx,6,spiHost_engineDone)==0,"engine: start with PRIMASK set");
+	spiHost_check(spi1_transfer_busy(),"engine: no progress with PRIMASK set");
+	spiHost_check(spi1_transfer_async(tx,rx,6,spiHost_engineDone)==-1,"engine: busy engine refuses a transfer");
+	while(spi1_transfer_poll()){
+	}
+	__enable_irq();
+	pin_CSN(&spiHost_radio.pins,1);
+	spiHost_check(spiHost_done==2,"engine: polled transfer completed once");
+	for(i=1;i<=5;i++){
+		spiHost_check(rx[i]==0xA0+i,"engine: TX_ADDR read back in order");
+	}
+
+	pin_CSN(&spiHost_radio.pins,0);
+	memset(rx,0,sizeof(rx));
+	spiHost_check(spi1_transfer_async(0,rx,SPIHOST_LONG_LEN,spiHost_engineDone)==0,"engine: start without TX data");
+	pin_CSN(&spiHost_radio.pins,1);
+	spiHost_check(spiHost_done==3 && rx[0]==SPIHOST_STATUS_RESET,"engine: NOP bytes clocked out");
+
+	spiHost_check(spi1_transfer_async(tx,rx,0,spiHost_engineDone)==0 && spiHost_done==4,"engine: empty transfer completed at once");
+	spiHost_check(!stats->overflows && !stats->underflows && stats->maxFill<=4,"engine: RX FIFO never overrun or underrun");
+}
+
+/*! Baud rate computation against every SPPR/SPR pair.
+*/
+static void spiHost_baud(void){
+	static const uint32_t clocks[]={SPI1_CLOCK_HZ,24000000,20971520};
+	uint32_t target,rate,best,div;
+	uint8_t c,sppr,spr,br;
+
+	for(c=0;c<sizeof(clocks)/sizeof(clocks[0]);c++){
+		for(target=1000;target<=clocks[c];target+=target/7+1){
+			best=0;
+			for(spr=0;spr<=8;spr++){
+				for(sppr=0;sppr<=7;sppr++){
+					div=(uint32_t)(sppr+1)<<(spr+1);
+					if(clocks[c]/div<=target && clocks[c]/div>best){
+						best=clocks[c]/div;
+					}
+				}
+			}
+			if(!best){
+				best=clocks[c]/4096;
+			}
+			rate=spi_baud_compute(target,clocks[c],&br);
+			spiHost_check(rate==best,"baud: highest rate not above the target");
+			spiHost_check(rate==clocks[c]/((uint32_t)(((br>>4) & 0x07)+1)<<((br & 0x0F)+1)),"baud: BR value gives the rate returned");
+		}
+	}
+	spiHost_check(spi_baud_compute(0,SPI1_CLOCK_HZ,&br)==SPI1_CLOCK_HZ/4096,"baud: slowest rate for a zero target");
+	rate=spi1_set_baud(nRF24_SPI_HZ,SPI1_CLOCK_HZ);
+	spiHost_check(rate<=nRF24_SPI_HZ && spi1_get_baud()==rate,"baud: rate set");
+}
+
+/*! Bus manager: a high priority transaction is let in between the segments of a low priority one.
+*/
+static void spiHost_bus(void){
+	static uint8_t sensorRX[SPIHOST_SENSOR_LEN],radioTX[2]={R_REGISTER | RF_CH,NOP},radioRX[2];
+	static spiBus_xfer sensorXfer,radioXfer;
+	spiBus_stats stats;
+
+	spiHost_radio.bus.select=spiHost_radioSelect;
+	spiBus_register(&spiHost_sensor);
+	spiHost_sensorConfig=1;
+	spiHost_logLen=0;
+	memset(spiHost_log,0,sizeof(spiHost_log));
+
+	sensorXfer.device=&spiHost_sensor;
+	sensorXfer.rx=sensorRX;
+	sensorXfer.size=SPIHOST_SENSOR_LEN;
+	sensorXfer.done=spiHost_sensorDone;
+	radioXfer.device=&spiHost_radio.bus;
+	radioXfer.tx=radioTX;
+	radioXfer.rx=radioRX;
+	radioXfer.size=2;
+	__disable_irq();
+	spiHost_check(spiBus_submit(&sensorXfer)==0,"bus: sensor queued");
+	spiHost_check(spiBus_submit(&radioXfer)==0,"bus: radio queued");
+	spiHost_check(spiBus_submit(&sensorXfer)==-1,"bus: active transaction refused");
+	__enable_irq();
+	spiBus_wait(&sensorXfer);
+	spiBus_wait(&radioXfer);
+	spiHost_radio.bus.select=nRF24_select;
+
+	spiBus_getStats(&stats);
+	spiHost_check(!spiBus_busy(),"bus: free after both transactions");
+	spiHost_check(stats.preemptions>=1,"bus: sensor transaction preempted by the radio");
+	spiHost_check(stats.reconfigs>=2,"bus: peripheral reconfigured for every device change");
+	spiHost_check(strchr(spiHost_log,'R') && strchr(spiHost_log,'R')<strrchr(spiHost_log,'D'),"bus: radio served before the sensor transaction ended");
+	spiHost_check(!spiHost_overlap,"bus: never two devices selected at once");
+	spiHost_check(spiHost_sensorConfig,"bus: sensor settings active when selected");
+	spiHost_check(radioRX[1]==nRF24_getRegister(&spiHost_radio,RF_CH),"bus: radio transaction read RF_CH");
+}
+
+int main(void){
+	nRF24sim_reset();
+	nRF24sim_addNode();
+	spiBus_init();
+	pin_Init(&spiHost_radio.pins);
+
+	spiHost_engine();
+	spiHost_baud();
+	nRF24_init(&spiHost_radio);
+	spiHost_bus();
+
+	printf("%d failed\n",spiHost_failed);
+	return spiHost_failed;
+}
+
+#endif
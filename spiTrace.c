@@ -0,0 +1,288 @@
+/*! \brief The source file with the SPI transaction trace recorder.
+*	\file spiTrace.c
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the definition of the trace hooks, the ring buffer and the bus utilisation report.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#include <stdio.h>
+#include "spiTrace.h"
+#include "nRF24L01P.h"
+#include "delay.h"
+
+static spiTrace_record spiTrace_ring[SPI_TRACE_LEN];	//!< Ring buffer.
+static volatile uint32_t spiTrace_head;								//!< Records written since spiTrace_clear().
+static uint8_t spiTrace_stack[SPI_TRACE_DEPTH];				//!< Traced API calls in progress.
+static uint32_t spiTrace_stackStart[SPI_TRACE_DEPTH];
+static volatile uint8_t spiTrace_depth;
+static _Bool spiTrace_open;														//!< \c CSN is low.
+static uint32_t spiTrace_start;												//!< Start of the current transaction.
+static uint8_t spiTrace_curOp;												//!< Instruction of the current transaction.
+static uint8_t spiTrace_len;													//!< Bytes of the current transaction.
+
+static const char* const spiTrace_opNames[SPI_TRACE_OP_NR]={"R_REGISTER","W_REGISTER","R_RX_PAYLOAD","W_TX_PAYLOAD","W_TX_PAYLOAD_NOACK","W_ACK_PAYLOAD","R_RX_PL_WID","FLUSH","NOP","OTHER"};
+static const char* const spiTrace_apiNames[SPI_TRACE_API_NR]={"none","nRF24_init","nRF24_streamService","lang4robots_sendCommand","lang4robots_sendCommandAndWait","lang4robots_flush","lang4robots_receiveFrames","lang4robots_poll"};
+
+/*! Get the innermost traced API call.
+*/
+static uint8_t spiTrace_currentApi(void){
+	uint8_t depth=spiTrace_depth;
+
+	if(depth==0){
+		return SPI_TRACE_API_NONE;
+	}
+	return depth<=SPI_TRACE_DEPTH ? spiTrace_stack[depth-1] : spiTrace_stack[SPI_TRACE_DEPTH-1];
+}
+
+/*! Store a record; the interrupts are masked, so records may come from the IRQ handlers too.
+*/
+static void spiTrace_put(uint8_t kind, uint8_t op, uint8_t len, uint8_t api, uint32_t start, uint32_t end){
+	uint32_t primask=__get_PRIMASK();
+	spiTrace_record* record;
+
+	__disable_irq();
+	record=&spiTrace_ring[spiTrace_head & (SPI_TRACE_LEN-1)];
+	record->start=start;
+	record->duration=end-start;
+	record->kind=kind;
+	record->op=op;
+	record->len=len;
+	record->api=api;
+	spiTrace_head++;
+	__set_PRIMASK(primask);
+}
+
+static uint8_t spiTrace_class(uint8_t op){
+	if(op<=(R_REGISTER | 0x1F)){
+		return SPI_TRACE_OP_R_REGISTER;
+	}
+	if(op<=(W_REGISTER | 0x1F)){
+		return SPI_TRACE_OP_W_REGISTER;
+	}
+	if((op & 0xF8)==W_ACK_PAYLOAD){
+		return SPI_TRACE_OP_W_ACK_PAYLOAD;
+	}
+	switch(op){
+		case R_RX_PAYLOAD:
+			return SPI_TRACE_OP_R_RX_PAYLOAD;
+		case W_TX_PAYLOAD:
+			return SPI_TRACE_OP_W_TX_PAYLOAD;
+		case W_TX_PAYLOAD_NOACK:
+			return SPI_TRACE_OP_W_TX_PAYLOAD_NOACK;
+		case R_RX_PL_WID:
+			return SPI_TRACE_OP_R_RX_PL_WID;
+		case FLUSH_TX:
+		case FLUSH_RX:
+			return SPI_TRACE_OP_FLUSH;
+		case NOP:
+			return SPI_TRACE_OP_NOP;
+		default:
+			return SPI_TRACE_OP_OTHER;
+	}
+}
+
+/*! \c CSN hook: a low level starts a transaction, a high level ends it.
+* \param level - \c CSN pin level;
+*/
+void spiTrace_csn(_Bool level){
+	uint32_t now=delay_micros();
+
+	if(!level){
+		if(!spiTrace_open){
+			spiTrace_open=1;
+			spiTrace_start=now;
+			spiTrace_curOp=NOP;
+			spiTrace_len=0;
+		}
+	}else if(spiTrace_open){
+		spiTrace_open=0;
+		if(spiTrace_len){
+			spiTrace_put(SPI_TRACE_TRANSACTION,spiTrace_curOp,spiTrace_len,spiTrace_currentApi(),spiTrace_start,now);
+		}
+	}
+}
+
+/*! Byte hook: count the bytes of the current transaction; the first one is the instruction.
+* \param tx - bytes clocked out, \c 0 - NOP bytes;
+* \param size - amount of bytes;
+*/
+void spiTrace_bytes(const uint8_t* tx, int size){
+	if(!spiTrace_open || size<=0){
+		return;
+	}
+	if(spiTrace_len==0){
+		spiTrace_curOp=tx ? tx[0] : NOP;
+	}
+	spiTrace_len=(spiTrace_len+size>0xFF) ? 0xFF : spiTrace_len+size;
+}
+
+/*! Delay hook: record the time waited since \c start.
+* \param start - delay_micros() time stamp taken when the delay started;
+*/
+void spiTrace_delay(uint32_t start){
+	uint32_t now=delay_micros();
+
+	if(now!=start){
+		spiTrace_put(SPI_TRACE_DELAY,0,0,spiTrace_currentApi(),start,now);
+	}
+}
+
+/*! API call hook: the call starts; the records made until spiTrace_end() belong to it.
+* \param api - \c spiTrace_api value;
+* \sa spiTrace_end()
+*/
+void spiTrace_begin(uint8_t api){
+	uint32_t primask=__get_PRIMASK();
+
+	__disable_irq();
+	if(spiTrace_depth<SPI_TRACE_DEPTH){
+		spiTrace_stack[spiTrace_depth]=api;
+		spiTrace_stackStart[spiTrace_depth]=delay_micros();
+	}
+	spiTrace_depth++; //deeper calls are counted, but belong to the deepest traced one
+	__set_PRIMASK(primask);
+}
+
+/*! API call hook: the innermost traced call ends.
+* \sa spiTrace_begin()
+*/
+void spiTrace_end(void){
+	uint32_t primask=__get_PRIMASK();
+	uint8_t depth;
+
+	__disable_irq();
+	depth=--spiTrace_depth;
+	__set_PRIMASK(primask);
+	if(depth<SPI_TRACE_DEPTH){
+		spiTrace_put(SPI_TRACE_CALL,spiTrace_stack[depth],0,spiTrace_currentApi(),spiTrace_stackStart[depth],delay_micros());
+	}
+}
+
+/*! Clear the ring buffer.
+*/
+void spiTrace_clear(void){
+	spiTrace_head=0;
+}
+
+/*! Dump the ring buffer, the oldest record first.
+* \param emit - called with every record;
+* \return amount of records dumped;
+*/
+uint16_t spiTrace_dump(void (*emit)(const spiTrace_record* record)){
+	uint32_t head=spiTrace_head;
+	uint32_t i=(head>SPI_TRACE_LEN) ? head-SPI_TRACE_LEN : 0;
+	uint16_t dumped=0;
+
+	for(; i<head; i++){
+		emit(&spiTrace_ring[i & (SPI_TRACE_LEN-1)]);
+		dumped++;
+	}
+
+	return dumped;
+}
+
+/*! Compute the report over the records in the ring buffer.
+* \param report - the report;
+* \sa spiTrace_print()
+*/
+void spiTrace_summarize(spiTrace_report* report){
+	uint32_t head=spiTrace_head;
+	uint32_t i=(head>SPI_TRACE_LEN) ? head-SPI_TRACE_LEN : 0;
+	int32_t first=0,last=0,start;
+	uint32_t base=spiTrace_ring[i & (SPI_TRACE_LEN-1)].start;
+	const spiTrace_record* record;
+	uint8_t k;
+
+	report->windowUs=0;
+	report->busyUs=0;
+	report->delayUs=0;
+	report->transactions=0;
+	report->bytes=0;
+	report->dropped=(head>SPI_TRACE_LEN) ? head-SPI_TRACE_LEN : 0;
+	for(k=0; k<SPI_TRACE_OP_NR; k++){
+		report->op[k].count=0;
+		report->op[k].us=0;
+		report->op[k].bytes=0;
+	}
+	for(k=0; k<SPI_TRACE_API_NR; k++){
+		report->api[k].calls=0;
+		report->api[k].wallUs=0;
+		report->api[k].spiUs=0;
+		report->api[k].delayUs=0;
+		report->api[k].bytes=0;
+	}
+	for(; i<head; i++){
+		record=&spiTrace_ring[i & (SPI_TRACE_LEN-1)];
+		start=(int32_t)(record->start-base); //the clock may wrap within the window
+		if(start<first){
+			first=start;
+		}
+		if(start+(int32_t)record->duration>last){
+			last=start+(int32_t)record->duration;
+		}
+		switch(record->kind){
+			case SPI_TRACE_TRANSACTION:
+				k=spiTrace_class(record->op);
+				report->busyUs+=record->duration;
+				report->transactions++;
+				report->bytes+=record->len;
+				report->op[k].count++;
+				report->op[k].us+=record->duration;
+				report->op[k].bytes+=record->len;
+				report->api[record->api].spiUs+=record->duration;
+				report->api[record->api].bytes+=record->len;
+				break;
+			case SPI_TRACE_DELAY:
+				report->delayUs+=record->duration;
+				report->api[record->api].delayUs+=record->duration;
+				break;
+			default:
+				if(record->op<SPI_TRACE_API_NR){
+					report->api[record->op].calls++;
+					report->api[record->op].wallUs+=record->duration;
+				}
+				break;
+		}
+	}
+	report->windowUs=last-first;
+}
+
+/*! Print the report as CSV lines.
+* \param emit - called with every line;
+* \sa spiTrace_summarize()
+*/
+void spiTrace_print(void (*emit)(const char* line)){
+	static spiTrace_report report; //kept off the stack
+	char line[SPI_TRACE_LINE_LEN];
+	uint32_t window;
+	uint8_t k;
+
+	spiTrace_summarize(&report);
+	window=report.windowUs ? report.windowUs : 1;
+	emit("bus,window_us,busy_us,delay_us,busy_permille,delay_permille,transactions,bytes,dropped");
+	snprintf(line,sizeof(line),"bus,%lu,%lu,%lu,%lu,%lu,%u,%lu,%lu",(unsigned long)report.windowUs,(unsigned long)report.busyUs,(unsigned long)report.delayUs,
+		(unsigned long)((uint64_t)report.busyUs*1000/window),(unsigned long)((uint64_t)report.delayUs*1000/window),report.transactions,(unsigned long)report.bytes,(unsigned long)report.dropped);
+	emit(line);
+	if(report.dropped){
+		emit("truncated,dropped,kept");
+		snprintf(line,sizeof(line),"truncated,%lu,%u",(unsigned long)report.dropped,SPI_TRACE_LEN);
+		emit(line);
+	}
+	emit("op,name,count,bytes,us");
+	for(k=0; k<SPI_TRACE_OP_NR; k++){
+		if(report.op[k].count){
+			snprintf(line,sizeof(line),"op,%s,%u,%lu,%lu",spiTrace_opNames[k],report.op[k].count,(unsigned long)report.op[k].bytes,(unsigned long)report.op[k].us);
+			emit(line);
+		}
+	}
+	emit("api,name,calls,wall_us,spi_us,delay_us,other_us");
+	for(k=0; k<SPI_TRACE_API_NR; k++){
+		if(report.api[k].calls){
+			snprintf(line,sizeof(line),"api,%s,%u,%lu,%lu,%lu,%ld",spiTrace_apiNames[k],report.api[k].calls,(unsigned long)report.api[k].wallUs,(unsigned long)report.api[k].spiUs,
+				(unsigned long)report.api[k].delayUs,report.api[k].calls ? (long)report.api[k].wallUs-(long)report.api[k].spiUs-(long)report.api[k].delayUs : 0L);
+			emit(line);
+		}
+	}
+}
@@ -0,0 +1,195 @@
+/*! \brief The header file with the SPI transaction trace recorder.
+*	\file spiTrace.h
+*	\author \c Sebastian \c Pisklak & \c Jakub \c Olak
+*
+* This file contains the SPI trace recorder and the bus utilisation report. With \b SPI_TRACE set to \c 1, every \c CSN framed transaction is time stamped and stored with its instruction and byte count in a ring buffer, together with the time spent in delay functions and the time spent in the main driver and lang4robots API calls.
+* \par The hooks are placed in pin_CSN(), spi1_byte_send(), spi1_read_byte(), spi1_transfer_async(), delay_until() and delay_ms() (and in the host versions of the pin and delay functions in \c nRF24sim.c). With \b SPI_TRACE set to \c 0 (default) they are compiled out.
+*
+* \b Copyright: Sebastian Pisklak & Jakub Olak
+*/
+
+#ifndef SPITRACE_H
+	#define SPITRACE_H
+
+	#ifdef NRF24_SIM
+		#include "nRF24sim.h"
+	#else
+		#include "MKL46Z4.h"
+	#endif
+
+	/*! \name TRACE SETTINGS
+	* @{
+	*/
+	/****************
+	* TRACE SETTINGS
+	****************/
+	#ifndef SPI_TRACE
+		#define SPI_TRACE					0		//!< \c 1 - record the trace, \c 0 - the hooks are compiled out
+	#endif
+	#define SPI_TRACE_LEN					1024	//!< Ring buffer length in records (power of 2, 12 bytes each); the oldest records are overwritten. Holds a whole bench_runOne() point without packet loss (up to about 650 records)
+	#define SPI_TRACE_DEPTH				4		//!< Deepest nesting of traced API calls (interrupts included)
+	#define SPI_TRACE_LINE_LEN		96	//!< Line buffer size used by spiTrace_print()
+	//!@}
+
+	/*! \name TRACE TYPES
+	* @{
+	*/
+	/*************
+	* TRACE TYPES
+	*************/
+	/*! Record kinds. */
+	typedef enum{
+		SPI_TRACE_TRANSACTION,	//!< \c CSN framed transaction; \c op is the instruction byte
+		SPI_TRACE_DELAY,				//!< time spent in delay_until() or delay_ms()
+		SPI_TRACE_CALL					//!< traced API call; \c op is the \c spiTrace_api value
+	}spiTrace_kind;
+
+	/*! Traced API calls. */
+	typedef enum{
+		SPI_TRACE_API_NONE,						//!< outside of any traced call
+		SPI_TRACE_API_NRF24_INIT,			//!< nRF24_init()
+		SPI_TRACE_API_STREAM_SERVICE,	//!< nRF24_streamService()
+		SPI_TRACE_API_SEND_COMMAND,		//!< lang4robots_sendCommandWithArgs() (and lang4robots_sendCommand())
+		SPI_TRACE_API_SEND_AND_WAIT,	//!< lang4robots_sendCommandAndWait()
+		SPI_TRACE_API_FLUSH,					//!< lang4robots_flush()
+		SPI_TRACE_API_RECEIVE_FRAMES,	//!< lang4robots_receiveFrames()
+		SPI_TRACE_API_POLL,						//!< lang4robots_poll()
+		SPI_TRACE_API_NR
+	}spiTrace_api;
+
+	/*! Instruction classes of the report. */
+	typedef enum{
+		SPI_TRACE_OP_R_REGISTER,
+		SPI_TRACE_OP_W_REGISTER,
+		SPI_TRACE_OP_R_RX_PAYLOAD,
+		SPI_TRACE_OP_W_TX_PAYLOAD,
+		SPI_TRACE_OP_W_TX_PAYLOAD_NOACK,
+		SPI_TRACE_OP_W_ACK_PAYLOAD,
+		SPI_TRACE_OP_R_RX_PL_WID,
+		SPI_TRACE_OP_FLUSH,
+		SPI_TRACE_OP_NOP,
+		SPI_TRACE_OP_OTHER,
+		SPI_TRACE_OP_NR
+	}spiTrace_op;
+
+	/*! Trace record. */
+	typedef struct{
+		uint32_t start;			//!< delay_micros() time stamp
+		uint32_t duration;	//!< microseconds
+		uint8_t kind;				//!< \c spiTrace_kind
+		uint8_t op;					//!< instruction byte or \c spiTrace_api value
+		uint8_t len;				//!< bytes exchanged, instruction included
+		uint8_t api;				//!< innermost traced API call the record belongs to
+	}spiTrace_record;
+
+	/*! Costs of a traced API call. */
+	typedef struct{
+		uint16_t calls;
+		uint32_t wallUs;		//!< time inside the call (nested calls and interrupts included)
+		uint32_t spiUs;			//!< time of the transactions made directly by the call
+		uint32_t delayUs;		//!< time waited directly by the call
+		uint32_t bytes;			//!< bytes exchanged directly by the call
+	}spiTrace_apiCost;
+
+	/*! Costs of an instruction class. */
+	typedef struct{
+		uint16_t count;
+		uint32_t us;
+		uint32_t bytes;
+	}spiTrace_opCost;
+
+	/*! Report over the records in the ring buffer. */
+	typedef struct{
+		uint32_t windowUs;			//!< from the oldest record start to the newest record end
+		uint32_t busyUs;				//!< time with \c CSN low
+		uint32_t delayUs;				//!< time in delay functions (interrupts during delays included)
+		uint16_t transactions;
+		uint32_t bytes;
+		uint32_t dropped;				//!< records overwritten since spiTrace_clear()
+		spiTrace_opCost op[SPI_TRACE_OP_NR];
+		spiTrace_apiCost api[SPI_TRACE_API_NR];
+	}spiTrace_report;
+	//!@}
+
+	/*! \name TRACE HOOKS
+	* The hooks placed in the SPI, pin and delay layers and in the traced API calls.
+	* @{
+	*/
+	/*************
+	* TRACE HOOKS
+	*************/
+	#if SPI_TRACE
+		#define SPI_TRACE_CSN(level)				spiTrace_csn(level)
+		#define SPI_TRACE_BYTES(tx,size)		spiTrace_bytes(tx,size)
+		#define SPI_TRACE_DELAY(start)			spiTrace_delay(start)
+		#define SPI_TRACE_BEGIN(api)				spiTrace_begin(api)
+		#define SPI_TRACE_END()							spiTrace_end()
+		#define SPI_TRACE_NOW()							delay_micros()
+	#else
+		#define SPI_TRACE_CSN(level)				((void)0)
+		#define SPI_TRACE_BYTES(tx,size)		((void)0)
+		#define SPI_TRACE_DELAY(start)			((void)(start))
+		#define SPI_TRACE_BEGIN(api)				((void)0)
+		#define SPI_TRACE_END()							((void)0)
+		#define SPI_TRACE_NOW()							0
+	#endif
+	//!@}
+
+	/*! \name TRACE FUNCTIONS
+	* @{
+	*/
+	/*****************
+	* TRACE FUNCTIONS
+	*****************/
+	/*! \c CSN hook: a low level starts a transaction, a high level ends it.
+	* \param level - \c CSN pin level;
+	*/
+	void spiTrace_csn(_Bool level);
+
+	/*! Byte hook: count the bytes of the current transaction; the first one is the instruction.
+	* \param tx - bytes clocked out, \c 0 - NOP bytes;
+	* \param size - amount of bytes;
+	*/
+	void spiTrace_bytes(const uint8_t* tx, int size);
+
+	/*! Delay hook: record the time waited since \c start.
+	* \param start - delay_micros() time stamp taken when the delay started;
+	*/
+	void spiTrace_delay(uint32_t start);
+
+	/*! API call hook: the call starts; the records made until spiTrace_end() belong to it.
+	* \param api - \c spiTrace_api value;
+	* \sa spiTrace_end()
+	*/
+	void spiTrace_begin(uint8_t api);
+
+	/*! API call hook: the innermost traced call ends.
+	* \sa spiTrace_begin()
+	*/
+	void spiTrace_end(void);
+
+	/*! Clear the ring buffer.
+	*/
+	void spiTrace_clear(void);
+
+	/*! Dump the ring buffer, the oldest record first.
+	* \param emit - called with every record;
+	* \return amount of records dumped;
+	*/
+	uint16_t spiTrace_dump(void (*emit)(const spiTrace_record* record));
+
+	/*! Compute the report over the records in the ring buffer.
+	* \param report - the report;
+	* \sa spiTrace_print()
+	*/
+	void spiTrace_summarize(spiTrace_report* report);
+
+	/*! Print the report as CSV lines.
+	* \detail Sections: \c bus (window, busy and delay time and ratios), \c truncated (only if records have been overwritten: the window does not reach back to spiTrace_clear() and the calls in progress at its start are missing), \c op (per instruction class) and \c api (per traced API call, with the time left for computation and interrupts; records outside any call are counted in the \c bus and \c op sections only).
+	* \param emit - called with every line;
+	* \sa spiTrace_summarize()
+	*/
+	void spiTrace_print(void (*emit)(const char* line));
+	//!@}
+
+#endif